@@ -0,0 +1,124 @@
+//
+// 测量 Mp3Parser 逐帧日志的开销:
+//   logging - 日志照常格式化 (输出关闭, 只计格式化开销)
+//   quiet   - 运行期 quiet, 跳过格式化
+// 以 -DMFP_LOG_LEVEL=1 及以上编译时 TRACE 日志在编译期被消除, 两种模式结果应接近.
+// 另外以 BENCH_THREADS 个线程同时解析, 比较日志输出到控制台 (重定向到空设备) 的开销:
+//   sync    - easylogging++ 默认回调在日志锁内同步写出
+//   async   - AsyncLogSink 后台线程写出
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Mp3Parser.h"
+#include "ParserLog.h"
+#include "AsyncLogSink.h"
+#include "MediaGen.h"
+
+#define BENCH_FRAME_COUNT 20000
+#define BENCH_ROUNDS 5
+#define BENCH_THREADS 4
+
+// 只执行扫描, 不写出文件
+class BenchMp3Parser: public Mp3Parser {
+public:
+    using Mp3Parser::Mp3Parser;
+
+private:
+    int dump_info() override { return 0; }
+    int dump_data() override { return 0; }
+};
+
+// MPEG1 Layer III, 128 kbps, 44100 Hz, 带空的 ID3v2 标签, 帧扫描从标签之后开始
+static std::string write_cbr_mp3(int frame_count) {
+    GenOptions opt;
+    opt.format = "mp3";
+    opt.output = (std::filesystem::temp_directory_path() / "mfp_log_bench.mp3").string();
+    opt.frames = frame_count;
+    opt.id3 = true;
+    opt.quiet = true;
+    if (gen_file(opt) < 0) {
+        exit(1);
+    }
+    return opt.output;
+}
+
+static double run_ns_per_frame(const std::string& file_path, bool quiet) {
+    set_log_quiet(quiet);
+    double best = 0;
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        BenchMp3Parser parser(file_path);
+        auto start = std::chrono::steady_clock::now();
+        parser.parse();
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / BENCH_FRAME_COUNT;
+        if (round == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+// BENCH_THREADS 个线程各自解析一遍, 返回总帧数上的平均耗时
+static double run_threads_ns_per_frame(const std::string& file_path) {
+    set_log_quiet(false);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < BENCH_THREADS; ++i) {
+        threads.emplace_back([&file_path] {
+            BenchMp3Parser parser(file_path);
+            parser.parse();
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (BENCH_FRAME_COUNT * BENCH_THREADS);
+}
+
+static void set_log_to_stdout(bool to_stdout) {
+    el::Configurations conf;
+    conf.setToDefault();
+    conf.set(el::Level::Global, el::ConfigurationType::ToFile, "false");
+    conf.set(el::Level::Global, el::ConfigurationType::ToStandardOutput, to_stdout ? "true" : "false");
+    el::Loggers::reconfigureAllLoggers(conf);
+}
+
+int main() {
+    set_log_to_stdout(false);
+
+    std::string file_path = write_cbr_mp3(BENCH_FRAME_COUNT);
+    double logging = run_ns_per_frame(file_path, false);
+    double quiet = run_ns_per_frame(file_path, true);
+
+    // 同步输出经过 std::cout, 异步输出直接写空设备
+    set_log_to_stdout(true);
+    std::ofstream null_stream("/dev/null");
+    std::streambuf* cout_buf = std::cout.rdbuf(null_stream.rdbuf());
+    double sync = run_threads_ns_per_frame(file_path);
+    std::cout.rdbuf(cout_buf);
+
+    FILE* null_file = fopen("/dev/null", "w");
+    AsyncLogSink::instance().start(ASYNC_LOG_BLOCK, null_file);
+    double async = run_threads_ns_per_frame(file_path);
+    AsyncLogSink::instance().stop();
+    fclose(null_file);
+    std::filesystem::remove(file_path);
+
+    printf("MFP_LOG_LEVEL=%d, %d frames\n", MFP_LOG_LEVEL, BENCH_FRAME_COUNT);
+    printf("%-8s %10.1f ns/frame %12.0f frames/s\n", "logging", logging, 1e9 / logging);
+    printf("%-8s %10.1f ns/frame %12.0f frames/s\n", "quiet", quiet, 1e9 / quiet);
+    printf("%d threads, console output\n", BENCH_THREADS);
+    printf("%-8s %10.1f ns/frame %12.0f frames/s\n", "sync", sync, 1e9 / sync);
+    printf("%-8s %10.1f ns/frame %12.0f frames/s\n", "async", async, 1e9 / async);
+    return 0;
+}
@@ -0,0 +1,278 @@
+//
+// 各解析器热循环和 utils 字节转换函数的吞吐量.
+// 输入为临时目录下用 MediaGen 按固定参数生成的合成文件, 每项取 BENCH_ROUNDS 轮中最快的一轮:
+//   wav  - BENCH_WAV_CHUNKS 个 chunk 的遍历 (WavParser::custom_parse)
+//   mp3  - BENCH_MP3_FRAMES 个 CBR 帧 (Mp3Parser::parse_frame_headers)
+//   mp3 vbr - BENCH_MP3_FRAMES 个码率随机变化的帧
+//   mp3 stream, flv stream - 与 mp3, flv 相同的输入, 按 DEFAULT_STREAM_WINDOW 流式读取而不是 mmap
+//   mp3 junk - 帧之前有 BENCH_MP3_JUNK_SIZE 字节不含同步字的垃圾数据, 分别用各指令集的同步字查找
+//   另外校验不同长度的垃圾数据下并行帧扫描与串行扫描的结果相同
+//   flv  - BENCH_FLV_TAGS 个按时间戳交错的音视频 tag (FlvParser::parse_body)
+//   m4a  - moov 下 BENCH_M4A_ATOMS 个小 atom, 以及含 BENCH_M4A_ENTRIES 项 stsz/stco 的 trak
+//          (M4aParser::parse_atom)
+//   utils - 在 BENCH_UTILS_SIZE 字节的缓冲区上逐项调用 bytes_to_int*_be/le
+// 解析器只执行 parse() 的扫描部分, 不写出 dump 文件, 运行期开启 quiet 跳过逐帧日志.
+// 用法: parser_bench [scale], scale 按倍数放大所有输入, 默认为 1
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "WavParser.h"
+#include "Mp3Parser.h"
+#include "FlvParser.h"
+#include "M4aParser.h"
+#include "ByteScan.h"
+#include "LogConfig.h"
+#include "utils.h"
+#include "MediaGen.h"
+
+#define BENCH_ROUNDS 5
+#define BENCH_WAV_CHUNKS 200000
+#define BENCH_MP3_FRAMES 100000
+#define BENCH_MP3_JUNK_SIZE (32 * 1024 * 1024)
+#define BENCH_MP3_JUNK_FRAMES 1000
+#define BENCH_FLV_TAGS 200000
+#define BENCH_FLV_TAG_DATA_SIZE 64
+#define BENCH_M4A_ATOMS 200000
+#define BENCH_M4A_ENTRIES 1000000
+#define BENCH_UTILS_SIZE (16 * 1024 * 1024)
+
+// 只执行扫描, 不写出文件
+template <typename T>
+class BenchParser: public T {
+public:
+    using T::T;
+
+private:
+    int dump_info() override { return 0; }
+    int dump_data() override { return 0; }
+};
+
+struct BenchResult {
+    double seconds;
+    uint64_t bytes;
+    uint64_t items;
+};
+
+static std::string temp_path(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// 按 opt 在临时目录下生成输入文件, 返回文件路径
+static std::string gen_input(const char* name, GenOptions opt) {
+    opt.output = temp_path(name);
+    opt.quiet = true;
+    if (gen_file(opt) < 0) {
+        fprintf(stderr, "generate %s failed\n", name);
+        exit(1);
+    }
+    return opt.output;
+}
+
+// fmt 之后是 chunk_count 个空的 junk chunk, 最后是 1 KB 的 data chunk
+static GenOptions make_wav(int chunk_count) {
+    GenOptions opt;
+    opt.format = "wav";
+    opt.size = 1024;
+    opt.junk_chunks = chunk_count;
+    return opt;
+}
+
+// MPEG1 Layer III, 44100 Hz, 无 ID3 标签. CBR 为 128 kbps, VBR 逐帧随机码率;
+// junk_size 不为 0 时帧之前是不含 0xFF 的伪随机数据
+static GenOptions make_mp3(int frame_count, bool vbr, uint64_t junk_size = 0) {
+    GenOptions opt;
+    opt.format = "mp3";
+    opt.frames = frame_count;
+    opt.vbr = vbr;
+    opt.junk = junk_size;
+    return opt;
+}
+
+// onMetaData 和 AVC/AAC 序列头之后音视频 tag 交错, tag 负载约 BENCH_FLV_TAG_DATA_SIZE 字节
+static GenOptions make_flv(int tag_count) {
+    GenOptions opt;
+    opt.format = "flv";
+    opt.tags = tag_count;
+    opt.video_size = BENCH_FLV_TAG_DATA_SIZE;
+    opt.audio_size = BENCH_FLV_TAG_DATA_SIZE;
+    return opt;
+}
+
+// moov 下 atom_count 个 udta 容器, 每个含一个 8 字节的 free atom
+static GenOptions make_m4a_atoms(int atom_count) {
+    GenOptions opt;
+    opt.format = "mp4";
+    opt.samples = 1;
+    opt.udta_atoms = atom_count;
+    return opt;
+}
+
+// 一个 trak, 每个 chunk 一个 sample, stsz 和 stco 各 entry_count 项
+static GenOptions make_m4a(int entry_count) {
+    GenOptions opt;
+    opt.format = "mp4";
+    opt.samples = entry_count;
+    opt.samples_per_chunk = 1;
+    opt.sample_size = 1;
+    return opt;
+}
+
+// 返回 BENCH_ROUNDS 轮中最快一轮的耗时 (秒)
+static double best_seconds(const std::function<int()>& run) {
+    double best = 0;
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        if (run() != 0) {
+            fprintf(stderr, "parse failed\n");
+            exit(1);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        if (round == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+// window 不为 0 时按该窗口大小流式读取, 否则 mmap 整个文件
+template <typename T>
+static BenchResult bench_file(const std::string& file_path, uint64_t items, size_t window = 0) {
+    double seconds = best_seconds([&file_path, window] {
+        BenchParser<T> parser(file_path);
+        parser.set_stream_window(window);
+        return parser.parse();
+    });
+    return BenchResult{seconds, std::filesystem::file_size(file_path), items};
+}
+
+template <typename T>
+static BenchResult bench_parser(const char* name, const GenOptions& opt, uint64_t items, size_t window = 0) {
+    std::string file_path = gen_input(name, opt);
+    BenchResult result = bench_file<T>(file_path, items, window);
+    std::filesystem::remove(file_path);
+    return result;
+}
+
+// 并行帧扫描 (4 个线程) 与串行扫描的帧头 run 必须完全相同, 不同时退出.
+// 垃圾数据在 2 * MP3_SCAN_MIN_RANGE 附近时, 第一帧之后可能不足两段, 应退回串行扫描
+static void check_parallel_scan() {
+    const uint64_t junk_sizes[] = {0, 2 * MP3_SCAN_MIN_RANGE - 4096, 2 * MP3_SCAN_MIN_RANGE + 4096, 9 * 1024 * 1024};
+    for (uint64_t junk_size: junk_sizes) {
+        for (int frame_count: {100, BENCH_MP3_FRAMES}) {
+            std::string file_path = gen_input("mfp_parser_bench.mp3", make_mp3(frame_count, true, junk_size));
+            std::vector<Mp3FrameRun> runs[2];
+            for (int i = 0; i < 2; ++i) {
+                BenchParser<Mp3Parser> parser(file_path);
+                parser.set_scan_threads(i == 0 ? 1 : 4);
+                if (parser.parse() != 0) {
+                    fprintf(stderr, "parse failed\n");
+                    exit(1);
+                }
+                runs[i] = parser.frame_runs();
+            }
+            std::filesystem::remove(file_path);
+            bool same = runs[0].size() == runs[1].size();
+            for (size_t i = 0; same && i < runs[0].size(); ++i) {
+                const Mp3FrameRun& a = runs[0][i];
+                const Mp3FrameRun& b = runs[1][i];
+                same = a.header.raw == b.header.raw && a.start_frame == b.start_frame && a.count == b.count
+                    && a.start_offset == b.start_offset;
+            }
+            if (!same) {
+                fprintf(stderr, "parallel scan differs from serial scan: %llu bytes junk, %d frames\n",
+                        static_cast<unsigned long long>(junk_size), frame_count);
+                exit(1);
+            }
+        }
+    }
+}
+
+template <typename F>
+static BenchResult bench_utils(const std::vector<unsigned char>& buffer, size_t width, F func) {
+    size_t count = (buffer.size() - 8) / width;
+    volatile uint64_t sink = 0;
+    double seconds = best_seconds([&] {
+        uint64_t sum = 0;
+        const unsigned char* p = buffer.data();
+        for (size_t i = 0; i < count; ++i) {
+            sum += func(p + i * width);
+        }
+        sink = sink + sum;
+        return 0;
+    });
+    return BenchResult{seconds, count * width, count};
+}
+
+static void print_result(const char* name, const char* unit, const BenchResult& r) {
+    printf("%-18s %10.2f MB %10.2f ms %10.1f MB/s %14.0f %s/s\n", name,
+           r.bytes / 1e6, r.seconds * 1e3, r.bytes / 1e6 / r.seconds, r.items / r.seconds, unit);
+}
+
+int main(int argc, char** argv) {
+    int scale = argc > 1 ? std::max(1, atoi(argv[1])) : 1;
+    set_log_quiet(true);
+    set_log_enabled(false);
+
+    printf("%d rounds, scale %d\n", BENCH_ROUNDS, scale);
+    int wav_chunks = BENCH_WAV_CHUNKS * scale;
+    print_result("wav", "chunks", bench_parser<WavParser>(
+        "mfp_parser_bench.wav", make_wav(wav_chunks), wav_chunks));
+    int mp3_frames = BENCH_MP3_FRAMES * scale;
+    print_result("mp3", "frames", bench_parser<Mp3Parser>(
+        "mfp_parser_bench.mp3", make_mp3(mp3_frames, false), mp3_frames));
+    print_result("mp3 vbr", "frames", bench_parser<Mp3Parser>(
+        "mfp_parser_bench.mp3", make_mp3(mp3_frames, true), mp3_frames));
+    print_result("mp3 stream", "frames", bench_parser<Mp3Parser>(
+        "mfp_parser_bench.mp3", make_mp3(mp3_frames, false), mp3_frames, DEFAULT_STREAM_WINDOW));
+    std::string mp3 = gen_input("mfp_parser_bench.mp3",
+        make_mp3(BENCH_MP3_JUNK_FRAMES, false, static_cast<uint64_t>(BENCH_MP3_JUNK_SIZE) * scale));
+    ScanIsa default_isa = scan_isa();
+    for (ScanIsa isa: {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2, SCAN_NEON}) {
+        if (set_scan_isa(isa) < 0) {
+            continue;
+        }
+        std::string name = std::string("mp3 junk ") + scan_isa_name(isa);
+        print_result(name.c_str(), "frames", bench_file<Mp3Parser>(mp3, BENCH_MP3_JUNK_FRAMES));
+    }
+    std::filesystem::remove(mp3);
+    set_scan_isa(default_isa);
+    check_parallel_scan();
+    // 另有 onMetaData 和两个序列头
+    int flv_tags = BENCH_FLV_TAGS * scale;
+    print_result("flv", "tags", bench_parser<FlvParser>(
+        "mfp_parser_bench.flv", make_flv(flv_tags), flv_tags + 3));
+    print_result("flv stream", "tags", bench_parser<FlvParser>(
+        "mfp_parser_bench.flv", make_flv(flv_tags), flv_tags + 3, DEFAULT_STREAM_WINDOW));
+    // 每个 udta 计两个 atom
+    int m4a_atoms = BENCH_M4A_ATOMS * scale;
+    print_result("m4a", "atoms", bench_parser<M4aParser>(
+        "mfp_parser_bench.m4a", make_m4a_atoms(m4a_atoms), 2ull * m4a_atoms));
+    int m4a_entries = BENCH_M4A_ENTRIES * scale;
+    print_result("m4a stsz/stco", "entries", bench_parser<M4aParser>(
+        "mfp_parser_bench.m4a", make_m4a(m4a_entries), 2ull * m4a_entries));
+
+    std::vector<unsigned char> buffer(static_cast<size_t>(BENCH_UTILS_SIZE) * scale);
+    uint32_t seed = 1;
+    for (auto& c: buffer) {
+        seed = seed * 1103515245 + 12345;
+        c = seed >> 24;
+    }
+    print_result("bytes_to_int8_be", "calls", bench_utils(buffer, 8, bytes_to_int8_be));
+    print_result("bytes_to_int4_be", "calls", bench_utils(buffer, 4, bytes_to_int4_be));
+    print_result("bytes_to_int3_be", "calls", bench_utils(buffer, 3, bytes_to_int3_be));
+    print_result("bytes_to_int2_be", "calls", bench_utils(buffer, 2, bytes_to_int2_be));
+    print_result("bytes_to_int4_le", "calls", bench_utils(buffer, 4, bytes_to_int4_le));
+    print_result("bytes_to_int3_le", "calls", bench_utils(buffer, 3, bytes_to_int3_le));
+    print_result("bytes_to_int2_le", "calls", bench_utils(buffer, 2, bytes_to_int2_le));
+    return 0;
+}
@@ -0,0 +1,240 @@
+//
+// 异步日志输出
+//
+
+#include "AsyncLogSink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "logger/easylogging++.h"
+
+#define ASYNC_LOG_CALLBACK_ID "AsyncLogDispatchCallback"
+#define DEFAULT_LOG_CALLBACK_ID "DefaultLogDispatchCallback"
+#define RECORD_HEADER_SIZE 4
+
+LogRing::LogRing(size_t capacity): buffer_(new char[capacity]), capacity_(capacity), mask_(capacity - 1) {}
+
+void LogRing::copy_in(size_t pos, const char* src, size_t len) {
+    size_t offset = pos & mask_;
+    size_t first = std::min(len, capacity_ - offset);
+    memcpy(buffer_.get() + offset, src, first);
+    memcpy(buffer_.get(), src + first, len - first);
+}
+
+void LogRing::copy_out(size_t pos, char* dst, size_t len) const {
+    size_t offset = pos & mask_;
+    size_t first = std::min(len, capacity_ - offset);
+    memcpy(dst, buffer_.get() + offset, first);
+    memcpy(dst + first, buffer_.get(), len - first);
+}
+
+bool LogRing::push(const char* line, uint32_t len) {
+    // 超长的日志行截断到缓冲区能容纳的长度
+    if (len > capacity_ - RECORD_HEADER_SIZE) {
+        len = capacity_ - RECORD_HEADER_SIZE;
+    }
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    if (capacity_ - (head - tail) < RECORD_HEADER_SIZE + len) {
+        return false;
+    }
+    copy_in(head, reinterpret_cast<const char *>(&len), RECORD_HEADER_SIZE);
+    copy_in(head + RECORD_HEADER_SIZE, line, len);
+    head_.store(head + RECORD_HEADER_SIZE + len, std::memory_order_release);
+    return true;
+}
+
+size_t LogRing::drain(std::string& out) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t count = 0;
+    while (tail != head) {
+        uint32_t len = 0;
+        copy_out(tail, reinterpret_cast<char *>(&len), RECORD_HEADER_SIZE);
+        size_t out_size = out.size();
+        out.resize(out_size + len);
+        copy_out(tail + RECORD_HEADER_SIZE, &out[out_size], len);
+        tail += RECORD_HEADER_SIZE + len;
+        count++;
+    }
+    tail_.store(tail, std::memory_order_release);
+    return count;
+}
+
+bool LogRing::empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+}
+
+// 替换 DefaultLogDispatchCallback 的控制台输出
+class AsyncLogDispatchCallback: public el::LogDispatchCallback {
+protected:
+    void handle(const el::LogDispatchData* data) override {
+        if (data->dispatchAction() != el::base::DispatchAction::NormalLog) {
+            return;
+        }
+        const el::LogMessage* log_message = data->logMessage();
+        el::Logger* logger = log_message->logger();
+        if (!logger->typedConfigurations()->toStandardOutput(log_message->level())) {
+            return;
+        }
+        el::base::type::string_t line = logger->logBuilder()->build(log_message, true);
+        if (el::Loggers::hasFlag(el::LoggingFlag::ColoredTerminalOutput)) {
+            logger->logBuilder()->convertToColoredOutput(&line, log_message->level());
+        }
+        AsyncLogSink::instance().push(line, log_message->level() == el::Level::Fatal);
+    }
+};
+
+// 线程退出时关闭自己的缓冲区, 由后台线程写完剩余日志后释放
+struct LocalRing {
+    std::shared_ptr<LogRing> ring;
+    uint64_t generation = 0;
+
+    ~LocalRing() {
+        if (ring) {
+            ring->close();
+        }
+    }
+};
+
+static thread_local LocalRing t_local_ring;
+
+AsyncLogSink& AsyncLogSink::instance() {
+    static AsyncLogSink sink;
+    return sink;
+}
+
+AsyncLogSink::~AsyncLogSink() {
+    // 进程退出时 easylogging++ 可能已经析构, 只停止后台线程
+    if (running_) {
+        stop_writer();
+    }
+}
+
+void AsyncLogSink::start(AsyncLogPolicy policy, FILE* out) {
+    if (running_) {
+        return;
+    }
+    policy_ = policy;
+    out_ = out;
+    dropped_.store(0, std::memory_order_relaxed);
+    stop_.store(false, std::memory_order_relaxed);
+    // 上一次运行留下的线程缓冲区作废
+    generation_.fetch_add(1, std::memory_order_release);
+    writer_ = std::thread(&AsyncLogSink::writer_loop, this);
+    running_ = true;
+
+    el::Helpers::installLogDispatchCallback<AsyncLogDispatchCallback>(ASYNC_LOG_CALLBACK_ID);
+    el::Helpers::logDispatchCallback<AsyncLogDispatchCallback>(ASYNC_LOG_CALLBACK_ID)->setEnabled(true);
+    el::Helpers::logDispatchCallback<el::base::DefaultLogDispatchCallback>(DEFAULT_LOG_CALLBACK_ID)->setEnabled(false);
+}
+
+void AsyncLogSink::stop() {
+    if (!running_) {
+        return;
+    }
+    el::Helpers::logDispatchCallback<el::base::DefaultLogDispatchCallback>(DEFAULT_LOG_CALLBACK_ID)->setEnabled(true);
+    el::Helpers::logDispatchCallback<AsyncLogDispatchCallback>(ASYNC_LOG_CALLBACK_ID)->setEnabled(false);
+
+    stop_writer();
+
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        rings_.clear();
+    }
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped > 0) {
+        fprintf(out_, "[async log] %llu lines dropped\n", static_cast<unsigned long long>(dropped));
+    }
+    fflush(out_);
+}
+
+void AsyncLogSink::stop_writer() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_.store(true, std::memory_order_release);
+    }
+    wake_cv_.notify_one();
+    writer_.join();
+    running_ = false;
+}
+
+LogRing* AsyncLogSink::local_ring() {
+    uint64_t generation = generation_.load(std::memory_order_acquire);
+    if (t_local_ring.ring && t_local_ring.generation == generation) {
+        return t_local_ring.ring.get();
+    }
+    t_local_ring.ring = std::make_shared<LogRing>(ASYNC_LOG_RING_SIZE);
+    t_local_ring.generation = generation;
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings_.push_back(t_local_ring.ring);
+    return t_local_ring.ring.get();
+}
+
+void AsyncLogSink::push(const std::string& line, bool sync) {
+    LogRing* ring = local_ring();
+    if (sync) {
+        // 先等本线程之前的日志被取走, 再在写出锁内直接输出
+        while (!ring->empty()) {
+            wake_cv_.notify_one();
+            std::this_thread::yield();
+        }
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        fwrite(line.data(), 1, line.size(), out_);
+        fflush(out_);
+        return;
+    }
+    while (!ring->push(line.data(), static_cast<uint32_t>(line.size()))) {
+        if (policy_ == ASYNC_LOG_DROP) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        wake_cv_.notify_one();
+        std::this_thread::yield();
+    }
+}
+
+size_t AsyncLogSink::drain_all(std::string& out) {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    size_t count = 0;
+    for (size_t i = 0; i < rings_.size();) {
+        // 先读关闭标记, 保证关闭前写入的日志都能在本次取出
+        bool closed = rings_[i]->closed();
+        count += rings_[i]->drain(out);
+        if (closed) {
+            rings_[i] = rings_.back();
+            rings_.pop_back();
+        } else {
+            i++;
+        }
+    }
+    return count;
+}
+
+void AsyncLogSink::writer_loop() {
+    std::string buffer;
+    while (true) {
+        bool stopping = stop_.load(std::memory_order_acquire);
+        size_t count;
+        {
+            std::lock_guard<std::mutex> lock(write_mutex_);
+            count = drain_all(buffer);
+            if (!buffer.empty()) {
+                fwrite(buffer.data(), 1, buffer.size(), out_);
+                fflush(out_);
+                buffer.clear();
+            }
+        }
+        if (count > 0) {
+            continue;
+        }
+        if (stopping) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait_for(lock, std::chrono::milliseconds(ASYNC_LOG_POLL_MS),
+                          [this] { return stop_.load(std::memory_order_acquire); });
+    }
+}
@@ -0,0 +1,104 @@
+//
+// 异步日志输出.
+// 每个写日志的线程有一个单生产者/单消费者的无锁环形缓冲区, easylogging++ 回调只把格式化好的日志行
+// 拷贝进本线程的缓冲区, 由后台线程统一写出, 解析线程不再排队等待控制台 I/O.
+// 缓冲区容量固定, 写满时按策略丢弃 (计数) 或等待后台线程腾出空间.
+// 只接管控制台输出, 开启期间配置为写文件的日志不会被输出
+//
+
+#ifndef MEDIAFORMATPARSER_ASYNCLOGSINK_H
+#define MEDIAFORMATPARSER_ASYNCLOGSINK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 每个线程的环形缓冲区大小, 必须是 2 的幂
+#define ASYNC_LOG_RING_SIZE (256 * 1024)
+// 后台线程空闲时的轮询间隔 (毫秒)
+#define ASYNC_LOG_POLL_MS 2
+
+enum AsyncLogPolicy {
+    ASYNC_LOG_BLOCK,  // 缓冲区满时等待后台线程写出
+    ASYNC_LOG_DROP,   // 缓冲区满时丢弃日志行并计数
+};
+
+// 单生产者/单消费者环形缓冲区, 每条记录为 4 字节长度 + 日志行
+class LogRing {
+public:
+    explicit LogRing(size_t capacity);
+
+    // 生产者调用, 空间不足时返回 false
+    bool push(const char* line, uint32_t len);
+    // 消费者调用, 把所有记录追加到 out, 返回记录条数
+    size_t drain(std::string& out);
+
+    bool empty() const;
+    // 所属线程退出后标记, 消费者写完剩余记录后释放
+    void close() { closed_.store(true, std::memory_order_release); }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+    void copy_in(size_t pos, const char* src, size_t len);
+    void copy_out(size_t pos, char* dst, size_t len) const;
+
+private:
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0};  // 写位置, 只有生产者修改
+    alignas(64) std::atomic<size_t> tail_{0};  // 读位置, 只有消费者修改
+    std::atomic<bool> closed_{false};
+};
+
+class AsyncLogSink {
+public:
+    static AsyncLogSink& instance();
+
+    // 安装 easylogging++ 回调并启动后台线程, 替换默认的同步控制台输出
+    void start(AsyncLogPolicy policy = ASYNC_LOG_BLOCK, FILE* out = stdout);
+    // 写出剩余日志, 停止后台线程并恢复同步输出. 需在所有写日志的线程结束后调用
+    void stop();
+
+    bool running() const { return running_; }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // 由回调调用; sync 为 true 时等待日志写出后返回 (FATAL 日志之后进程会退出)
+    void push(const std::string& line, bool sync);
+
+private:
+    AsyncLogSink() = default;
+    ~AsyncLogSink();
+
+    void stop_writer();
+    LogRing* local_ring();
+    void writer_loop();
+    size_t drain_all(std::string& out);
+
+private:
+    bool running_ = false;
+    AsyncLogPolicy policy_ = ASYNC_LOG_BLOCK;
+    FILE* out_ = stdout;
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> stop_{false};
+
+    // 只在线程第一次写日志和后台线程遍历时加锁
+    std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<LogRing>> rings_;
+
+    // 后台线程从取出日志到写出期间持有, 同步写出时用来保证顺序
+    std::mutex write_mutex_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::thread writer_;
+};
+
+
+#endif //MEDIAFORMATPARSER_ASYNCLOGSINK_H
@@ -0,0 +1,251 @@
+//
+// 批量解析实现
+//
+
+#include "BatchParser.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <unordered_set>
+
+#include "ParserFactory.h"
+#include "ThreadPool.h"
+#include "utils.h"
+#include "logger/easylogging++.h"
+
+// 无法识别的文件记在 format="unknown" 下
+#define METRICS_UNKNOWN_FORMAT "unknown"
+
+BatchParser::BatchParser(size_t thread_count): thread_count_(thread_count) {
+
+}
+
+void BatchParser::set_probe_only(bool probe_only) {
+    probe_only_ = probe_only;
+}
+
+void BatchParser::set_report_format(ReportFormat format) {
+    report_format_ = format;
+}
+
+void BatchParser::set_log_stats(bool log_stats) {
+    log_stats_ = log_stats;
+}
+
+void BatchParser::set_metrics_enabled(bool metrics_enabled) {
+    metrics_enabled_ = metrics_enabled;
+}
+
+void BatchParser::set_decode_threads(size_t decode_threads) {
+    decode_threads_ = decode_threads;
+}
+
+void BatchParser::set_scan_threads(size_t scan_threads) {
+    scan_threads_ = scan_threads;
+}
+
+void BatchParser::set_stream_window(size_t window_size) {
+    stream_window_ = window_size;
+}
+
+void BatchParser::set_dump_attachments(bool dump_attachments) {
+    dump_attachments_ = dump_attachments;
+}
+
+int BatchParser::add_path(const std::string& path) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    int count = 0;
+
+    if (fs::is_directory(path, ec)) {
+        auto options = fs::directory_options::skip_permission_denied;
+        for (fs::recursive_directory_iterator it(path, options, ec), end; !ec && it != end; it.increment(ec)) {
+            if (!it->is_regular_file(ec)) {
+                continue;
+            }
+            // 取大小失败不应结束遍历, 也不应让出错的文件排在最前面
+            std::error_code size_ec;
+            uintmax_t size = it->file_size(size_ec);
+            jobs_.push_back(Job{it->path().string(), size_ec ? 0 : size, {}});
+            count++;
+        }
+        if (ec) {
+            LOG(WARNING) << "walk directory " << path << " failed: " << ec.message();
+        }
+    } else if (fs::is_regular_file(path, ec)) {
+        uintmax_t size = fs::file_size(path, ec);
+        jobs_.push_back(Job{path, ec ? 0 : size, {}});
+        count++;
+    } else {
+        LOG(ERROR) << "path " << path << " not found";
+        return -1;
+    }
+    return count;
+}
+
+int BatchParser::add_list_file(const std::string& list_path) {
+    std::ifstream file(list_path);
+    if (!file.is_open()) {
+        LOG(ERROR) << "open file " << list_path << " failed";
+        return -1;
+    }
+
+    int count = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        int ret = add_path(line);
+        if (ret > 0) {
+            count += ret;
+        }
+    }
+    return count;
+}
+
+void BatchParser::assign_output_names() {
+    std::unordered_set<std::string> used;
+    for (auto& job: jobs_) {
+        std::string name = get_filename_without_extension(job.path);
+        std::string output_name = name;
+        for (int i = 1; !used.insert(output_name).second; ++i) {
+            output_name = name + "_" + std::to_string(i);
+        }
+        job.output_name = output_name;
+    }
+}
+
+std::vector<BatchResult> BatchParser::run() {
+    assign_output_names();
+
+    // 大文件优先调度, 避免最后剩下一个大文件拖长整体耗时
+    std::stable_sort(jobs_.begin(), jobs_.end(), [](const Job& a, const Job& b) {
+        return a.size > b.size;
+    });
+
+    if (metrics_enabled_) {
+        register_metrics();
+    }
+
+    // 各文件的并行解码共用一个线程池, 解码线程和其中的 mpg123 句柄在文件之间复用, 而不是每个文件重新创建
+    std::unique_ptr<ThreadPool> decode_pool;
+    size_t decode_threads = decode_threads_ == 0 ? std::thread::hardware_concurrency() : decode_threads_;
+    if (!probe_only_ && decode_threads > 1) {
+        decode_pool = std::make_unique<ThreadPool>(decode_threads);
+    }
+    decode_pool_ = decode_pool.get();
+
+    std::vector<BatchResult> results(jobs_.size());
+    {
+        ThreadPool pool(thread_count_);
+        LOG(INFO) << "batch parse " << jobs_.size() << " files with " << pool.size() << " threads";
+        for (size_t i = 0; i < jobs_.size(); ++i) {
+            pool.submit([this, &results, i] {
+                results[i] = parse_one(jobs_[i]);
+            });
+        }
+        pool.wait();
+    }
+    decode_pool_ = nullptr;
+
+    size_t failed = std::count_if(results.begin(), results.end(), [](const BatchResult& r) {
+        return r.ret != 0;
+    });
+    LOG(INFO) << "batch parse finished, " << results.size() - failed << " succeeded, " << failed << " failed";
+    return results;
+}
+
+BatchResult BatchParser::parse_one(const Job& job) const {
+    BatchResult result;
+    result.file_path = job.path;
+    result.file_size = job.size;
+    uint64_t start_ns = monotonic_ns();
+
+    try {
+        std::unique_ptr<Parser> parser = ParserFactory::instance().create(job.path, &result.format);
+        if (!parser) {
+            result.ret = BATCH_UNSUPPORTED;
+            result.error = "unsupported format";
+        } else {
+            parser->set_output_name(job.output_name);
+            if (probe_only_) {
+                result.ret = parser->probe();
+                result.info = parser->stream_info();
+                result.stats = parser->stats();
+            } else {
+                parser->set_report_format(report_format_);
+                parser->set_log_stats(log_stats_);
+                parser->set_decode_threads(decode_threads_);
+                parser->set_decode_pool(decode_pool_);
+                parser->set_scan_threads(scan_threads_);
+                parser->set_stream_window(stream_window_);
+                result.ret = parser->parse();
+                result.stats = parser->stats();
+            }
+            if (result.ret != 0) {
+                result.error = probe_only_ ? "probe failed" : "parse failed";
+            } else if (dump_attachments_) {
+                result.attachments = parser->dump_attachments();
+            }
+        }
+    } catch (const std::exception& e) {
+        result.ret = BATCH_EXCEPTION;
+        result.error = e.what();
+    } catch (...) {
+        result.ret = BATCH_EXCEPTION;
+        result.error = "unknown exception";
+    }
+
+    if (result.ret != 0) {
+        LOG(WARNING) << job.path << ": " << result.error << " (" << result.ret << ")";
+    }
+    if (metrics_enabled_) {
+        record_metrics(result, monotonic_ns() - start_ns);
+    }
+    return result;
+}
+
+void BatchParser::register_metrics() {
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    std::vector<std::string> formats = ParserFactory::instance().format_names();
+    formats.emplace_back(METRICS_UNKNOWN_FORMAT);
+    for (auto& format: formats) {
+        FormatMetrics& m = metrics_[format];
+        m.succeeded = &registry.counter("mfp_files_parsed_total", "Files processed, by format and result.",
+                                        {{"format", format}, {"result", "ok"}});
+        m.failed = &registry.counter("mfp_files_parsed_total", "Files processed, by format and result.",
+                                     {{"format", format}, {"result", "error"}});
+        m.bytes_read = &registry.counter("mfp_read_bytes_total", "Bytes read from input files.",
+                                         {{"format", format}});
+        m.bytes_written = &registry.counter("mfp_written_bytes_total", "Bytes written to dump and report files.",
+                                            {{"format", format}});
+        m.duration = &registry.histogram("mfp_parse_duration_seconds",
+                                         "Wall time from format detection to the end of parse or probe.",
+                                         {{"format", format}});
+    }
+}
+
+void BatchParser::record_metrics(const BatchResult& result, uint64_t duration_ns) const {
+    const std::string& format = result.format.empty() ? METRICS_UNKNOWN_FORMAT : result.format;
+    auto it = metrics_.find(format);
+    if (it == metrics_.end()) {
+        return;
+    }
+    const FormatMetrics& m = it->second;
+    if (result.ret == 0) {
+        m.succeeded->inc();
+    } else {
+        m.failed->inc();
+        // 失败较少, 按返回码动态注册
+        MetricsRegistry::instance().counter("mfp_parse_failures_total", "Failed files, by format and return code.",
+                                            {{"format", format}, {"code", std::to_string(result.ret)}}).inc();
+    }
+    m.bytes_read->inc(result.stats.bytes_read);
+    m.bytes_written->inc(result.stats.bytes_written);
+    m.duration->observe(duration_ns / 1e9);
+}
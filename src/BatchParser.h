@@ -0,0 +1,101 @@
+//
+// 批量解析: 收集文件后按大小降序提交到工作窃取线程池并发解析,
+// 单个文件的失败或异常不影响其他文件
+//
+
+#ifndef MEDIAFORMATPARSER_BATCHPARSER_H
+#define MEDIAFORMATPARSER_BATCHPARSER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Metrics.h"
+#include "Parser.h"
+
+// 无法识别文件格式
+#define BATCH_UNSUPPORTED (-10)
+// 解析过程中抛出异常
+#define BATCH_EXCEPTION (-11)
+
+struct BatchResult {
+    std::string file_path;
+    std::string format;  // 识别出的格式名, 无法识别时为空
+    uintmax_t file_size = 0;
+    int ret = 0;         // parse()/probe() 的返回值, 0 为成功
+    std::string error;
+    StreamInfo info;     // 仅 probe 模式下填充
+    ParseStats stats;    // 完整解析时填充, probe 时只有 bytes_read
+    int attachments = 0; // 导出的附件数
+};
+
+class BatchParser {
+public:
+    // thread_count 为 0 时使用 CPU 核数
+    explicit BatchParser(size_t thread_count = 0);
+
+    // 只执行 probe, 不做完整解析和导出
+    void set_probe_only(bool probe_only);
+    // 完整解析时额外输出的报告格式
+    void set_report_format(ReportFormat format);
+    // 每个文件解析结束后输出一行统计摘要
+    void set_log_stats(bool log_stats);
+    // 按格式记录文件数, 失败返回码, 读写字节数和耗时到 MetricsRegistry
+    void set_metrics_enabled(bool metrics_enabled);
+    // 每个文件 dump_data 可使用的线程数, 见 Parser::set_decode_threads
+    void set_decode_threads(size_t decode_threads);
+    // 每个文件 custom_parse 可使用的线程数, 见 Parser::set_scan_threads
+    void set_scan_threads(size_t scan_threads);
+    // 完整解析时的流式读取窗口, 0 为默认的 mmap, 见 Parser::set_stream_window
+    void set_stream_window(size_t window_size);
+    // probe()/parse() 成功后将内嵌附件 (封面等) 写到输出目录, 见 Parser::dump_attachments
+    void set_dump_attachments(bool dump_attachments);
+    // 添加单个文件, 或递归添加目录下的所有文件, 返回添加的文件数
+    int add_path(const std::string& path);
+    // 从列表文件添加, 每行一个文件或目录
+    int add_list_file(const std::string& list_path);
+
+    // 执行所有任务, 结果按调度顺序 (文件从大到小) 返回
+    std::vector<BatchResult> run();
+
+private:
+    struct Job {
+        std::string path;
+        uintmax_t size;
+        std::string output_name;  // 由 assign_output_names 填充
+    };
+
+    // 同一格式的指标, 在 run() 开始前注册好, 解析线程只做原子更新
+    struct FormatMetrics {
+        Counter* succeeded;
+        Counter* failed;
+        Counter* bytes_read;
+        Counter* bytes_written;
+        Histogram* duration;
+    };
+
+    // 输出文件都写到同一目录, 不同目录下的同名文件按添加顺序加上 _1, _2 ... 后缀
+    void assign_output_names();
+    BatchResult parse_one(const Job& job) const;
+    void register_metrics();
+    void record_metrics(const BatchResult& result, uint64_t duration_ns) const;
+
+private:
+    size_t thread_count_;
+    bool probe_only_ = false;
+    ReportFormat report_format_ = REPORT_NONE;
+    bool log_stats_ = false;
+    bool metrics_enabled_ = false;
+    size_t decode_threads_ = 1;
+    // run() 期间有效, 各文件并行解码共用
+    ThreadPool* decode_pool_ = nullptr;
+    size_t scan_threads_ = 1;
+    size_t stream_window_ = 0;
+    bool dump_attachments_ = false;
+    std::unordered_map<std::string, FormatMetrics> metrics_;
+    std::vector<Job> jobs_;
+};
+
+
+#endif //MEDIAFORMATPARSER_BATCHPARSER_H
@@ -0,0 +1,251 @@
+//
+// 同步字/标记查找的各指令集实现和运行时分派
+//
+
+#include "ByteScan.h"
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+
+#if defined(__x86_64__)
+#define BYTE_SCAN_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define BYTE_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+static size_t find_mp3_sync_scalar(const unsigned char* data, size_t size) {
+    for (size_t i = 0; i + 1 < size; ++i) {
+        if (data[i] == 0xff && (data[i + 1] & 0xe0) == 0xe0) {
+            return i;
+        }
+    }
+    return size;
+}
+
+static size_t find_marker3_scalar(const unsigned char* data, size_t size, const char* marker) {
+    for (size_t i = 0; i + 2 < size; ++i) {
+        if (data[i] == static_cast<unsigned char>(marker[0])
+            && data[i + 1] == static_cast<unsigned char>(marker[1])
+            && data[i + 2] == static_cast<unsigned char>(marker[2])) {
+            return i;
+        }
+    }
+    return size;
+}
+
+// 向量部分处理到 i 之后剩余的尾部交给逐字节实现
+static size_t find_mp3_sync_tail(const unsigned char* data, size_t size, size_t i) {
+    return i + find_mp3_sync_scalar(data + i, size - i);
+}
+
+static size_t find_marker3_tail(const unsigned char* data, size_t size, const char* marker, size_t i) {
+    return i + find_marker3_scalar(data + i, size - i, marker);
+}
+
+#ifdef BYTE_SCAN_X86
+
+// 第 i 个位置的判断需要读到 data[i + 1], 每块多读 1 字节
+static size_t find_mp3_sync_sse2(const unsigned char* data, size_t size) {
+    const __m128i ff = _mm_set1_epi8(static_cast<char>(0xff));
+    const __m128i e0 = _mm_set1_epi8(static_cast<char>(0xe0));
+    size_t i = 0;
+    for (; i + 17 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(a, ff), _mm_cmpeq_epi8(_mm_and_si128(b, e0), e0));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return find_mp3_sync_tail(data, size, i);
+}
+
+static size_t find_marker3_sse2(const unsigned char* data, size_t size, const char* marker) {
+    const __m128i m0 = _mm_set1_epi8(marker[0]);
+    const __m128i m1 = _mm_set1_epi8(marker[1]);
+    const __m128i m2 = _mm_set1_epi8(marker[2]);
+    size_t i = 0;
+    for (; i + 18 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2));
+        __m128i hit = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(a, m0), _mm_cmpeq_epi8(b, m1)),
+                                    _mm_cmpeq_epi8(c, m2));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return find_marker3_tail(data, size, marker, i);
+}
+
+__attribute__((target("avx2")))
+static size_t find_mp3_sync_avx2(const unsigned char* data, size_t size) {
+    const __m256i ff = _mm256_set1_epi8(static_cast<char>(0xff));
+    const __m256i e0 = _mm256_set1_epi8(static_cast<char>(0xe0));
+    size_t i = 0;
+    for (; i + 33 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+        __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(a, ff),
+                                       _mm256_cmpeq_epi8(_mm256_and_si256(b, e0), e0));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return find_mp3_sync_tail(data, size, i);
+}
+
+__attribute__((target("avx2")))
+static size_t find_marker3_avx2(const unsigned char* data, size_t size, const char* marker) {
+    const __m256i m0 = _mm256_set1_epi8(marker[0]);
+    const __m256i m1 = _mm256_set1_epi8(marker[1]);
+    const __m256i m2 = _mm256_set1_epi8(marker[2]);
+    size_t i = 0;
+    for (; i + 34 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 2));
+        __m256i hit = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(a, m0), _mm256_cmpeq_epi8(b, m1)),
+                                       _mm256_cmpeq_epi8(c, m2));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return find_marker3_tail(data, size, marker, i);
+}
+
+#endif
+
+#ifdef BYTE_SCAN_NEON
+
+// NEON 没有 movemask, 把每个字节的比较结果压缩为 4 位, 第一个命中位置为最低非零位 / 4
+static inline uint64_t neon_mask(uint8x16_t hit) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+}
+
+static size_t find_mp3_sync_neon(const unsigned char* data, size_t size) {
+    const uint8x16_t ff = vdupq_n_u8(0xff);
+    const uint8x16_t e0 = vdupq_n_u8(0xe0);
+    size_t i = 0;
+    for (; i + 17 <= size; i += 16) {
+        uint8x16_t a = vld1q_u8(data + i);
+        uint8x16_t b = vld1q_u8(data + i + 1);
+        uint8x16_t hit = vandq_u8(vceqq_u8(a, ff), vceqq_u8(vandq_u8(b, e0), e0));
+        uint64_t mask = neon_mask(hit);
+        if (mask != 0) {
+            return i + __builtin_ctzll(mask) / 4;
+        }
+    }
+    return find_mp3_sync_tail(data, size, i);
+}
+
+static size_t find_marker3_neon(const unsigned char* data, size_t size, const char* marker) {
+    const uint8x16_t m0 = vdupq_n_u8(static_cast<uint8_t>(marker[0]));
+    const uint8x16_t m1 = vdupq_n_u8(static_cast<uint8_t>(marker[1]));
+    const uint8x16_t m2 = vdupq_n_u8(static_cast<uint8_t>(marker[2]));
+    size_t i = 0;
+    for (; i + 18 <= size; i += 16) {
+        uint8x16_t a = vld1q_u8(data + i);
+        uint8x16_t b = vld1q_u8(data + i + 1);
+        uint8x16_t c = vld1q_u8(data + i + 2);
+        uint8x16_t hit = vandq_u8(vandq_u8(vceqq_u8(a, m0), vceqq_u8(b, m1)), vceqq_u8(c, m2));
+        uint64_t mask = neon_mask(hit);
+        if (mask != 0) {
+            return i + __builtin_ctzll(mask) / 4;
+        }
+    }
+    return find_marker3_tail(data, size, marker, i);
+}
+
+#endif
+
+struct ScanFunctions {
+    ScanIsa isa;
+    size_t (*find_mp3_sync)(const unsigned char* data, size_t size);
+    size_t (*find_marker3)(const unsigned char* data, size_t size, const char* marker);
+};
+
+static const ScanFunctions SCALAR_FUNCTIONS = {SCAN_SCALAR, find_mp3_sync_scalar, find_marker3_scalar};
+#ifdef BYTE_SCAN_X86
+static const ScanFunctions SSE2_FUNCTIONS = {SCAN_SSE2, find_mp3_sync_sse2, find_marker3_sse2};
+static const ScanFunctions AVX2_FUNCTIONS = {SCAN_AVX2, find_mp3_sync_avx2, find_marker3_avx2};
+#endif
+#ifdef BYTE_SCAN_NEON
+static const ScanFunctions NEON_FUNCTIONS = {SCAN_NEON, find_mp3_sync_neon, find_marker3_neon};
+#endif
+
+static const ScanFunctions* functions_for(ScanIsa isa) {
+    switch (isa) {
+        case SCAN_SCALAR:
+            return &SCALAR_FUNCTIONS;
+#ifdef BYTE_SCAN_X86
+        case SCAN_SSE2:
+            // x86_64 上 SSE2 总是可用
+            return &SSE2_FUNCTIONS;
+        case SCAN_AVX2:
+            return __builtin_cpu_supports("avx2") ? &AVX2_FUNCTIONS : nullptr;
+#endif
+#ifdef BYTE_SCAN_NEON
+        case SCAN_NEON:
+            return &NEON_FUNCTIONS;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static const ScanFunctions* detect_functions() {
+    for (ScanIsa isa: {SCAN_AVX2, SCAN_SSE2, SCAN_NEON}) {
+        const ScanFunctions* functions = functions_for(isa);
+        if (functions) {
+            return functions;
+        }
+    }
+    return &SCALAR_FUNCTIONS;
+}
+
+static std::atomic<const ScanFunctions*>& active_functions() {
+    static std::atomic<const ScanFunctions*> functions{detect_functions()};
+    return functions;
+}
+
+ScanIsa scan_isa() {
+    return active_functions().load(std::memory_order_relaxed)->isa;
+}
+
+const char* scan_isa_name(ScanIsa isa) {
+    switch (isa) {
+        case SCAN_SSE2:
+            return "sse2";
+        case SCAN_AVX2:
+            return "avx2";
+        case SCAN_NEON:
+            return "neon";
+        default:
+            return "scalar";
+    }
+}
+
+int set_scan_isa(ScanIsa isa) {
+    const ScanFunctions* functions = functions_for(isa);
+    if (functions == nullptr) {
+        return -1;
+    }
+    active_functions().store(functions, std::memory_order_relaxed);
+    return 0;
+}
+
+size_t find_mp3_sync(const unsigned char* data, size_t size) {
+    return active_functions().load(std::memory_order_relaxed)->find_mp3_sync(data, size);
+}
+
+size_t find_marker3(const unsigned char* data, size_t size, const char* marker) {
+    return active_functions().load(std::memory_order_relaxed)->find_marker3(data, size, marker);
+}
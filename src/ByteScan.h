@@ -0,0 +1,31 @@
+//
+// 同步字/标记的向量化查找.
+// 每次比较 16 (SSE2, NEON) 或 32 (AVX2) 个位置, 只找出候选位置, 是否有效仍由调用方按原有规则校验.
+// x86_64 上运行时检测 AVX2, 否则使用 SSE2; aarch64 使用 NEON; 其他平台逐字节查找
+//
+
+#ifndef MEDIAFORMATPARSER_BYTESCAN_H
+#define MEDIAFORMATPARSER_BYTESCAN_H
+
+#include <cstddef>
+
+enum ScanIsa {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+    SCAN_NEON,
+};
+
+// 当前使用的指令集, 首次调用时按 CPU 选择
+ScanIsa scan_isa();
+const char* scan_isa_name(ScanIsa isa);
+// 强制使用指定指令集 (用于对比测试), CPU 或编译目标不支持时返回 -1 且不做修改
+int set_scan_isa(ScanIsa isa);
+
+// 返回第一个满足 data[i] == 0xFF && (data[i + 1] & 0xE0) == 0xE0 的 i, 没有时返回 size
+size_t find_mp3_sync(const unsigned char* data, size_t size);
+// 返回 3 字节标记 (如 "ID3", "TAG") 第一次出现的位置, 没有时返回 size
+size_t find_marker3(const unsigned char* data, size_t size, const char* marker);
+
+
+#endif //MEDIAFORMATPARSER_BYTESCAN_H
@@ -0,0 +1,158 @@
+//
+// 输入数据源实现
+//
+
+#include "ByteSource.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger/easylogging++.h"
+
+#define SOURCE_ALIGN 4096
+
+MemoryByteSource::MemoryByteSource(const unsigned char *data, size_t size): data_(data) {
+    size_ = size;
+    // 整个文件已映射或读入
+    bytes_read_ = size;
+}
+
+size_t MemoryByteSource::capacity() const {
+    return size_;
+}
+
+ByteWindow MemoryByteSource::load(size_t pos, size_t len) {
+    ByteWindow window;
+    if (pos + len <= size_) {
+        window.data = data_;
+        window.pos = 0;
+        window.len = size_;
+        return window;
+    }
+
+    // 跨越文件末尾的字段读取, 拷贝剩余字节并补 0
+    if (len > SOURCE_SCRATCH_SIZE) {
+        return window;
+    }
+    size_t available = pos < size_ ? size_ - pos : 0;
+    memset(scratch_, 0, sizeof(scratch_));
+    if (available > 0) {
+        memcpy(scratch_, data_ + pos, available);
+    }
+    window.data = scratch_;
+    window.pos = pos;
+    window.len = len;
+    return window;
+}
+
+FileByteSource::FileByteSource(const std::string& file_path, size_t window_size) {
+    fd_ = ::open(file_path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        LOG(ERROR) << "open file " << file_path << " failed";
+        return;
+    }
+    if (init(window_size) < 0) {
+        LOG(ERROR) << "stat file " << file_path << " failed";
+    }
+}
+
+FileByteSource::FileByteSource(int fd, size_t window_size, const unsigned char* head, size_t head_size) {
+    fd_ = fd;
+    owns_fd_ = false;
+    if (init(window_size) < 0) {
+        LOG(ERROR) << "stat fd " << fd << " failed";
+        return;
+    }
+    // 识别格式时读过的头部直接作为第一个窗口, 之后的读取只补读其后的部分. 头部也计入读取的字节数
+    window_len_ = std::min({head_size, buffer_.size(), size_});
+    memcpy(buffer_.data(), head, window_len_);
+    bytes_read_ = window_len_;
+}
+
+int FileByteSource::init(size_t window_size) {
+    struct stat st{};
+    if (fstat(fd_, &st) < 0) {
+        if (owns_fd_) {
+            ::close(fd_);
+        }
+        fd_ = -1;
+        return -1;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    buffer_.resize(std::max<size_t>(window_size, SOURCE_ALIGN));
+    return 0;
+}
+
+FileByteSource::~FileByteSource() {
+    if (fd_ >= 0 && owns_fd_) {
+        ::close(fd_);
+    }
+}
+
+size_t FileByteSource::capacity() const {
+    return buffer_.size();
+}
+
+ByteWindow FileByteSource::load(size_t pos, size_t len) {
+    ByteWindow window;
+    if (fd_ < 0 || len > buffer_.size()) {
+        return window;
+    }
+
+    if (pos >= window_pos_ && pos + len <= window_pos_ + window_len_) {
+        window.data = buffer_.data();
+        window.pos = window_pos_;
+        window.len = window_len_;
+        return window;
+    }
+
+    // 窗口起点按页对齐, 保证请求区间仍能放进窗口
+    size_t start = pos - pos % SOURCE_ALIGN;
+    if (pos + len - start > buffer_.size()) {
+        start = pos;
+    }
+
+    // 顺序读取时保留与旧窗口重叠的尾部, 只补读新的部分
+    size_t kept = 0;
+    if (window_len_ > 0 && start >= window_pos_ && start < window_pos_ + window_len_) {
+        kept = window_pos_ + window_len_ - start;
+        memmove(buffer_.data(), buffer_.data() + (start - window_pos_), kept);
+    }
+
+    size_t filled = kept;
+    while (filled < buffer_.size() && start + filled < size_) {
+        ssize_t n = pread(fd_, buffer_.data() + filled, buffer_.size() - filled,
+                          static_cast<off_t>(start + filled));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        filled += n;
+        bytes_read_ += n;
+    }
+
+    // 超出文件末尾的部分按 0 填充
+    size_t need = pos + len - start;
+    if (filled < need) {
+        if (start + filled < size_) {
+            LOG(ERROR) << "read file failed at " << start + filled;
+            window_len_ = 0;
+            return window;
+        }
+        memset(buffer_.data() + filled, 0, need - filled);
+        filled = need;
+    }
+
+    window_pos_ = start;
+    window_len_ = filled;
+    window.data = buffer_.data();
+    window.pos = window_pos_;
+    window.len = window_len_;
+    return window;
+}
@@ -0,0 +1,84 @@
+//
+// 输入数据源抽象: 解析器通过 fetch 按需取得一段连续只读字节,
+// 不再要求整个文件驻留内存.
+//
+
+#ifndef MEDIAFORMATPARSER_BYTESOURCE_H
+#define MEDIAFORMATPARSER_BYTESOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 流式读取时默认的窗口大小
+#define DEFAULT_STREAM_WINDOW (4 * 1024 * 1024)
+// 越过文件末尾的短读取 (字段读取) 使用的临时缓冲大小
+#define SOURCE_SCRATCH_SIZE 64
+
+// 当前驻留在内存中的一段数据, 覆盖文件区间 [pos, pos + len)
+struct ByteWindow {
+    const unsigned char *data = nullptr;
+    size_t pos = 0;
+    size_t len = 0;
+};
+
+class ByteSource {
+public:
+    virtual ~ByteSource() = default;
+
+    size_t size() const { return size_; }
+    // 从文件读入内存的字节数
+    uint64_t bytes_read() const { return bytes_read_; }
+
+    // 单次 load 能保证驻留的最大字节数
+    virtual size_t capacity() const = 0;
+
+    // 返回至少覆盖 [pos, pos + len) 的窗口, 超出文件末尾的部分按 0 填充.
+    // 返回的窗口在下一次 load 前有效, 失败时 data 为 nullptr
+    virtual ByteWindow load(size_t pos, size_t len) = 0;
+
+protected:
+    size_t size_ = 0;
+    uint64_t bytes_read_ = 0;
+};
+
+// 整个文件已在内存中 (mmap 或堆内存), 零拷贝
+class MemoryByteSource: public ByteSource {
+public:
+    MemoryByteSource(const unsigned char *data, size_t size);
+
+    size_t capacity() const override;
+    ByteWindow load(size_t pos, size_t len) override;
+
+private:
+    const unsigned char *data_;
+    unsigned char scratch_[SOURCE_SCRATCH_SIZE];
+};
+
+// 基于 pread 的定长窗口, 内存占用不随文件大小增长
+class FileByteSource: public ByteSource {
+public:
+    FileByteSource(const std::string& file_path, size_t window_size);
+    // 使用已打开的 fd (不负责关闭), 已读取的文件头部 [0, head_size) 作为初始窗口
+    FileByteSource(int fd, size_t window_size, const unsigned char* head, size_t head_size);
+    ~FileByteSource() override;
+
+    bool is_open() const { return fd_ >= 0; }
+
+    size_t capacity() const override;
+    ByteWindow load(size_t pos, size_t len) override;
+
+private:
+    int init(size_t window_size);
+
+private:
+    int fd_ = -1;
+    bool owns_fd_ = true;
+    std::vector<unsigned char> buffer_;
+    size_t window_pos_ = 0;
+    size_t window_len_ = 0;
+};
+
+
+#endif //MEDIAFORMATPARSER_BYTESOURCE_H
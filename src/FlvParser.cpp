@@ -2,26 +2,30 @@
 // Created by 余泓 on 2025/5/31.
 //
 
-#include <iomanip>
-
 #include "FlvParser.h"
-#include "logger/easylogging++.h"
+#include "TextWriter.h"
+#include "ParserLog.h"
+#include "Tracer.h"
 #include "utils.h"
 
-std::ostream& operator << (std::ostream &out, const Header &h) {
-    out << "flv header:" << std::endl;
-    out << "\tsignature: " << std::string(h.signature, 3) << std::endl;
-    out << "\tversion: " << int(h.version) << std::endl;
-    out << "\thasAudio: " << std::bitset<1>(h.union_byte.bits.audio_flag) << std::endl;
-    out << "\thasVideo: " << std::bitset<1>(h.union_byte.bits.video_flag) << std::endl;
-    out << "\theaderSize: " <<h.header_size << std::endl;
+TextWriter& operator<<(TextWriter &out, const Header &h) {
+    out << "flv header:" << '\n';
+    out << "\tsignature: " << std::string_view(h.signature, 3) << '\n';
+    out << "\tversion: " << int(h.version) << '\n';
+    out << "\thasAudio: " << std::bitset<1>(h.union_byte.bits.audio_flag) << '\n';
+    out << "\thasVideo: " << std::bitset<1>(h.union_byte.bits.video_flag) << '\n';
+    out << "\theaderSize: " <<h.header_size << '\n';
     return out;
 }
 
-std::ostream& operator << (std::ostream &out, const TagHeader &h) {
-    out << "flv tag header:" << std::endl;
+std::ostream& operator<<(std::ostream &out, const Header &h) {
+    return write_text(out, h);
+}
+
+TextWriter& operator<<(TextWriter &out, const TagHeader &h) {
+    out << "flv tag header:" << '\n';
     out << "\ttype: " << int(h.type);
-    std::string type = "unknown";
+    const char* type = "unknown";
     if (h.type == TYPE_AUDIO) {
         type = "audio";
     } else if (h.type == TYPE_VIDEO) {
@@ -29,52 +33,70 @@ std::ostream& operator << (std::ostream &out, const TagHeader &h) {
     } else if (h.type == TYPE_SCRIPT) {
         type = "script";
     }
-    out << " (" + type + ")" << std::endl;
-    out << "\tdataSize: " << h.data_size << std::endl;
-    out << "\ttimestamp: " << h.timestamp << std::endl;
-    out << "\ttimestampExtended: " << int(h.timestamp_extended) << std::endl;
-    out << "\tstreamId: " << h.stream_id << std::endl;
+    out << " (" << type << ")" << '\n';
+    out << "\tdataSize: " << h.data_size << '\n';
+    out << "\ttimestamp: " << h.timestamp << '\n';
+    out << "\ttimestampExtended: " << int(h.timestamp_extended) << '\n';
+    out << "\tstreamId: " << h.stream_id << '\n';
     return out;
 }
 
-std::ostream& operator << (std::ostream &out, const ScriptTagData &d) {
-    out << "script tag data:" << std::endl;
-    out << "\tamf1Type: " << int(d.amf1_type) << std::endl;
-    out << "\tamf1Length: " << d.amf1_len << std::endl;
-    out << "\tamf1Data: " << d.amf1_data << std::endl;
-    out << "\tamf2Type: " << int(d.amf2_type) << std::endl;
-    out << "\tamf2Length: " << d.amf2_len << std::endl;
+std::ostream& operator<<(std::ostream &out, const TagHeader &h) {
+    return write_text(out, h);
+}
+
+TextWriter& operator<<(TextWriter &out, const ScriptTagData &d) {
+    out << "script tag data:" << '\n';
+    out << "\tamf1Type: " << int(d.amf1_type) << '\n';
+    out << "\tamf1Length: " << d.amf1_len << '\n';
+    out << "\tamf1Data: " << d.amf1_data << '\n';
+    out << "\tamf2Type: " << int(d.amf2_type) << '\n';
+    out << "\tamf2Length: " << d.amf2_len << '\n';
     for (int i = 0; i < d.amf2_len; ++i) {
         out<< "\t\t" << d.keys[i] << ": ";
         const AmfValue& amfValue = d.values[i];
         if (amfValue.type == NUMBER) {
-            out << std::fixed << std::setprecision(3) << std::get<double>(amfValue.value);
+            out << fixed_value(std::get<double>(amfValue.value), 3);
         } else if (amfValue.type == BOOLEAN) {
             out << int(std::get<uint8_t>(amfValue.value));
+        } else if (amfValue.length > AMF_INLINE_STRING_MAX) {
+            out << "<" << amfValue.length << " bytes at " << amfValue.offset << ">";
         } else {
            out << std::get<std::string>(amfValue.value);
         }
-        out << std::endl;
+        out << '\n';
     }
     return out;
 }
 
-std::ostream& operator << (std::ostream &out, const AudioTagData &h) {
-    out << "audio tag data:" << std::endl;
-    out << "\tsoundFormat: " << int(h.byte1.bits.sound_format) << std::endl;
-    out << "\tsoundRate: " << int(h.byte1.bits.sound_rate) << std::endl;
-    out << "\tsoundSize: " << int(h.byte1.bits.sound_size) << std::endl;
-    out << "\tsoundType: " << int(h.byte1.bits.sound_type) << std::endl;
+std::ostream& operator<<(std::ostream &out, const ScriptTagData &d) {
+    return write_text(out, d);
+}
+
+TextWriter& operator<<(TextWriter &out, const AudioTagData &h) {
+    out << "audio tag data:" << '\n';
+    out << "\tsoundFormat: " << int(h.byte1.bits.sound_format) << '\n';
+    out << "\tsoundRate: " << int(h.byte1.bits.sound_rate) << '\n';
+    out << "\tsoundSize: " << int(h.byte1.bits.sound_size) << '\n';
+    out << "\tsoundType: " << int(h.byte1.bits.sound_type) << '\n';
     return out;
 }
 
-std::ostream& operator << (std::ostream &out, const VideoTagData &h) {
-    out << "video tag data:" << std::endl;
-    out << "\tframeType: " << int(h.byte1.bits.frame_type) << std::endl;
-    out << "\tencodeType: " << int(h.byte1.bits.encode_type) << std::endl;
+std::ostream& operator<<(std::ostream &out, const AudioTagData &h) {
+    return write_text(out, h);
+}
+
+TextWriter& operator<<(TextWriter &out, const VideoTagData &h) {
+    out << "video tag data:" << '\n';
+    out << "\tframeType: " << int(h.byte1.bits.frame_type) << '\n';
+    out << "\tencodeType: " << int(h.byte1.bits.encode_type) << '\n';
     return out;
 }
 
+std::ostream& operator<<(std::ostream &out, const VideoTagData &h) {
+    return write_text(out, h);
+}
+
 FlvParser::FlvParser(const std::string& file_path): Parser(file_path) {
 
 }
@@ -92,20 +114,77 @@ int FlvParser::custom_parse()  {
         return -2;
     }
 
+    stats_.items = tag_headers_.size();
+    stats_.item_unit = "tags";
+    return 0;
+}
+
+int FlvParser::custom_probe() {
+    stream_info_.format = "flv";
+    if (parse_header() < 0) {
+        return -1;
+    }
+    pos_ = header.header_size;
+
+    // onMetaData 通常是第一个 tag, 只读取开头几个 tag 的头部
+    bool got_meta_data = false;
+    for (int i = 0; i < PROBE_TAG_COUNT && !got_meta_data; ++i) {
+        if (pos_ + 15 > data_size_) {
+            break;
+        }
+        const unsigned char* p = fetch(pos_, 15);
+        uint8_t type = int_value(p[4]);
+        uint32_t data_size = bytes_to_int3_be(p + 5);
+        pos_ += 15;
+        if (type == TYPE_SCRIPT) {
+            if (parse_script_tag_data(pos_) < 0) {
+                LOG(ERROR) << "parse script data failed";
+                return -2;
+            }
+            got_meta_data = true;
+        }
+        pos_ += data_size;
+    }
+
+    stream_info_.has_audio = header.union_byte.bits.audio_flag;
+    stream_info_.has_video = header.union_byte.bits.video_flag;
+    for (size_t i = 0; i < script_tag_data_.keys.size(); ++i) {
+        const AmfValue& value = script_tag_data_.values[i];
+        const std::string& key = script_tag_data_.keys[i];
+        if (value.type == BOOLEAN && key == "stereo") {
+            stream_info_.channels = std::get<uint8_t>(value.value) ? 2 : 1;
+        }
+        if (value.type != NUMBER) {
+            continue;
+        }
+        double number = std::get<double>(value.value);
+        if (key == "duration") {
+            stream_info_.duration = number;
+        } else if (key == "width") {
+            stream_info_.width = static_cast<uint32_t>(number);
+        } else if (key == "height") {
+            stream_info_.height = static_cast<uint32_t>(number);
+        } else if (key == "audiosamplerate") {
+            stream_info_.sample_rate = static_cast<uint32_t>(number);
+        } else if (key == "audiosamplesize") {
+            stream_info_.bits_per_sample = static_cast<uint16_t>(number);
+        } else if (key == "audiodatarate" || key == "videodatarate") {
+            stream_info_.bit_rate += static_cast<uint32_t>(number);
+        }
+    }
     return 0;
 }
 
 int FlvParser::dump_info() {
     std::string file_path = get_output_path() + ".txt";
-    std::ofstream file(file_path);
-    if (!file.is_open()) {
-        LOG(ERROR) << "open file " << file_path << " failed";
+    TextWriter file;
+    if (file.open(file_path) < 0) {
         return -1;
     }
 
-    file << header << std::endl;
+    file << header << '\n';
     int audio_index = 0, video_index = 0, prev_tag_size_index = 0;
-    file << "previous tag size: " << previous_tag_sizes_[prev_tag_size_index++] << std::endl;
+    file << "previous tag size: " << previous_tag_sizes_[prev_tag_size_index++] << '\n';
     for (auto& tag_header: tag_headers_) {
         file << tag_header;
         if (tag_header.type == TYPE_AUDIO) {
@@ -115,13 +194,31 @@ int FlvParser::dump_info() {
         } else if (tag_header.type == TYPE_SCRIPT) {
             file << script_tag_data_;
         }
-        file << "previous tag size: " << previous_tag_sizes_[prev_tag_size_index++] << std::endl;
-        file << std::endl;
+        file << "previous tag size: " << previous_tag_sizes_[prev_tag_size_index++] << '\n';
+        file << '\n';
     }
 
-    file.close();
+    add_bytes_written(file.bytes_written());
+    return file.close();
+}
+int FlvParser::dump_report(ReportWriter& writer) {
+    writer.write(FileRecord{"flv", file_path_, data_size_});
+
+    int audio_index = 0, video_index = 0;
+    for (auto& tag_header: tag_headers_) {
+        uint8_t data_flags = 0;
+        if (tag_header.type == TYPE_AUDIO) {
+            data_flags = audio_data_[audio_index++].byte1.raw;
+        } else if (tag_header.type == TYPE_VIDEO) {
+            data_flags = video_data_[video_index++].byte1.raw;
+        }
+        uint32_t timestamp = tag_header.timestamp | (uint32_t(tag_header.timestamp_extended) << 24);
+        writer.write(FlvTagRecord{tag_header.offset, tag_header.type, tag_header.data_size, timestamp,
+                                  tag_header.stream_id, data_flags});
+    }
     return 0;
 }
+
 int FlvParser::dump_data() {
     if (dump_h264_data() < 0) {
         return -1;
@@ -135,71 +232,74 @@ int FlvParser::dump_data() {
 }
 
 int FlvParser::parse_header() {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__;
 
     if (pos_ + HEADER_LEN > data_size_) {
         LOG(ERROR) << "not enough data";
         return -1;
     }
 
-    if (memcmp(data_ + pos_, "FLV", 3) != 0) {
+    if (memcmp(fetch(pos_, 3), "FLV", 3) != 0) {
         LOG(ERROR) << "invalid signature";
         return -2;
     }
 
-    memcpy(header.signature, data_ + pos_, 3);
+    memcpy(header.signature, fetch(pos_, 3), 3);
     pos_ += 3;
 
-    memcpy(&header.version, data_ + pos_, 1);
+    memcpy(&header.version, fetch(pos_, 1), 1);
     pos_++;
 
-    memcpy(&header.union_byte.raw, data_ + pos_, 1);
+    memcpy(&header.union_byte.raw, fetch(pos_, 1), 1);
     pos_++;
 
-    header.header_size = bytes_to_int4_be(data_ + pos_);
+    header.header_size = bytes_to_int4_be(fetch(pos_, 4));
     pos_ += 4;
 
-    LOG(INFO) << header;
+    MFP_LOG(TRACE) << header;
 
     return 0;
 }
 
 int FlvParser::parse_body() {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__;
     while (true) {
         if (pos_ + 3 >= data_size_) {
-            LOG(DEBUG) << "not enough data to parse previous tag size";
+            MFP_LOG(DEBUG) << "not enough data to parse previous tag size";
             break;
         }
 
-        uint32_t previous_tag_size = bytes_to_int4_be(data_ + pos_);
+        uint32_t previous_tag_size = bytes_to_int4_be(fetch(pos_, 4));
         pos_ += 4;
 
-        LOG(INFO) << "previous tag size " << previous_tag_size;
+        MFP_LOG(TRACE) << "previous tag size " << previous_tag_size;
         previous_tag_sizes_.push_back(previous_tag_size);
 
         TagHeader tag_header{};
-        memcpy(&tag_header.type, data_ + pos_, 1);
+        tag_header.offset = pos_;
+        memcpy(&tag_header.type, fetch(pos_, 1), 1);
         pos_++;
 
-        tag_header.data_size = bytes_to_int3_be(data_ + pos_);
+        tag_header.data_size = bytes_to_int3_be(fetch(pos_, 3));
         pos_ += 3;
 
         if (pos_ + 7 + tag_header.data_size > data_size_) {
             break;
         }
 
-        tag_header.timestamp = bytes_to_int3_be(data_ + pos_);
+        tag_header.timestamp = bytes_to_int3_be(fetch(pos_, 3));
         pos_ += 3;
 
-        memcpy(&tag_header.timestamp_extended, data_ + pos_, 1);
+        memcpy(&tag_header.timestamp_extended, fetch(pos_, 1), 1);
         pos_ ++;
 
-        tag_header.stream_id = bytes_to_int3_be(data_ + pos_);
+        tag_header.stream_id = bytes_to_int3_be(fetch(pos_, 3));
         pos_ += 3;
 
         tag_headers_.push_back(tag_header);
-        LOG(INFO) << tag_header;
+        MFP_LOG(TRACE) << tag_header;
 
         if (tag_header.type == TYPE_AUDIO) {
             parse_audio_tag_data(pos_);
@@ -218,7 +318,8 @@ int FlvParser::parse_body() {
 }
 
 int FlvParser::parse_script_tag_data(size_t pos) {
-    script_tag_data_.amf1_type = int_value(data_[pos]);
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    script_tag_data_.amf1_type = byte_at(pos);
     if (script_tag_data_.amf1_type != 2) {
         LOG(ERROR) << "amf1 type error. got " << script_tag_data_.amf1_type << ", expected 2";
         return -1;
@@ -226,12 +327,12 @@ int FlvParser::parse_script_tag_data(size_t pos) {
 
     pos++;
 
-    script_tag_data_.amf1_len = bytes_to_int2_be(data_ + pos);
+    script_tag_data_.amf1_len = bytes_to_int2_be(fetch(pos, 2));
     pos += 2;
 
 
     for (int i = 0; i < script_tag_data_.amf1_len; ++i) {
-        script_tag_data_.amf1_data.push_back(data_[pos + i]);
+        script_tag_data_.amf1_data.push_back(byte_at(pos + i));
     }
 
     std::string target_data = "onMetaData";
@@ -242,77 +343,129 @@ int FlvParser::parse_script_tag_data(size_t pos) {
 
     pos += script_tag_data_.amf1_len;
 
-    script_tag_data_.amf2_type = int_value(data_[pos]);
+    script_tag_data_.amf2_type = byte_at(pos);
     if (script_tag_data_.amf2_type != 8) {
         LOG(ERROR) << "amf2 type error. got " << script_tag_data_.amf1_type << ", expected 8";
         return -1;
     }
     pos++;
 
-    script_tag_data_.amf2_len = bytes_to_int4_be(data_ + pos);
+    script_tag_data_.amf2_len = bytes_to_int4_be(fetch(pos, 4));
     pos += 4;
 
     for (int i = 0; i < script_tag_data_.amf2_len; ++i) {
-        uint16_t key_len = bytes_to_int2_be(data_ + pos);
+        uint16_t key_len = bytes_to_int2_be(fetch(pos, 2));
         pos += 2;
 
-        script_tag_data_.keys.emplace_back((char*)data_ + pos, key_len);
+        const unsigned char* key = fetch(pos, key_len);
+        if (key == nullptr) {
+            LOG(ERROR) << "read amf2 key of " << key_len << " bytes failed";
+            return -1;
+        }
+        script_tag_data_.keys.emplace_back(reinterpret_cast<const char *>(key), key_len);
         pos += key_len;
 
-        auto type = int_value(data_[pos]);
+        auto type = byte_at(pos);
         pos ++;
         AmfValue value;
         if (type == 0) {
             // number
             value.type = NUMBER;
-            value.value = bytes_to_double_be(data_ + pos);
+            value.value = bytes_to_double_be(fetch(pos, 8));
             pos += 8;
         } else if (type == 1) {
             // boolean
             value.type = BOOLEAN;
-            value.value = int_value(data_[pos]);
+            value.value = byte_at(pos);
             pos += 1;
-        } else if (type == 2) {
-            // string
-            uint16_t str_len = bytes_to_int2_be(data_ + pos);
-            pos += 2;
+        } else if (type == 2 || type == 12) {
+            // string, 12 为长度 4 字节的 long string
+            uint32_t str_len;
+            if (type == 2) {
+                str_len = bytes_to_int2_be(fetch(pos, 2));
+                pos += 2;
+            } else {
+                str_len = bytes_to_int4_be(fetch(pos, 4));
+                pos += 4;
+            }
             value.type = STRING;
-            value.value = std::string((char*)data_ + pos, str_len);
+            value.offset = pos;
+            value.length = str_len;
+            if (str_len <= AMF_INLINE_STRING_MAX) {
+                const unsigned char* str = fetch(pos, str_len);
+                if (str == nullptr) {
+                    LOG(ERROR) << "read amf2 string of " << str_len << " bytes failed";
+                    return -1;
+                }
+                value.value = std::string(reinterpret_cast<const char *>(str), str_len);
+            } else {
+                value.value = std::string();
+            }
             pos += str_len;
         } else {
-            LOG(ERROR) << "amf2 array value type parse error. got " << type << ", expected 0 or 1 or 2";
+            LOG(ERROR) << "amf2 array value type parse error. got " << type << ", expected 0, 1, 2 or 12";
             return -4;
         }
         script_tag_data_.values.push_back(value);
     }
 
-    LOG(INFO) << script_tag_data_;
+    MFP_LOG(TRACE) << script_tag_data_;
+    return 0;
+}
+
+int FlvParser::attachments(std::vector<Attachment>& out) {
+    for (size_t i = 0; i < script_tag_data_.keys.size(); ++i) {
+        const AmfValue& value = script_tag_data_.values[i];
+        if (value.type != STRING) {
+            continue;
+        }
+        // 只读取开头的文件签名
+        const unsigned char* p = fetch(value.offset, 8);
+        if (p == nullptr) {
+            return -1;
+        }
+        Attachment attachment;
+        if (value.length >= 3 && memcmp(p, "\xFF\xD8\xFF", 3) == 0) {
+            attachment.mime = "image/jpeg";
+        } else if (value.length >= 8 && memcmp(p, "\x89PNG\r\n\x1A\n", 8) == 0) {
+            attachment.mime = "image/png";
+        } else {
+            continue;
+        }
+        attachment.description = script_tag_data_.keys[i];
+        attachment.offset = value.offset;
+        attachment.length = value.length;
+        out.push_back(std::move(attachment));
+    }
     return 0;
 }
 
 int FlvParser::parse_audio_tag_data(size_t pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     AudioTagData audio_data{};
-    audio_data.byte1.raw = int_value(data_[pos]);
+    audio_data.byte1.raw = byte_at(pos);
     pos++;
-    audio_data.data = data_ + pos;
+    audio_data.data_pos = pos;
     audio_data_.push_back(audio_data);
-    LOG(INFO) << audio_data;
+    MFP_LOG(TRACE) << audio_data;
     return 0;
 }
 
 int FlvParser::parse_video_tag_data(size_t pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     VideoTagData video_data{};
-    video_data.byte1.raw = int_value(data_[pos]);
+    video_data.byte1.raw = byte_at(pos);
     pos++;
-    video_data.data = data_ + pos;
+    video_data.data_pos = pos;
     video_data_.push_back(video_data);
-    LOG(INFO) << video_data;
+    MFP_LOG(TRACE) << video_data;
     return 0;
 }
 
 int FlvParser::dump_h264_data() {
+    MFP_TRACE_SCOPE(__FUNCTION__);
     std::string h264_file_path = get_output_path() + ".h264";
     std::ofstream h264_file(h264_file_path);
     if (!h264_file.is_open()) {
@@ -329,33 +482,33 @@ int FlvParser::dump_h264_data() {
         VideoTagData& video_data = video_data_[index++];
         if (video_data.byte1.bits.encode_type == 7) {
             uint8_t start_code[4] = {0x00, 0x00, 0x00, 0x01};
-            uint8_t avc_packet_type = int_value(*video_data.data);
+            uint8_t avc_packet_type = byte_at(video_data.data_pos);
             size_t pos = 4;
             // configuration
             if (avc_packet_type == 0) {
                 pos += 4;
                 // LengthSizeMinusOne
-                nalu_len_size_ = (video_data.data[pos] & 0x03) + 1;
+                nalu_len_size_ = (byte_at(video_data.data_pos + pos) & 0x03) + 1;
                 pos++;
 
-                uint8_t sps_num = (video_data.data[pos] & 0x1F);
+                uint8_t sps_num = (byte_at(video_data.data_pos + pos) & 0x1F);
                 pos++;
 
                 for (int i = 0; i < sps_num; ++i) {
-                    uint16_t sps_len = bytes_to_int2_be(video_data.data + pos);
+                    uint16_t sps_len = bytes_to_int2_be(fetch(video_data.data_pos + pos, 2));
                     pos += 2;
                     h264_file.write(reinterpret_cast<char *>(start_code), 4);
-                    h264_file.write(reinterpret_cast<char *>(video_data.data + pos), sps_len);
+                    write_range(h264_file, video_data.data_pos + pos, sps_len);
                     pos += sps_len;
                 }
 
-                uint8_t pps_num = int_value(video_data.data[pos]);
+                uint8_t pps_num = byte_at(video_data.data_pos + pos);
                 pos++;
                 for (int i = 0; i < pps_num; ++i) {
-                    uint16_t pps_len = bytes_to_int2_be(video_data.data + pos);
+                    uint16_t pps_len = bytes_to_int2_be(fetch(video_data.data_pos + pos, 2));
                     pos += 2;
                     h264_file.write(reinterpret_cast<char *>(start_code), 4);
-                    h264_file.write(reinterpret_cast<char *>(video_data.data + pos), pps_len);
+                    write_range(h264_file, video_data.data_pos + pos, pps_len);
                     pos += pps_len;
                 }
             }
@@ -363,25 +516,27 @@ int FlvParser::dump_h264_data() {
             else if (avc_packet_type == 1) {
                 uint32_t data_len = 0;
                 if (nalu_len_size_ == 1) {
-                    data_len = int_value(video_data.data[pos]);
+                    data_len = byte_at(video_data.data_pos + pos);
                 } else if (nalu_len_size_ == 2) {
-                    data_len = bytes_to_int2_be(video_data.data + pos);
+                    data_len = bytes_to_int2_be(fetch(video_data.data_pos + pos, 2));
                 } else if (nalu_len_size_ == 3) {
-                    data_len = bytes_to_int3_be(video_data.data + pos);
+                    data_len = bytes_to_int3_be(fetch(video_data.data_pos + pos, 3));
                 } else if (nalu_len_size_ == 4) {
-                    data_len = bytes_to_int4_be(video_data.data + pos);
+                    data_len = bytes_to_int4_be(fetch(video_data.data_pos + pos, 4));
                 }
                 pos += nalu_len_size_;
 
                 h264_file.write(reinterpret_cast<const char *>(&start_code), 4);
-                h264_file.write(reinterpret_cast<char *>(video_data.data + pos), data_len);
+                write_range(h264_file, video_data.data_pos + pos, data_len);
             }
         }
     }
+    add_bytes_written(h264_file);
     h264_file.close();
     return 0;
 }
 int FlvParser::dump_aac_data() {
+    MFP_TRACE_SCOPE(__FUNCTION__);
     std::string aac_file_path = get_output_path() + ".aac";
     std::ofstream aac_file(aac_file_path);
     if (!aac_file.is_open()) {
@@ -400,14 +555,14 @@ int FlvParser::dump_aac_data() {
         size_t pos = 0;
         // 10: AAC
         if (audio_data.byte1.bits.sound_format == 10) {
-            uint8_t aac_packet_type = int_value(*audio_data.data);
+            uint8_t aac_packet_type = byte_at(audio_data.data_pos);
             pos++;
             // configuration
             if (aac_packet_type == 0) {
-                aac_profile = ((audio_data.data[pos]&0xf8)>>3) - 1;
-                sample_rate_index = ((audio_data.data[pos]&0x07)<<1) | (audio_data.data[pos+1]>>7);
+                aac_profile = ((byte_at(audio_data.data_pos + pos)&0xf8)>>3) - 1;
+                sample_rate_index = ((byte_at(audio_data.data_pos + pos)&0x07)<<1) | (byte_at(audio_data.data_pos + pos+1)>>7);
                 pos++;
-                channel_config = (audio_data.data[pos]>>3) & 0x0f;
+                channel_config = (byte_at(audio_data.data_pos + pos)>>3) & 0x0f;
             }
             // AAC raw
             else if (aac_packet_type == 1) {
@@ -447,10 +602,11 @@ int FlvParser::dump_aac_data() {
                 aac_file.write(reinterpret_cast<const char *>(p64 + 1), adts_header_len);
 
                 // write raw aac data
-                aac_file.write(reinterpret_cast<const char *>(audio_data.data + pos), data_len);
+                write_range(aac_file, audio_data.data_pos + pos, data_len);
             }
         }
     }
+    add_bytes_written(aac_file);
     aac_file.close();
 
     return 0;
@@ -15,6 +15,8 @@
 #define TYPE_AUDIO 8
 #define TYPE_VIDEO 9
 #define TYPE_SCRIPT 18
+// probe 时最多读取的 tag 数量
+#define PROBE_TAG_COUNT 8
 
 union Header5thByte {
     uint8_t raw;
@@ -39,6 +41,7 @@ struct TagHeader {
     uint32_t timestamp;
     uint8_t timestamp_extended;
     uint32_t stream_id;
+    uint64_t offset; // tag 在文件中的偏移
 };
 
 enum AmfValueType {
@@ -47,9 +50,15 @@ enum AmfValueType {
     STRING
 };
 
+// 更长的字符串 (如内嵌的缩略图) 不读入内存
+#define AMF_INLINE_STRING_MAX 1024
+
 struct AmfValue {
     AmfValueType type = NUMBER;
+    // 超过 AMF_INLINE_STRING_MAX 字节的 STRING 只记录位置, value 为空字符串
     std::variant<double, uint8_t, std::string> value;
+    uint64_t offset = 0; // STRING 值的字节在文件中的偏移
+    uint32_t length = 0; // STRING 值的字节数
 };
 
 struct ScriptTagData {
@@ -75,7 +84,7 @@ union AudioData1thByte {
 
 struct AudioTagData {
     AudioData1thByte byte1;
-    unsigned char* data;
+    size_t data_pos; // 数据在文件中的偏移
 };
 
 union VideoData1thByte {
@@ -88,7 +97,7 @@ union VideoData1thByte {
 
 struct VideoTagData {
     VideoData1thByte byte1;
-    unsigned char* data;
+    size_t data_pos; // 数据在文件中的偏移
 };
 
 class FlvParser: public Parser {
@@ -96,10 +105,15 @@ public:
     FlvParser(const std::string& file_path);
     ~FlvParser();
 
+    // onMetaData 中以 JPEG/PNG 数据开头的字符串值 (部分工具写入的缩略图), 描述为键名
+    int attachments(std::vector<Attachment>& out) override;
+
 private:
     int custom_parse() override;
     int dump_info() override;
     int dump_data() override;
+    int custom_probe() override;
+    int dump_report(ReportWriter& writer) override;
 
     int parse_header();
     int parse_body();
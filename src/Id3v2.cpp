@@ -0,0 +1,220 @@
+//
+// ID3v2 的 syncsafe 整数, unsynchronisation 和文本/图片帧解码
+//
+
+#include "Id3v2.h"
+
+#include <algorithm>
+#include <cstring>
+
+uint32_t id3v2_syncsafe(const unsigned char* data) {
+    return ((data[0] & 0x7F) << 21) | ((data[1] & 0x7F) << 14) | ((data[2] & 0x7F) << 7) | (data[3] & 0x7F);
+}
+
+void id3v2_resync(const unsigned char* data, size_t size, std::vector<unsigned char>& out) {
+    out.reserve(out.size() + size);
+    for (size_t i = 0; i < size; ++i) {
+        out.push_back(data[i]);
+        if (data[i] == 0xFF && i + 1 < size && data[i + 1] == 0x00) {
+            i++;
+        }
+    }
+}
+
+bool id3v2_valid_frame_id(const char* id, int len) {
+    for (int i = 0; i < len; ++i) {
+        bool valid = (id[i] >= 'A' && id[i] <= 'Z') || (i > 0 && id[i] >= '0' && id[i] <= '9');
+        if (!valid) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool id3v2_is_picture(const char* frame_id) {
+    return memcmp(frame_id, "APIC", 4) == 0 || (memcmp(frame_id, "PIC", 3) == 0 && frame_id[3] == '\0');
+}
+
+size_t id3v2_terminator_size(uint8_t encoding) {
+    return encoding == ID3V2_ENCODING_UTF16 || encoding == ID3V2_ENCODING_UTF16BE ? 2 : 1;
+}
+
+size_t id3v2_string_length(uint8_t encoding, const unsigned char* data, size_t size) {
+    if (id3v2_terminator_size(encoding) == 1) {
+        const void* end = memchr(data, 0, size);
+        return end ? static_cast<const unsigned char*>(end) - data : size;
+    }
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        if (data[i] == 0 && data[i + 1] == 0) {
+            return i;
+        }
+    }
+    return size;
+}
+
+static void append_utf8(uint32_t code_point, std::string& out) {
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+static void decode_utf16(const unsigned char* data, size_t size, bool big_endian, std::string& out) {
+    // 每个值可以有自己的 BOM
+    if (size >= 2 && ((data[0] == 0xFE && data[1] == 0xFF) || (data[0] == 0xFF && data[1] == 0xFE))) {
+        big_endian = data[0] == 0xFE;
+        data += 2;
+        size -= 2;
+    }
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        uint32_t unit = big_endian ? (data[i] << 8) | data[i + 1] : (data[i + 1] << 8) | data[i];
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < size) {
+            uint32_t low = big_endian ? (data[i + 2] << 8) | data[i + 3] : (data[i + 3] << 8) | data[i + 2];
+            if (low >= 0xDC00 && low < 0xE000) {
+                append_utf8(0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00), out);
+                i += 2;
+                continue;
+            }
+        }
+        append_utf8(unit, out);
+    }
+}
+
+static void decode_value(uint8_t encoding, const unsigned char* data, size_t size, std::string& out) {
+    switch (encoding) {
+        case ID3V2_ENCODING_ISO_8859_1:
+            for (size_t i = 0; i < size; ++i) {
+                append_utf8(data[i], out);
+            }
+            break;
+        case ID3V2_ENCODING_UTF16:
+            // 规范要求有 BOM, 没有时按常见写入端的小端序处理
+            decode_utf16(data, size, false, out);
+            break;
+        case ID3V2_ENCODING_UTF16BE:
+            decode_utf16(data, size, true, out);
+            break;
+        default:
+            out.append(reinterpret_cast<const char*>(data), size);
+            break;
+    }
+}
+
+void id3v2_decode_string(uint8_t encoding, const unsigned char* data, size_t size, std::string& utf8) {
+    size_t terminator = id3v2_terminator_size(encoding);
+    size_t start = utf8.size();
+    while (size > 0) {
+        size_t len = id3v2_string_length(encoding, data, size);
+        if (utf8.size() > start) {
+            utf8 += '/';
+        }
+        decode_value(encoding, data, len, utf8);
+        len = std::min(size, len + terminator);
+        data += len;
+        size -= len;
+    }
+    // 去掉末尾结束符产生的空值
+    while (utf8.size() > start && utf8.back() == '/') {
+        utf8.pop_back();
+    }
+}
+
+int id3v2_decode_text(const char* frame_id, const unsigned char* data, size_t size, std::string& utf8) {
+    if (size < 1) {
+        return -1;
+    }
+    uint8_t encoding = data[0];
+    if (encoding > ID3V2_ENCODING_UTF8) {
+        return -1;
+    }
+    data++;
+    size--;
+
+    bool v22 = frame_id[3] == '\0';
+    bool user_text = v22 ? memcmp(frame_id, "TXX", 3) == 0 : memcmp(frame_id, "TXXX", 4) == 0;
+    bool comment = v22 ? memcmp(frame_id, "COM", 3) == 0 : memcmp(frame_id, "COMM", 4) == 0;
+    if (comment) {
+        // 3 字节语言代码和以 0 结尾的简短描述之后为正文
+        if (size < 3) {
+            return -1;
+        }
+        data += 3;
+        size -= 3;
+        size_t len = std::min(size, id3v2_string_length(encoding, data, size) + id3v2_terminator_size(encoding));
+        data += len;
+        size -= len;
+    } else if (user_text) {
+        size_t len = id3v2_string_length(encoding, data, size);
+        decode_value(encoding, data, len, utf8);
+        utf8 += ": ";
+        len = std::min(size, len + id3v2_terminator_size(encoding));
+        data += len;
+        size -= len;
+    } else if (frame_id[0] != 'T') {
+        return -1;
+    }
+    id3v2_decode_string(encoding, data, size, utf8);
+    return 0;
+}
+
+int id3v2_parse_picture(bool v22, const unsigned char* data, size_t size, Id3v2Picture& picture) {
+    size_t pos = 0;
+    if (size < 1) {
+        return -1;
+    }
+    uint8_t encoding = data[pos++];
+    if (encoding > ID3V2_ENCODING_UTF8) {
+        return -1;
+    }
+
+    if (v22) {
+        // 3 字符的图像格式
+        if (pos + 3 > size) {
+            return -1;
+        }
+        std::string format(reinterpret_cast<const char*>(data + pos), 3);
+        if (format == "JPG") {
+            picture.mime = "image/jpeg";
+        } else if (format == "PNG") {
+            picture.mime = "image/png";
+        } else {
+            picture.mime = "image/" + format;
+        }
+        pos += 3;
+    } else {
+        size_t len = id3v2_string_length(ID3V2_ENCODING_ISO_8859_1, data + pos, size - pos);
+        if (pos + len >= size) {
+            return -1;
+        }
+        picture.mime.assign(reinterpret_cast<const char*>(data + pos), len);
+        pos += len + 1;
+        // MIME 类型可以省略 "image/"
+        if (!picture.mime.empty() && picture.mime.find('/') == std::string::npos) {
+            picture.mime = "image/" + picture.mime;
+        }
+    }
+
+    if (pos >= size) {
+        return -1;
+    }
+    picture.type = data[pos++];
+    size_t len = id3v2_string_length(encoding, data + pos, size - pos);
+    if (pos + len + id3v2_terminator_size(encoding) > size) {
+        return -1;
+    }
+    picture.description.clear();
+    decode_value(encoding, data + pos, len, picture.description);
+    pos += len + id3v2_terminator_size(encoding);
+    return static_cast<int>(pos);
+}
@@ -0,0 +1,90 @@
+//
+// ID3v2.2/2.3/2.4 标签结构和与读取方式无关的解码函数.
+// 解析时只记录各帧负载的位置, 文本和图片在需要时才读取和解码
+//
+// ref: https://id3.org/id3v2-00 https://id3.org/id3v2.3.0
+//      https://id3.org/id3v2.4.0-structure https://id3.org/id3v2.4.0-frames
+
+#ifndef MEDIAFORMATPARSER_ID3V2_H
+#define MEDIAFORMATPARSER_ID3V2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define ID3V2_HEADER_SIZE 10
+#define ID3V2_FOOTER_SIZE 10
+
+// 标签头 flags
+#define ID3V2_FLAG_UNSYNCHRONISATION 0x80
+#define ID3V2_FLAG_EXTENDED_HEADER 0x40  // v2.2 中为压缩标志
+#define ID3V2_FLAG_FOOTER 0x10           // 仅 v2.4
+
+// 文本编码
+#define ID3V2_ENCODING_ISO_8859_1 0
+#define ID3V2_ENCODING_UTF16 1           // 带 BOM
+#define ID3V2_ENCODING_UTF16BE 2         // 仅 v2.4
+#define ID3V2_ENCODING_UTF8 3            // 仅 v2.4
+
+struct Id3v2Header {
+    char id[3];
+    uint8_t version[2];
+    uint8_t flags;
+    uint32_t size;
+};
+
+struct Id3v2ExtendedHeader {
+    uint32_t header_size;
+    uint16_t flags;
+    uint32_t padding_size;
+};
+
+struct Id3v2FrameHeader {
+    char frame_id[4];          // v2.2 的帧 ID 为 3 个字符, 第 4 个字符为 '\0'
+    uint32_t size;             // 帧头之后的字节数
+    uint16_t flags;
+    // 负载 (跳过分组, 加密方式和长度等附加字节之后) 的位置和存储字节数.
+    // buffered 为 true 时是重同步后的标签缓冲区中的偏移, 否则是文件偏移
+    uint64_t data_offset = 0;
+    uint32_t data_size = 0;
+    bool buffered = false;
+    bool unsynchronised = false;  // 负载仍需去除 unsynchronisation
+    bool compressed = false;      // zlib 压缩, 不支持解码
+    bool encrypted = false;
+};
+
+// APIC (v2.2 为 PIC) 帧, 图像数据只记录位置
+struct Id3v2Picture {
+    std::string mime;          // v2.2 的 3 字符图像格式会转为 MIME 类型
+    uint8_t type = 0;          // 图片类型, 3 为封面
+    std::string description;   // UTF-8
+    uint64_t data_offset = 0;  // 图像数据的文件偏移
+    uint64_t data_size = 0;
+    // false 表示文件中不是原样的图像字节 (经过 unsynchronisation 或位于重同步后的标签缓冲区),
+    // data_offset/data_size 无效, 需要通过 read_id3v2_frame 读取整个负载
+    bool contiguous = true;
+};
+
+// 4 字节 syncsafe 整数, 每字节只用低 7 位
+uint32_t id3v2_syncsafe(const unsigned char* data);
+// 去除 unsynchronisation (0xFF 之后插入的 0x00), 结果追加到 out
+void id3v2_resync(const unsigned char* data, size_t size, std::vector<unsigned char>& out);
+// 帧 ID 的每个字符都是大写字母或数字 (第一个字符必须是字母)
+bool id3v2_valid_frame_id(const char* id, int len);
+
+// 按编码字节将字符串转为 UTF-8, 多个以 0 分隔的值之间用 '/' 连接
+void id3v2_decode_string(uint8_t encoding, const unsigned char* data, size_t size, std::string& utf8);
+// 返回从 data 开始的以 0 结尾的字符串长度 (不含结束符), 没有结束符时返回 size.
+// UTF-16 编码的结束符为偶数位置上的两个 0 字节
+size_t id3v2_string_length(uint8_t encoding, const unsigned char* data, size_t size);
+size_t id3v2_terminator_size(uint8_t encoding);
+
+// 解码文本帧负载: T*** 为全部文本, TXXX 为 "描述: 值", COMM 为注释正文. 其他帧返回 -1
+int id3v2_decode_text(const char* frame_id, const unsigned char* data, size_t size, std::string& utf8);
+// 解析 APIC/PIC 负载中图像数据之前的部分, 返回图像数据在负载中的偏移, 格式错误时返回 -1
+int id3v2_parse_picture(bool v22, const unsigned char* data, size_t size, Id3v2Picture& picture);
+bool id3v2_is_picture(const char* frame_id);
+
+
+#endif //MEDIAFORMATPARSER_ID3V2_H
@@ -0,0 +1,17 @@
+//
+// 库日志的运行期配置, 不依赖 easylogging++ 头文件.
+// 库本身不做任何日志配置, 也不创建日志文件; 未配置时沿用 easylogging++ 默认格式输出到控制台
+//
+
+#ifndef MEDIAFORMATPARSER_LOGCONFIG_H
+#define MEDIAFORMATPARSER_LOGCONFIG_H
+
+// 开启后解析过程中 WARNING 以下的日志 (MFP_LOG) 在运行期跳过, 批量解析的汇总和 --stats 的统计仍然输出
+void set_log_quiet(bool quiet);
+// 关闭后所有日志都不再输出
+void set_log_enabled(bool enabled);
+// 命令行使用的带颜色的控制台日志格式
+void init_console_log();
+
+
+#endif //MEDIAFORMATPARSER_LOGCONFIG_H
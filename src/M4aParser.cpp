@@ -4,11 +4,16 @@
 
 #include "M4aParser.h"
 #include "utils.h"
-#include "logger/easylogging++.h"
+#include "ParserLog.h"
+#include "Tracer.h"
+
+TextWriter& operator<<(TextWriter& out, const Atom& a) {
+    a.print(out);
+    return out;
+}
 
 std::ostream& operator<<(std::ostream& os, const Atom& a) {
-    a.print(os);
-    return os;
+    return write_text(os, a);
 }
 
 M4aParser::M4aParser(const std::string& filePath): Parser(filePath) {
@@ -20,7 +25,8 @@ M4aParser::~M4aParser() {
 }
 
 uint64_t M4aParser::parse_atom(size_t start_pos, size_t end_pos, Atom* parent) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__;
     if (parent == nullptr) {
         LOG(ERROR) << "parent is null";
         return 0;
@@ -36,14 +42,15 @@ uint64_t M4aParser::parse_atom(size_t start_pos, size_t end_pos, Atom* parent) {
         return 0;
     }
 
+    size_t atom_pos = start_pos;
     size_t pos = start_pos;
-    uint32_t size = bytes_to_int4_be(data_ + pos);
+    uint32_t size = bytes_to_int4_be(fetch(pos, 4));
     pos += 4;
 
     uint64_t data_size = size;
 
     char type[4];
-    memcpy(type, data_ + pos, 4);
+    memcpy(type, fetch(pos, 4), 4);
 
     pos += 4;
 
@@ -54,7 +61,7 @@ uint64_t M4aParser::parse_atom(size_t start_pos, size_t end_pos, Atom* parent) {
             return 0;
         }
 
-        extended_size = bytes_to_int8_be(data_ + pos);
+        extended_size = bytes_to_int8_be(fetch(pos, 8));
         data_size = extended_size;
         pos += 8;
     }
@@ -68,7 +75,7 @@ uint64_t M4aParser::parse_atom(size_t start_pos, size_t end_pos, Atom* parent) {
     start_pos = pos;
 
     std::string type_str = std::string(type, 4);
-    LOG(DEBUG) << "got atom " << type_str;
+    MFP_LOG(DEBUG) << "got atom " << type_str;
 
     // if is a leaf atom
     if (leaf_parse_func.count(type_str)) {
@@ -78,8 +85,10 @@ uint64_t M4aParser::parse_atom(size_t start_pos, size_t end_pos, Atom* parent) {
         } else {
             child->size = size;
             child->extended_size = extended_size;
+            child->offset = atom_pos;
             parent->children.push_back(child);
-            LOG(INFO) << *child;
+            stats_.items++;
+            MFP_LOG(TRACE) << *child;
         }
     } else {
         // is a container
@@ -87,10 +96,12 @@ uint64_t M4aParser::parse_atom(size_t start_pos, size_t end_pos, Atom* parent) {
         atom->size = size;
         memcpy(atom->type, type, 4);
         atom->extended_size = extended_size;
+        atom->offset = atom_pos;
 
         if (parent) {
             parent->children.push_back(atom);
         }
+        stats_.items++;
 
         // parse children
         while (start_pos < data_end_pos) {
@@ -101,14 +112,21 @@ uint64_t M4aParser::parse_atom(size_t start_pos, size_t end_pos, Atom* parent) {
             }
             start_pos += child_size;
         }
+
+        // sample description 的布局取决于轨道类型, 需要等 trak 内的 hdlr 和 stsd 都解析完成
+        if (memcmp(type, TYPE_TRAK, 4) == 0) {
+            parse_sound_description(atom);
+        }
     }
     return data_size;
 }
 
 int M4aParser::custom_parse() {
+    stats_.item_unit = "atoms";
     while (pos_ < data_size_) {
         auto child_size = parse_atom(pos_, data_size_, &root);
-        if (child_size < 0) {
+        // parse_atom 出错时返回 0, 继续循环会停在原位置
+        if (child_size == 0) {
             LOG(ERROR) << "not enough data 6";
             return -1;
         }
@@ -117,20 +135,360 @@ int M4aParser::custom_parse() {
     return 0;
 }
 
+int M4aParser::custom_probe() {
+    stream_info_.format = "m4a";
+
+    // 顶层只读取 atom 头部并跳过 mdat 等负载, moov 位于文件末尾时也只需定点读取
+    while (pos_ + 8 <= data_size_) {
+        const unsigned char* p = fetch(pos_, 16);
+        uint64_t atom_size = bytes_to_int4_be(p);
+        if (atom_size == 1) {
+            atom_size = bytes_to_int8_be(p + 8);
+        } else if (atom_size == 0) {
+            // size 为 0 表示一直延伸到文件末尾
+            atom_size = data_size_ - pos_;
+        }
+        if (atom_size < 8) {
+            LOG(ERROR) << "invalid atom size " << atom_size;
+            return -1;
+        }
+
+        if (memcmp(p + 4, TYPE_FTYP, 4) == 0 || memcmp(p + 4, TYPE_MOOV, 4) == 0) {
+            if (parse_atom(pos_, data_size_, &root) == 0) {
+                return -2;
+            }
+        }
+        pos_ += atom_size;
+    }
+
+    Atom* moov = find_atom(&root, TYPE_MOOV);
+    if (moov == nullptr) {
+        LOG(ERROR) << "moov not found";
+        return -3;
+    }
+
+    for (auto *child: moov->children) {
+        if (memcmp(child->type, TYPE_MVHD, 4) == 0) {
+            auto *mvhd = static_cast<MvhdAtom*>(child);
+            if (mvhd->time_scale > 0) {
+                stream_info_.duration = static_cast<double>(mvhd->duration) / mvhd->time_scale;
+            }
+        } else if (memcmp(child->type, TYPE_TRAK, 4) == 0) {
+            auto *hdlr = static_cast<HdlrAtom*>(find_atom(child, TYPE_HDLR));
+            if (hdlr == nullptr) {
+                continue;
+            }
+            if (memcmp(hdlr->component_subtype, "soun", 4) == 0) {
+                stream_info_.has_audio = true;
+                // 音频轨道的 time scale 即采样率
+                auto *mdhd = static_cast<MdhdAtom*>(find_atom(child, TYPE_MDHD));
+                if (mdhd) {
+                    stream_info_.sample_rate = mdhd->time_scale;
+                }
+
+                auto *stsd = static_cast<StsdAtom*>(find_atom(child, TYPE_STSD));
+                if (stsd == nullptr || stsd->sample_description_table.empty()
+                    || !stsd->sample_description_table[0]->is_sound) {
+                    continue;
+                }
+                const MediaDataAtom* entry = stsd->sample_description_table[0];
+                stream_info_.channels = entry->channels;
+                stream_info_.bits_per_sample = entry->sample_size;
+                if (entry->avg_bitrate > 0) {
+                    stream_info_.bit_rate = static_cast<uint32_t>(entry->avg_bitrate / 1000.0 + 0.5);
+                    continue;
+                }
+
+                // 没有 esds 码率时按 stsz 中的样本总大小和轨道时长估算
+                auto *stsz = static_cast<StszAtom*>(find_atom(child, TYPE_STSZ));
+                if (stsz == nullptr || mdhd == nullptr || mdhd->time_scale == 0 || mdhd->duration == 0) {
+                    continue;
+                }
+                uint64_t bytes = 0;
+                if (stsz->sample_size != 0) {
+                    bytes = static_cast<uint64_t>(stsz->sample_size) * stsz->entry_num;
+                } else {
+                    for (auto sample_size: stsz->sample_size_table) {
+                        bytes += sample_size;
+                    }
+                }
+                double duration = static_cast<double>(mdhd->duration) / mdhd->time_scale;
+                stream_info_.bit_rate = static_cast<uint32_t>(bytes * 8 / duration / 1000 + 0.5);
+            } else if (memcmp(hdlr->component_subtype, "vide", 4) == 0) {
+                stream_info_.has_video = true;
+                auto *tkhd = static_cast<TkhdAtom*>(find_atom(child, TYPE_TKHD));
+                if (tkhd) {
+                    stream_info_.width = static_cast<uint32_t>(tkhd->track_width);
+                    stream_info_.height = static_cast<uint32_t>(tkhd->track_height);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+Atom* M4aParser::find_atom(Atom* atom, const char* type) {
+    for (auto *child: atom->children) {
+        if (memcmp(child->type, type, 4) == 0) {
+            return child;
+        }
+        Atom* found = find_atom(child, type);
+        if (found) {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+uint64_t M4aParser::read_atom_header(size_t pos, size_t end, char type[4], size_t& header_size) {
+    if (pos + 8 > end) {
+        return 0;
+    }
+    const unsigned char* p = fetch(pos, 16);
+    uint64_t atom_size = bytes_to_int4_be(p);
+    memcpy(type, p + 4, 4);
+    header_size = 8;
+    if (atom_size == 1) {
+        if (pos + 16 > end) {
+            return 0;
+        }
+        atom_size = bytes_to_int8_be(p + 8);
+        header_size = 16;
+    } else if (atom_size == 0) {
+        // size 为 0 表示一直延伸到父 atom 末尾
+        atom_size = end - pos;
+    }
+    if (atom_size < header_size || atom_size > end - pos) {
+        return 0;
+    }
+    return atom_size;
+}
+
+size_t M4aParser::find_child_atom(size_t pos, size_t end, const char* type, uint64_t& atom_size, size_t& header_size) {
+    char child_type[4];
+    while (pos < end) {
+        atom_size = read_atom_header(pos, end, child_type, header_size);
+        if (atom_size == 0) {
+            break;
+        }
+        if (memcmp(child_type, type, 4) == 0) {
+            return pos;
+        }
+        pos += atom_size;
+    }
+    return end;
+}
+
+void M4aParser::parse_sound_description(Atom* trak) {
+    auto *hdlr = static_cast<HdlrAtom*>(find_atom(trak, TYPE_HDLR));
+    if (hdlr == nullptr || memcmp(hdlr->component_subtype, "soun", 4) != 0) {
+        return;
+    }
+    auto *stsd = static_cast<StsdAtom*>(find_atom(trak, TYPE_STSD));
+    if (stsd == nullptr) {
+        return;
+    }
+
+    for (auto *entry: stsd->sample_description_table) {
+        size_t end = entry->offset + entry->sample_description_size;
+        if (entry->sample_description_size < SOUND_DESCRIPTION_SIZE || end > data_size_) {
+            LOG(WARNING) << "invalid sound description size " << entry->sample_description_size;
+            continue;
+        }
+
+        // 跳过 size, data format, reserved 和 data reference index
+        size_t pos = entry->offset + 16;
+        const unsigned char* p = fetch(pos, SOUND_DESCRIPTION_SIZE - 16);
+        entry->version = bytes_to_int2_be(p);
+        // revision level: 2, vendor: 4
+        entry->channels = bytes_to_int2_be(p + 8);
+        entry->sample_size = bytes_to_int2_be(p + 10);
+        // compression id: 2, packet size: 2
+        // 采样率为 16.16 定点数
+        entry->sample_rate = bytes_to_int4_be(p + 16) >> 16;
+        entry->is_sound = true;
+        pos = entry->offset + SOUND_DESCRIPTION_SIZE;
+
+        if (entry->version == 1) {
+            pos += SOUND_DESCRIPTION_V1_EXTRA;
+        } else if (entry->version == 2) {
+            if (pos + SOUND_DESCRIPTION_V2_EXTRA > end) {
+                LOG(WARNING) << "sound description v2 truncated";
+                continue;
+            }
+            // version 2 中前面的字段为固定值, 实际参数位于扩展部分
+            p = fetch(pos, SOUND_DESCRIPTION_V2_EXTRA);
+            uint64_t rate_bits = bytes_to_int8_be(p + 4);
+            double sample_rate;
+            memcpy(&sample_rate, &rate_bits, sizeof(sample_rate));
+            entry->sample_rate = static_cast<uint32_t>(sample_rate);
+            entry->channels = static_cast<uint16_t>(bytes_to_int4_be(p + 12));
+            entry->sample_size = static_cast<uint16_t>(bytes_to_int4_be(p + 20));
+            pos += SOUND_DESCRIPTION_V2_EXTRA;
+        }
+
+        // esds 可能直接位于 sample description 中, QuickTime 文件则放在 wave atom 里
+        uint64_t atom_size = 0;
+        size_t header_size = 0;
+        size_t esds_pos = find_child_atom(pos, end, TYPE_ESDS, atom_size, header_size);
+        if (esds_pos == end) {
+            size_t wave_pos = find_child_atom(pos, end, TYPE_WAVE, atom_size, header_size);
+            if (wave_pos == end) {
+                continue;
+            }
+            size_t wave_end = wave_pos + atom_size;
+            esds_pos = find_child_atom(wave_pos + header_size, wave_end, TYPE_ESDS, atom_size, header_size);
+            if (esds_pos == wave_end) {
+                continue;
+            }
+        }
+        // esds 为 full atom, 跳过 version 和 flags
+        parse_esds(esds_pos + header_size + 4, esds_pos + atom_size, entry);
+    }
+}
+
+void M4aParser::parse_esds(size_t pos, size_t end, MediaDataAtom* entry) {
+    // descriptor 头部为 1 字节 tag 加 1~4 字节长度, 长度每字节低 7 位有效, 最高位表示后续还有字节
+    auto read_descriptor = [this, end](size_t& at, uint8_t& tag) -> uint32_t {
+        if (at + 2 > end) {
+            return 0;
+        }
+        tag = byte_at(at++);
+        uint32_t length = 0;
+        for (int i = 0; i < 4 && at < end; ++i) {
+            uint8_t b = byte_at(at++);
+            length = (length << 7) | (b & 0x7F);
+            if ((b & 0x80) == 0) {
+                break;
+            }
+        }
+        return length;
+    };
+
+    uint8_t tag = 0;
+    uint32_t length = read_descriptor(pos, tag);
+    if (tag != ES_DESCRIPTOR_TAG || length < 3 || pos + 3 > end) {
+        return;
+    }
+    // ES_ID: 2
+    pos += 2;
+    uint8_t flags = byte_at(pos++);
+    if (flags & 0x80) {
+        // dependsOn_ES_ID
+        pos += 2;
+    }
+    if ((flags & 0x40) && pos < end) {
+        // URL
+        pos += 1 + byte_at(pos);
+    }
+    if (flags & 0x20) {
+        // OCR_ES_Id
+        pos += 2;
+    }
+
+    length = read_descriptor(pos, tag);
+    // objectTypeIndication: 1, streamType: 1, bufferSizeDB: 3, maxBitrate: 4, avgBitrate: 4
+    if (tag != DECODER_CONFIG_DESCRIPTOR_TAG || length < 13 || pos + 13 > end) {
+        return;
+    }
+    const unsigned char* p = fetch(pos, 13);
+    entry->max_bitrate = bytes_to_int4_be(p + 5);
+    entry->avg_bitrate = bytes_to_int4_be(p + 9);
+}
+
+int M4aParser::attachments(std::vector<Attachment>& out) {
+    Atom* moov = find_atom(&root, TYPE_MOOV);
+    if (moov == nullptr) {
+        return -1;
+    }
+
+    // iTunes 元数据位于 moov/udta/meta, 部分写入端直接放在 moov/meta
+    Atom* meta = nullptr;
+    for (auto *child: moov->children) {
+        if (memcmp(child->type, TYPE_UDTA, 4) == 0) {
+            for (auto *udta_child: child->children) {
+                if (memcmp(udta_child->type, TYPE_META, 4) == 0) {
+                    meta = udta_child;
+                    break;
+                }
+            }
+        } else if (memcmp(child->type, TYPE_META, 4) == 0 && meta == nullptr) {
+            meta = child;
+        }
+    }
+    if (meta == nullptr) {
+        return 0;
+    }
+
+    // meta 的子 atom 不在 atom 树中, 直接按头部逐层查找, 不读取图片数据
+    char type[4];
+    size_t header_size = 0;
+    uint64_t atom_size = read_atom_header(meta->offset, data_size_, type, header_size);
+    if (atom_size == 0) {
+        return -2;
+    }
+    size_t pos = meta->offset + header_size;
+    size_t end = meta->offset + atom_size;
+    // ISO/IEC 14496-12 中 meta 是 full atom, 子 atom 之前有 4 字节 version 和 flags, QuickTime 中没有
+    if (pos + 4 <= end && bytes_to_int4_be(fetch(pos, 4)) == 0) {
+        pos += 4;
+    }
+
+    size_t ilst_pos = find_child_atom(pos, end, TYPE_ILST, atom_size, header_size);
+    if (ilst_pos == end) {
+        return 0;
+    }
+    end = ilst_pos + atom_size;
+    size_t covr_pos = find_child_atom(ilst_pos + header_size, end, TYPE_COVR, atom_size, header_size);
+    if (covr_pos == end) {
+        return 0;
+    }
+
+    // covr 中每个 data atom 是一张图片
+    end = covr_pos + atom_size;
+    pos = covr_pos + header_size;
+    while (pos < end) {
+        atom_size = read_atom_header(pos, end, type, header_size);
+        if (atom_size == 0) {
+            break;
+        }
+        if (memcmp(type, TYPE_DATA, 4) == 0 && atom_size >= header_size + DATA_ATOM_PREFIX_SIZE) {
+            // type indicator: 1 字节保留 + 3 字节 well-known type
+            uint32_t data_type = bytes_to_int3_be(fetch(pos + header_size + 1, 3));
+            Attachment attachment;
+            if (data_type == DATA_TYPE_JPEG) {
+                attachment.mime = "image/jpeg";
+            } else if (data_type == DATA_TYPE_PNG) {
+                attachment.mime = "image/png";
+            } else if (data_type == DATA_TYPE_BMP) {
+                attachment.mime = "image/bmp";
+            } else {
+                attachment.mime = "application/octet-stream";
+            }
+            attachment.description = TYPE_COVR;
+            attachment.offset = pos + header_size + DATA_ATOM_PREFIX_SIZE;
+            attachment.length = atom_size - header_size - DATA_ATOM_PREFIX_SIZE;
+            out.push_back(std::move(attachment));
+        }
+        pos += atom_size;
+    }
+    return 0;
+}
+
 Atom* M4aParser::parse_ftyp(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     FtypAtom *atom = new FtypAtom();
 
-    memcpy(atom->major_brand, data_ + data_pos, 4);
+    memcpy(atom->major_brand, fetch(data_pos, 4), 4);
     data_pos += 4;
 
-    memcpy(atom->minor_version, data_ + data_pos, 4);
+    memcpy(atom->minor_version, fetch(data_pos, 4), 4);
     data_pos += 4;
 
     int cur_len = 16;
     while (cur_len + 4 <= size) {
         char* band = new char[4];
-        memcpy(band, data_ + data_pos, 4);
+        memcpy(band, fetch(data_pos, 4), 4);
         atom->compatible_brands.push_back(band);
         data_pos += 4;
         cur_len += 4;
@@ -140,7 +498,7 @@ Atom* M4aParser::parse_ftyp(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_free(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     FreeAtom *atom = new FreeAtom();
     atom->free_space = size - 8;
 
@@ -148,7 +506,7 @@ Atom* M4aParser::parse_free(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_skip(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     SkipAtom *atom = new SkipAtom();
     atom->free_space = size - 8;
 
@@ -156,120 +514,120 @@ Atom* M4aParser::parse_skip(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_wide(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     WideAtom *atom = new WideAtom();
 
     return atom;
 }
 
 Atom* M4aParser::parse_mdat(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     MdatAtom *atom = new MdatAtom();
-    atom->data = data_ + data_pos;
+    atom->data_pos = data_pos;
     return atom;
 }
 
 Atom* M4aParser::parse_pnot(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto *atom = new PnotAtom();
 
-    atom->modification_date = bytes_to_int4_be(data_ + data_pos);
+    atom->modification_date = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->version_number = bytes_to_int2_be(data_ + data_pos);
+    atom->version_number = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->atom_type = bytes_to_int4_be(data_ + data_pos);
+    atom->atom_type = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->atom_index = bytes_to_int2_be(data_ + data_pos);
+    atom->atom_index = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
     return atom;
 }
 
 Atom* M4aParser::parse_mvhd(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto *atom = new MvhdAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->creation_time = bytes_to_int4_be(data_ + data_pos);
+    atom->creation_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->modification_time = bytes_to_int4_be(data_ + data_pos);
+    atom->modification_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->time_scale = bytes_to_int4_be(data_ + data_pos);
+    atom->time_scale = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->duration = bytes_to_int4_be(data_ + data_pos);
+    atom->duration = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->preferred_rate = bytes_to_fixed4_be(data_ + data_pos);;
+    atom->preferred_rate = bytes_to_fixed4_be(fetch(data_pos, 4));;
     data_pos += 4;
 
-    atom->preferred_volume = bytes_to_fixed2_be(data_ + data_pos);
+    atom->preferred_volume = bytes_to_fixed2_be(fetch(data_pos, 2));
     data_pos += 2;
 
     for (int & i : atom->matrix_structure) {
-        memcpy(&i, data_ + data_pos, 4);
+        memcpy(&i, fetch(data_pos, 4), 4);
         data_pos += 4;
     }
 
-    atom->preview_time = bytes_to_int4_be(data_ + data_pos);
+    atom->preview_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->preview_duration = bytes_to_int4_be(data_ + data_pos);
+    atom->preview_duration = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->poster_time = bytes_to_int4_be(data_ + data_pos);
+    atom->poster_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->selection_time = bytes_to_int4_be(data_ + data_pos);
+    atom->selection_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->selection_duration = bytes_to_int4_be(data_ + data_pos);
+    atom->selection_duration = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->current_time = bytes_to_int4_be(data_ + data_pos);
+    atom->current_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->next_track_id = bytes_to_int4_be(data_ + data_pos);
+    atom->next_track_id = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     return atom;
 }
 
 Atom* M4aParser::parse_ctab(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto *atom = new CtabAtom();
 
-    atom->color_table_seed = bytes_to_int4_be(data_ + data_pos);
+    atom->color_table_seed = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->color_table_flags = bytes_to_int2_be(data_ + data_pos);
+    atom->color_table_flags = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->color_table_size = bytes_to_int2_be(data_ + data_pos);
+    atom->color_table_size = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
     for (int i = 0; i < atom->color_table_size; ++i) {
         Color color{};
-        color.first = bytes_to_int2_be(data_ + data_pos);
+        color.first = bytes_to_int2_be(fetch(data_pos, 2));
         data_pos += 2;
 
-        color.red = bytes_to_int2_be(data_ + data_pos);
+        color.red = bytes_to_int2_be(fetch(data_pos, 2));
         data_pos += 2;
 
-        color.green = bytes_to_int2_be(data_ + data_pos);
+        color.green = bytes_to_int2_be(fetch(data_pos, 2));
         data_pos += 2;
 
-        color.blue = bytes_to_int2_be(data_ + data_pos);
+        color.blue = bytes_to_int2_be(fetch(data_pos, 2));
         data_pos += 2;
 
         atom->color_array.push_back(color);
@@ -279,143 +637,143 @@ Atom* M4aParser::parse_ctab(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_tkhd(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto *atom = new TkhdAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->creation_time = bytes_to_int4_be(data_ + data_pos);
+    atom->creation_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->modification_time = bytes_to_int4_be(data_ + data_pos);
+    atom->modification_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->track_id = bytes_to_int4_be(data_ + data_pos);
+    atom->track_id = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->reserved1 = bytes_to_int4_be(data_ + data_pos);
+    atom->reserved1 = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->duration = bytes_to_int4_be(data_ + data_pos);
+    atom->duration = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->reserved2 = bytes_to_int8_be(data_ + data_pos);
+    atom->reserved2 = bytes_to_int8_be(fetch(data_pos, 8));
     data_pos += 8;
 
-    atom->layer = bytes_to_int2_be(data_ + data_pos);
+    atom->layer = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->alternate_group = bytes_to_int2_be(data_ + data_pos);
+    atom->alternate_group = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->volume = bytes_to_fixed2_be(data_ + data_pos);
+    atom->volume = bytes_to_fixed2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->reserved3 = bytes_to_int2_be(data_ + data_pos);
+    atom->reserved3 = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
     for (int & i : atom->matrix_structure) {
-        memcpy(&i, data_ + data_pos, 4);
+        memcpy(&i, fetch(data_pos, 4), 4);
         data_pos += 4;
     }
 
-    atom->track_width = bytes_to_fixed4_be(data_ + data_pos);
+    atom->track_width = bytes_to_fixed4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->track_height = bytes_to_fixed4_be(data_ + data_pos);
+    atom->track_height = bytes_to_fixed4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     return atom;
 }
 
 Atom* M4aParser::parse_txas(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto *atom = new TxasAtom();
     return atom;
 }
 
 Atom* M4aParser::parse_clef(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto atom = new ClefAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->width = bytes_to_fixed4_be(data_ + data_pos);
+    atom->width = bytes_to_fixed4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->height = bytes_to_fixed4_be(data_ + data_pos);
+    atom->height = bytes_to_fixed4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     return atom;
 }
 
 Atom* M4aParser::parse_prof(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto atom = new ProfAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->width = bytes_to_fixed4_be(data_ + data_pos);
+    atom->width = bytes_to_fixed4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->height = bytes_to_fixed4_be(data_ + data_pos);
+    atom->height = bytes_to_fixed4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     return atom;
 }
 
 Atom* M4aParser::parse_enof(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto atom = new EnofAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->width = bytes_to_fixed4_be(data_ + data_pos);
+    atom->width = bytes_to_fixed4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->height = bytes_to_fixed4_be(data_ + data_pos);
+    atom->height = bytes_to_fixed4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     return atom;
 }
 
 Atom* M4aParser::parse_elst(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto atom = new ElstAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->entry_num = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_num = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     for (size_t i = 0; i < atom->entry_num; ++i) {
-        uint32_t track_duration = bytes_to_int4_be(data_ + data_pos);
+        uint32_t track_duration = bytes_to_int4_be(fetch(data_pos, 4));
         data_pos += 4;
 
-        uint32_t media_time = bytes_to_int4_be(data_ + data_pos);
+        uint32_t media_time = bytes_to_int4_be(fetch(data_pos, 4));
         data_pos += 4;
 
-        float media_rate = bytes_to_fixed4_be(data_ + data_pos);
+        float media_rate = bytes_to_fixed4_be(fetch(data_pos, 4));
         data_pos += 4;
 
         atom->edit_list_table.push_back({track_duration, media_time, media_rate});
@@ -425,70 +783,70 @@ Atom* M4aParser::parse_elst(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_load(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_LOG(DEBUG) << __FUNCTION__;
     auto atom = new LoadAtom();
 
-    atom->preload_start_time = bytes_to_int4_be(data_ + data_pos);
+    atom->preload_start_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->preload_duration = bytes_to_int4_be(data_ + data_pos);
+    atom->preload_duration = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->preload_flags = bytes_to_int4_be(data_ + data_pos);
+    atom->preload_flags = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->default_hints = bytes_to_int4_be(data_ + data_pos);
+    atom->default_hints = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     return atom;
 }
 
 Atom* M4aParser::parse_mdhd(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new MdhdAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->creation_time = bytes_to_int4_be(data_ + data_pos);
+    atom->creation_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->modification_time = bytes_to_int4_be(data_ + data_pos);
+    atom->modification_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->time_scale = bytes_to_int4_be(data_ + data_pos);
+    atom->time_scale = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->duration = bytes_to_int4_be(data_ + data_pos);
+    atom->duration = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->language = bytes_to_int2_be(data_ + data_pos);
+    atom->language = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->quality = bytes_to_int2_be(data_ + data_pos);
+    atom->quality = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
     return atom;
 }
 
 Atom* M4aParser::parse_elng(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new ElngAtom();
 
     auto end_pos = data_pos + size - 8;
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
     bool got_str_end = false;
     while (data_pos < end_pos) {
-        char c = data_[data_pos++];
+        char c = byte_at(data_pos++);
         if (c == 0) {
             got_str_end = true;
             break;
@@ -506,145 +864,151 @@ Atom* M4aParser::parse_elng(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_hdlr(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new HdlrAtom();
 
     auto end_pos = data_pos + size - 8;
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    memcpy(atom->component_type, data_ + data_pos, 4);
+    memcpy(atom->component_type, fetch(data_pos, 4), 4);
     data_pos += 4;
 
     if (memcmp(atom->component_type, "mhlr", 4) != 0 || memcmp(atom->component_type, "dhlr", 4) != 0) {
         LOG(WARNING) << "not valid component type, got " << std::string(atom->component_type, 4) << ", expected mhlr or dhlr";
     }
 
-    memcpy(atom->component_subtype, data_ + data_pos, 4);
+    memcpy(atom->component_subtype, fetch(data_pos, 4), 4);
     data_pos += 4;
 
-    memcpy(&atom->component_manufacturer, data_ + data_pos, 4);
+    memcpy(&atom->component_manufacturer, fetch(data_pos, 4), 4);
     data_pos += 4;
 
-    memcpy(&atom->component_flags, data_ + data_pos, 4);
+    memcpy(&atom->component_flags, fetch(data_pos, 4), 4);
     data_pos += 4;
 
-    memcpy(&atom->component_flags_mask, data_ + data_pos, 4);
+    memcpy(&atom->component_flags_mask, fetch(data_pos, 4), 4);
     data_pos += 4;
 
-    atom->component_name = std::string((char*)(data_ + data_pos), end_pos - data_pos);
+    if (data_pos < end_pos) {
+        const unsigned char* name = fetch(data_pos, end_pos - data_pos);
+        if (name) {
+            atom->component_name = std::string(reinterpret_cast<const char *>(name), end_pos - data_pos);
+        }
+    }
     return atom;
 }
 
 
 Atom* M4aParser::parse_vmhd(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new VmhdAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->graphics_mode = bytes_to_int2_be(data_ + data_pos);
+    atom->graphics_mode = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->opcolor_red = bytes_to_int2_be(data_ + data_pos);
+    atom->opcolor_red = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->opcolor_green = bytes_to_int2_be(data_ + data_pos);
+    atom->opcolor_green = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->opcolor_blue = bytes_to_int2_be(data_ + data_pos);
+    atom->opcolor_blue = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
     return atom;
 }
 
 Atom* M4aParser::parse_smhd(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new SmhdAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->balance = bytes_to_int2_be(data_ + data_pos);
+    atom->balance = bytes_to_int2_be(fetch(data_pos, 2));
 
     return atom;
 }
 
 Atom* M4aParser::parse_gmin(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new GminAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->graphics_mode = bytes_to_int2_be(data_ + data_pos);
+    atom->graphics_mode = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->opcolor_red = bytes_to_int2_be(data_ + data_pos);
+    atom->opcolor_red = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->opcolor_green = bytes_to_int2_be(data_ + data_pos);
+    atom->opcolor_green = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->opcolor_blue = bytes_to_int2_be(data_ + data_pos);
+    atom->opcolor_blue = bytes_to_int2_be(fetch(data_pos, 2));
     data_pos += 2;
 
-    atom->balance = bytes_to_int2_be(data_ + data_pos);
+    atom->balance = bytes_to_int2_be(fetch(data_pos, 2));
 
     return atom;
 }
 
 Atom* M4aParser::parse_dref(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new DrefAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->entry_num = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_num = bytes_to_int4_be(fetch(data_pos, 4));
 
     return atom;
 }
 
 Atom* M4aParser::parse_stsd(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new StsdAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->entry_num = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_num = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     for (uint32_t i = 0; i < atom->entry_num; ++i) {
         auto mediaDataAtom = new MediaDataAtom;
         size_t pos = data_pos;
-        mediaDataAtom->sample_description_size = bytes_to_int4_be(data_ + pos);
+        mediaDataAtom->offset = data_pos;
+        mediaDataAtom->sample_description_size = bytes_to_int4_be(fetch(pos, 4));
         pos += 4;
-        memcpy(mediaDataAtom->data_format, data_ + pos, 4);
+        memcpy(mediaDataAtom->data_format, fetch(pos, 4), 4);
         pos += 4;
         pos += 6; // reserved
-        mediaDataAtom->data_reference_index = bytes_to_int2_be(data_ + pos);
+        mediaDataAtom->data_reference_index = bytes_to_int2_be(fetch(pos, 2));
 
         atom->sample_description_table.push_back(mediaDataAtom);
 
@@ -655,23 +1019,23 @@ Atom* M4aParser::parse_stsd(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_stts(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new SttsAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->entry_num = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_num = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     for (uint32_t i = 0; i < atom->entry_num; ++i) {
-        uint32_t sample_count = bytes_to_int4_be(data_ + data_pos);
+        uint32_t sample_count = bytes_to_int4_be(fetch(data_pos, 4));
         data_pos += 4;
 
-        uint32_t sample_duration = bytes_to_int4_be(data_ + data_pos);
+        uint32_t sample_duration = bytes_to_int4_be(fetch(data_pos, 4));
         data_pos += 4;
 
         atom->time_to_sample_table.push_back({sample_count, sample_duration});
@@ -681,23 +1045,23 @@ Atom* M4aParser::parse_stts(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_ctts(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new CttsAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->entry_count = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_count = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     for (uint32_t i = 0; i < atom->entry_count; ++i) {
-        uint32_t sample_count = bytes_to_int4_be(data_ + data_pos);
+        uint32_t sample_count = bytes_to_int4_be(fetch(data_pos, 4));
         data_pos += 4;
 
-        uint32_t composition_offset = bytes_to_int4_be(data_ + data_pos);
+        uint32_t composition_offset = bytes_to_int4_be(fetch(data_pos, 4));
         data_pos += 4;
 
         atom->composition_offset_table.push_back({sample_count, composition_offset});
@@ -707,48 +1071,48 @@ Atom* M4aParser::parse_ctts(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_cslg(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new CslgAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->composition_offset_to_display_offset_shift = bytes_to_int4_be(data_ + data_pos);
+    atom->composition_offset_to_display_offset_shift = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->least_display_offset = bytes_to_int4_be(data_ + data_pos);
+    atom->least_display_offset = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->greatest_display_offset = bytes_to_int4_be(data_ + data_pos);
+    atom->greatest_display_offset = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->display_start_time = bytes_to_int4_be(data_ + data_pos);
+    atom->display_start_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->display_end_time = bytes_to_int4_be(data_ + data_pos);
+    atom->display_end_time = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     return atom;
 }
 
 Atom* M4aParser::parse_stss(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new StssAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->entry_num = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_num = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     for (uint32_t i = 0; i < atom->entry_num; ++i) {
-        atom->sample_numbers.push_back(bytes_to_int4_be(data_ + data_pos));
+        atom->sample_numbers.push_back(bytes_to_int4_be(fetch(data_pos, 4)));
         data_pos += 4;
     }
 
@@ -756,20 +1120,20 @@ Atom* M4aParser::parse_stss(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_stps(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new StpsAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->entry_num = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_num = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     for (uint32_t i = 0; i < atom->entry_num; ++i) {
-        atom->sample_numbers.push_back(bytes_to_int4_be(data_ + data_pos));
+        atom->sample_numbers.push_back(bytes_to_int4_be(fetch(data_pos, 4)));
         data_pos += 4;
     }
 
@@ -777,28 +1141,28 @@ Atom* M4aParser::parse_stps(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_stsc(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new StscAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->entry_num = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_num = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     for (uint32_t i = 0; i < atom->entry_num; ++i) {
         StscEntry entry{};
 
-        entry.first_chunk = bytes_to_int4_be(data_ + data_pos);
+        entry.first_chunk = bytes_to_int4_be(fetch(data_pos, 4));
         data_pos += 4;
 
-        entry.sample_per_chunk = bytes_to_int4_be(data_ + data_pos);
+        entry.sample_per_chunk = bytes_to_int4_be(fetch(data_pos, 4));
         data_pos += 4;
 
-        entry.sample_per_chunk = bytes_to_int4_be(data_ + data_pos);
+        entry.sample_per_chunk = bytes_to_int4_be(fetch(data_pos, 4));
         data_pos += 4;
 
         atom->sample_to_chunk_table.push_back(entry);
@@ -808,23 +1172,23 @@ Atom* M4aParser::parse_stsc(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_stsz(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new StszAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->sample_size = bytes_to_int4_be(data_ + data_pos);
+    atom->sample_size = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
-    atom->entry_num = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_num = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     for (uint32_t i = 0; i < atom->entry_num; ++i) {
-        atom->sample_size_table.push_back(bytes_to_int4_be(data_ + data_pos));
+        atom->sample_size_table.push_back(bytes_to_int4_be(fetch(data_pos, 4)));
         data_pos += 4;
     }
 
@@ -832,20 +1196,20 @@ Atom* M4aParser::parse_stsz(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_stco(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new StcoAtom();
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
-    atom->entry_num = bytes_to_int4_be(data_ + data_pos);
+    atom->entry_num = bytes_to_int4_be(fetch(data_pos, 4));
     data_pos += 4;
 
     for (uint32_t i = 0; i < atom->entry_num; ++i) {
-        atom->chunk_offset_table.push_back(bytes_to_int4_be(data_ + data_pos));
+        atom->chunk_offset_table.push_back(bytes_to_int4_be(fetch(data_pos, 4)));
         data_pos += 4;
     }
 
@@ -853,19 +1217,19 @@ Atom* M4aParser::parse_stco(size_t size, size_t data_pos) {
 }
 
 Atom* M4aParser::parse_sdtp(size_t size, size_t data_pos) {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     auto atom = new SdtpAtom();
 
     auto end_pos = data_pos + size - 8;
 
-    atom->version = int_value(data_[data_pos]);
+    atom->version = byte_at(data_pos);
     data_pos++;
 
-    memcpy(atom->flags, data_ + data_pos, 3);
+    memcpy(atom->flags, fetch(data_pos, 3), 3);
     data_pos += 3;
 
     while (data_pos < end_pos) {
-        atom->sample_dependency_flags_table.push_back(int_value(data_[data_pos]));
+        atom->sample_dependency_flags_table.push_back(byte_at(data_pos));
         data_pos += 1;
     }
 
@@ -1004,9 +1368,43 @@ void M4aParser::register_parse_functions() {
 }
 
 int M4aParser::dump_info() {
+    std::string file_path = get_output_path() + ".txt";
+    TextWriter file;
+    if (file.open(file_path) < 0) {
+        return -1;
+    }
+
+    for (auto* atom: root.children) {
+        dump_atom(file, atom);
+    }
+    add_bytes_written(file.bytes_written());
+    return file.close();
+}
+
+void M4aParser::dump_atom(TextWriter& out, const Atom* atom) {
+    out << *atom << '\n';
+    for (auto* child: atom->children) {
+        dump_atom(out, child);
+    }
+}
+
+int M4aParser::dump_report(ReportWriter& writer) {
+    writer.write(FileRecord{"m4a", file_path_, data_size_});
+    for (auto* atom: root.children) {
+        dump_atom_report(writer, atom, 0);
+    }
     return 0;
 }
 
+void M4aParser::dump_atom_report(ReportWriter& writer, const Atom* atom, uint16_t depth) {
+    uint64_t size = atom->extended_size != 0 ? atom->extended_size : atom->size;
+    writer.write(M4aAtomRecord{atom->offset, size, std::string_view(atom->type, 4), depth,
+                               static_cast<uint16_t>(atom->children.size())});
+    for (auto* child: atom->children) {
+        dump_atom_report(writer, child, depth + 1);
+    }
+}
+
 int M4aParser::dump_data() {
     return 0;
 }
@@ -12,11 +12,10 @@
 #include <vector>
 #include <unordered_map>
 #include <functional>
-#include <arm_neon.h>
 #include <ostream>
-#include <iomanip>
 
 #include "Parser.h"
+#include "TextWriter.h"
 
 #define TYPE_FTYP "ftyp"
 #define TYPE_FREE "free"
@@ -50,18 +49,44 @@
 #define TYPE_STSZ "stsz"
 #define TYPE_STCO "stco"
 #define TYPE_SDTP "sdtp"
+#define TYPE_MOOV "moov"
+#define TYPE_TRAK "trak"
+#define TYPE_UDTA "udta"
+#define TYPE_META "meta"
+#define TYPE_ILST "ilst"
+#define TYPE_COVR "covr"
+#define TYPE_DATA "data"
+// 音频 sample description 内的子 atom
+#define TYPE_ESDS "esds"
+#define TYPE_WAVE "wave"
+
+// ilst 中 data atom 的 well-known type
+#define DATA_TYPE_JPEG 13
+#define DATA_TYPE_PNG 14
+#define DATA_TYPE_BMP 27
+// data atom 头部之后的 type indicator 和 locale
+#define DATA_ATOM_PREFIX_SIZE 8
+
+// sound sample description: 16 字节通用头部 + 20 字节音频字段, version 1/2 各自追加扩展字段
+#define SOUND_DESCRIPTION_SIZE 36
+#define SOUND_DESCRIPTION_V1_EXTRA 16
+#define SOUND_DESCRIPTION_V2_EXTRA 36
+// esds 中的 MPEG-4 descriptor tag
+#define ES_DESCRIPTOR_TAG 0x03
+#define DECODER_CONFIG_DESCRIPTOR_TAG 0x04
 
 struct Atom {
     uint32_t size;
     char type[4];
     uint64_t extended_size = 0;
+    uint64_t offset = 0; // atom 在文件中的偏移
     std::vector<Atom*> children;
 
-    virtual void print(std::ostream &out) const {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\textendedSize" << extended_size << std::endl;
+    virtual void print(TextWriter &out) const {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\textendedSize" << extended_size << '\n';
     }
 
     virtual ~Atom() {
@@ -70,6 +95,7 @@ struct Atom {
         }
     }
 
+    friend TextWriter& operator<<(TextWriter& out, const Atom& a);
     friend std::ostream& operator<<(std::ostream& os, const Atom& a);
 };
 
@@ -78,20 +104,20 @@ struct FtypAtom: Atom {
     uint8_t minor_version[4];
     std::vector<char*> compatible_brands;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tmajorBrand: " << std::string(major_brand, 4) << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tmajorBrand: " << std::string_view(major_brand, 4) << '\n';
         out << "\tminorVersion: " << static_cast<int>(minor_version[0]) << " "
             << static_cast<int>(minor_version[1]) << " "
             << static_cast<int>(minor_version[2]) << " "
-            << static_cast<int>(minor_version[3]) << std::endl;
+            << static_cast<int>(minor_version[3]) << '\n';
         out << "\tcompatibleBrands: ";
         for (char* c: compatible_brands) {
-            out << std::string(c, 4) << " ";
+            out << std::string_view(c, 4) << " ";
         }
-        out << std::endl;
+        out << '\n';
     }
 
     FtypAtom() {
@@ -107,11 +133,11 @@ struct FtypAtom: Atom {
 struct FreeAtom: Atom {
     uint32_t free_space;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tfreeSpace:" << free_space << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tfreeSpace:" << free_space << '\n';
     }
 
     FreeAtom() {
@@ -122,11 +148,11 @@ struct FreeAtom: Atom {
 struct SkipAtom: Atom {
     uint32_t free_space;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tfreeSpace:" << free_space << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tfreeSpace:" << free_space << '\n';
     }
 
     SkipAtom() {
@@ -135,10 +161,10 @@ struct SkipAtom: Atom {
 };
 
 struct WideAtom: Atom {
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
     }
 
     WideAtom() {
@@ -147,15 +173,15 @@ struct WideAtom: Atom {
 };
 
 struct MdatAtom: Atom {
-    unsigned char* data = nullptr;
+    size_t data_pos = 0; // 数据在文件中的偏移
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\textendedSize: " << extended_size << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\textendedSize: " << extended_size << '\n';
         size_t data_size = extended_size == 0 ? size - 8: extended_size - 16;
-        out << "\tdata:" << "(" << data_size << " bytes)" << std::endl;
+        out << "\tdata:" << "(" << data_size << " bytes)" << '\n';
     }
 
     MdatAtom() {
@@ -169,14 +195,14 @@ struct PnotAtom: Atom {
     uint32_t atom_type;
     uint32_t atom_index;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tmodificationDate: " << modification_date << std::endl;
-        out << "\tversionNumber: " << version_number << std::endl;
-        out << "\tatomType: " << atom_type << std::endl;
-        out << "\tatomIndex: " << atom_index << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tmodificationDate: " << modification_date << '\n';
+        out << "\tversionNumber: " << version_number << '\n';
+        out << "\tatomType: " << atom_type << '\n';
+        out << "\tatomIndex: " << atom_index << '\n';
     }
 
     PnotAtom() {
@@ -202,30 +228,30 @@ struct MvhdAtom: Atom {
     uint32_t current_time;
     uint32_t next_track_id;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tcreationTime: " << creation_time << std::endl;
-        out << "\tmodificationTime: " << modification_time << std::endl;
-        out << "\ttimeScale: " << time_scale << std::endl;
-        out << "\tduration: " << duration << std::endl;
-        out << "\tpreferredRate: " << std::fixed << std::setprecision(3) << preferred_rate << std::endl;
-        out << "\tpreferredVolume: " << std::fixed << std::setprecision(3) << preferred_volume << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tcreationTime: " << creation_time << '\n';
+        out << "\tmodificationTime: " << modification_time << '\n';
+        out << "\ttimeScale: " << time_scale << '\n';
+        out << "\tduration: " << duration << '\n';
+        out << "\tpreferredRate: " << fixed_value(preferred_rate, 3) << '\n';
+        out << "\tpreferredVolume: " << fixed_value(preferred_volume, 3) << '\n';
         out << "\tmatrixStructure: ";
         for (auto &i : matrix_structure) {
             out << i << " ";
         }
-        out << std::endl;
-        out << "\tpreviewTime: " << preview_time << std::endl;
-        out << "\tpreviewDuration: " << preview_duration << std::endl;
-        out << "\tposterTime: " << poster_time << std::endl;
-        out << "\tselectionTime: " << selection_time << std::endl;
-        out << "\tselectionDuration: " << selection_duration << std::endl;
-        out << "\tcurrentTime: " << current_time << std::endl;
-        out << "\tnextTrackId: " << next_track_id << std::endl;
+        out << '\n';
+        out << "\tpreviewTime: " << preview_time << '\n';
+        out << "\tpreviewDuration: " << preview_duration << '\n';
+        out << "\tposterTime: " << poster_time << '\n';
+        out << "\tselectionTime: " << selection_time << '\n';
+        out << "\tselectionDuration: " << selection_duration << '\n';
+        out << "\tcurrentTime: " << current_time << '\n';
+        out << "\tnextTrackId: " << next_track_id << '\n';
     }
 
     MvhdAtom() {
@@ -246,19 +272,19 @@ struct CtabAtom: Atom {
     uint32_t color_table_size;
     std::vector<Color> color_array;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tcolorTableSeed: " << color_table_seed << std::endl;
-        out << "\tcolorTableFlags: " << color_table_flags << std::endl;
-        out << "\tcolorTableSize: " << color_table_size << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tcolorTableSeed: " << color_table_seed << '\n';
+        out << "\tcolorTableFlags: " << color_table_flags << '\n';
+        out << "\tcolorTableSize: " << color_table_size << '\n';
         out << "\tcolorArray: " ;
         for (auto& color: color_array) {
             out << color.first << ", " << color.red << ", " << color.green << ", " << color.blue;
             out << " ";
         }
-        out << std::endl;
+        out << '\n';
     }
 
     CtabAtom() {
@@ -283,26 +309,26 @@ struct TkhdAtom: Atom {
     float track_width;
     float track_height;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tcreationTime: " << creation_time << std::endl;
-        out << "\tmodificationTime: " << modification_time << std::endl;
-        out << "\ttrackId: " << track_id << std::endl;
-        out << "\tduration: " << duration << std::endl;
-        out << "\tlayer: " << layer << std::endl;
-        out << "\talternateGroup: " << alternate_group << std::endl;
-        out << "\tvolume: " << std::fixed << std::setprecision(3) << volume << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tcreationTime: " << creation_time << '\n';
+        out << "\tmodificationTime: " << modification_time << '\n';
+        out << "\ttrackId: " << track_id << '\n';
+        out << "\tduration: " << duration << '\n';
+        out << "\tlayer: " << layer << '\n';
+        out << "\talternateGroup: " << alternate_group << '\n';
+        out << "\tvolume: " << fixed_value(volume, 3) << '\n';
         out << "\tmatrixStructure: ";
         for (auto &i : matrix_structure) {
             out << i << " ";
         }
-        out << std::endl;
-        out << "\ttrackWidth: " << std::fixed << std::setprecision(3) << track_width << std::endl;
-        out << "\ttrackHeight: " << std::fixed << std::setprecision(3) << track_height << std::endl;
+        out << '\n';
+        out << "\ttrackWidth: " << fixed_value(track_width, 3) << '\n';
+        out << "\ttrackHeight: " << fixed_value(track_height, 3) << '\n';
     }
 
     TkhdAtom() {
@@ -311,10 +337,10 @@ struct TkhdAtom: Atom {
 };
 
 struct TxasAtom: Atom {
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
     }
 
     TxasAtom() {
@@ -328,14 +354,14 @@ struct ClefAtom: Atom {
     float width;
     float height;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\twidth: " << std::fixed << std::setprecision(3) << width << std::endl;
-        out << "\theight: " << std::fixed << std::setprecision(3) << height << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\twidth: " << fixed_value(width, 3) << '\n';
+        out << "\theight: " << fixed_value(height, 3) << '\n';
     }
 
     ClefAtom() {
@@ -349,14 +375,14 @@ struct ProfAtom: Atom {
     float width;
     float height;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\twidth: " << std::fixed << std::setprecision(3) << width << std::endl;
-        out << "\theight: " << std::fixed << std::setprecision(3) << height << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\twidth: " << fixed_value(width, 3) << '\n';
+        out << "\theight: " << fixed_value(height, 3) << '\n';
     }
 
     ProfAtom() {
@@ -370,14 +396,14 @@ struct EnofAtom: Atom {
     float width;
     float height;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\twidth: " << std::fixed << std::setprecision(3) << width << std::endl;
-        out << "\theight: " << std::fixed << std::setprecision(3) << height << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\twidth: " << fixed_value(width, 3) << '\n';
+        out << "\theight: " << fixed_value(height, 3) << '\n';
     }
 
     EnofAtom() {
@@ -397,20 +423,20 @@ struct ElstAtom: Atom {
     uint32_t entry_num;
     std::vector<ElstEntry> edit_list_table;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\ttype: " << std::string(type, 4) << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tnumberOfEntries: " << entry_num << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\ttype: " << std::string_view(type, 4) << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tnumberOfEntries: " << entry_num << '\n';
         out << "\teditListTable: \n";
         for (auto &e : edit_list_table) {
-            out << "\t  trackDuration: " << e.track_duration << std::endl;
-            out << "\t  mediaTime: " << e.media_time << std::endl;
-            out << "\t  mediaRate: " << std::fixed << std::setprecision(3) << e.media_rate << std::endl;
+            out << "\t  trackDuration: " << e.track_duration << '\n';
+            out << "\t  mediaTime: " << e.media_time << '\n';
+            out << "\t  mediaRate: " << fixed_value(e.media_rate, 3) << '\n';
         }
-        out << std::endl;
+        out << '\n';
     }
 
     ElstAtom() {
@@ -424,13 +450,13 @@ struct LoadAtom: Atom {
     uint32_t preload_flags;
     uint32_t default_hints;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tpreloadStarTime: " << preload_start_time << std::endl;
-        out << "\tpreloadDuration: " << preload_duration << std::endl;
-        out << "\tpreloadFlags: " << preload_flags << std::endl;
-        out << "\tdefaultHints: " << default_hints << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tpreloadStarTime: " << preload_start_time << '\n';
+        out << "\tpreloadDuration: " << preload_duration << '\n';
+        out << "\tpreloadFlags: " << preload_flags << '\n';
+        out << "\tdefaultHints: " << default_hints << '\n';
     }
 
     LoadAtom() {
@@ -448,17 +474,17 @@ struct MdhdAtom: Atom {
     uint16_t language;
     uint16_t quality;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tcreationTime: " << creation_time << std::endl;
-        out << "\tmodificationTime: " << modification_time << std::endl;
-        out << "\ttimeScale: " << time_scale << std::endl;
-        out << "\tduration: " << duration << std::endl;
-        out << "\tlanguage: " << language << std::endl;
-        out << "\tquality: " << quality << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tcreationTime: " << creation_time << '\n';
+        out << "\tmodificationTime: " << modification_time << '\n';
+        out << "\ttimeScale: " << time_scale << '\n';
+        out << "\tduration: " << duration << '\n';
+        out << "\tlanguage: " << language << '\n';
+        out << "\tquality: " << quality << '\n';
     }
 
     MdhdAtom() {
@@ -471,12 +497,12 @@ struct ElngAtom: Atom {
     uint8_t flags[3];
     std::string language_tag_string;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tlanguageTagString" << language_tag_string << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tlanguageTagString" << language_tag_string << '\n';
     }
 
     ElngAtom() {
@@ -494,17 +520,17 @@ struct HdlrAtom: Atom {
     uint32_t component_flags_mask;
     std::string component_name;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tcomponentType: " << std::string(component_type, 4) << std::endl;
-        out << "\tcomponentSubtype: " << std::string(component_subtype, 4) << std::endl;
-        out << "\tcomponentManufacturer: (Reserved)" << std::endl;
-        out << "\tcomponentFlags: (Reserved)" << std::endl;
-        out << "\tcomponentFlagsMask: (Reserved)" << std::endl;
-        out << "\tcomponentName: " << component_name << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tcomponentType: " << std::string_view(component_type, 4) << '\n';
+        out << "\tcomponentSubtype: " << std::string_view(component_subtype, 4) << '\n';
+        out << "\tcomponentManufacturer: (Reserved)" << '\n';
+        out << "\tcomponentFlags: (Reserved)" << '\n';
+        out << "\tcomponentFlagsMask: (Reserved)" << '\n';
+        out << "\tcomponentName: " << component_name << '\n';
     }
 
     HdlrAtom() {
@@ -520,13 +546,13 @@ struct VmhdAtom: Atom {
     uint16_t opcolor_green;
     uint16_t opcolor_blue;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tgraphicsMode: " << graphics_mode << std::endl;
-        out << "\topcolor: (" << opcolor_red << " " << opcolor_green << " " << opcolor_blue << ")" << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tgraphicsMode: " << graphics_mode << '\n';
+        out << "\topcolor: (" << opcolor_red << " " << opcolor_green << " " << opcolor_blue << ")" << '\n';
     }
 
     VmhdAtom() {
@@ -539,12 +565,12 @@ struct SmhdAtom: Atom {
     uint8_t flags[3];
     uint16_t balance;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tbalance: " << balance << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tbalance: " << balance << '\n';
     }
 
     SmhdAtom() {
@@ -561,14 +587,14 @@ struct GminAtom: Atom {
     uint16_t opcolor_blue;
     uint16_t balance;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tgraphicsMode: " << graphics_mode << std::endl;
-        out << "\topcolor: (" << opcolor_red << " " << opcolor_green << " " << opcolor_blue << ")" << std::endl;
-        out << "\tbalance: " << balance << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tgraphicsMode: " << graphics_mode << '\n';
+        out << "\topcolor: (" << opcolor_red << " " << opcolor_green << " " << opcolor_blue << ")" << '\n';
+        out << "\tbalance: " << balance << '\n';
     }
 
     GminAtom() {
@@ -582,12 +608,12 @@ struct DrefAtom: Atom {
     uint32_t entry_num;
     // todo: parse child atom
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tnumberOfEntries: " << entry_num << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tnumberOfEntries: " << entry_num << '\n';
     }
 
     DrefAtom() {
@@ -596,10 +622,21 @@ struct DrefAtom: Atom {
 };
 
 struct MediaDataAtom {
+    uint64_t offset = 0; // sample description 在文件中的偏移
     uint32_t sample_description_size;
     char data_format[4];
     // reserved: 6
     uint16_t data_reference_index;
+
+    // 以下字段只在音频轨道 (hdlr 为 soun) 中解析
+    bool is_sound = false;
+    uint16_t version = 0;
+    uint16_t channels = 0;
+    uint16_t sample_size = 0;
+    uint32_t sample_rate = 0;
+    // esds DecoderConfigDescriptor 中的码率, bps, 没有 esds 时为 0
+    uint32_t max_bitrate = 0;
+    uint32_t avg_bitrate = 0;
 };
 
 struct StsdAtom: Atom {
@@ -609,18 +646,26 @@ struct StsdAtom: Atom {
     // todo: parse child atom
     std::vector<MediaDataAtom*> sample_description_table;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tnumberOfEntries: " << entry_num << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tnumberOfEntries: " << entry_num << '\n';
         int i = 0;
         for (auto a: sample_description_table) {
-            out << "\tmediaDataAtom [" << ++i << "]:" << std::endl;
-            out << "\t\tsampleDescriptionSize: " << a->sample_description_size << std::endl;
-            out << "\t\tdataFormat: " << std::string(a->data_format, 4) << std::endl;
-            out << "\t\tdataReferenceIndex: " << a->data_reference_index << std::endl;
+            out << "\tmediaDataAtom [" << ++i << "]:" << '\n';
+            out << "\t\tsampleDescriptionSize: " << a->sample_description_size << '\n';
+            out << "\t\tdataFormat: " << std::string_view(a->data_format, 4) << '\n';
+            out << "\t\tdataReferenceIndex: " << a->data_reference_index << '\n';
+            if (a->is_sound) {
+                out << "\t\tversion: " << a->version << '\n';
+                out << "\t\tnumberOfChannels: " << a->channels << '\n';
+                out << "\t\tsampleSize: " << a->sample_size << '\n';
+                out << "\t\tsampleRate: " << a->sample_rate << '\n';
+                out << "\t\tmaxBitrate: " << a->max_bitrate << '\n';
+                out << "\t\tavgBitrate: " << a->avg_bitrate << '\n';
+            }
         }
     }
 
@@ -646,18 +691,18 @@ struct SttsAtom: Atom {
     uint32_t entry_num;
     std::vector<SttsEntry> time_to_sample_table;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tnumberOfEntries: " << entry_num << std::endl;
-        out << "\ttimeToSampleTable: " << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tnumberOfEntries: " << entry_num << '\n';
+        out << "\ttimeToSampleTable: " << '\n';
         int i = 0;
         for (auto a: time_to_sample_table) {
-            out << "\t[" << ++i << "]:" << std::endl;
-            out << "\t\tsampleCount: " << a.sample_count << std::endl;
-            out << "\t\tsampleDuration: " << a.sample_duration << std::endl;
+            out << "\t[" << ++i << "]:" << '\n';
+            out << "\t\tsampleCount: " << a.sample_count << '\n';
+            out << "\t\tsampleDuration: " << a.sample_duration << '\n';
         }
     }
 
@@ -677,18 +722,18 @@ struct CttsAtom: Atom {
     uint32_t entry_count;
     std::vector<CttsEntry> composition_offset_table;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tentryCount: " << entry_count << std::endl;
-        out << "\tcompositionOffsetTable: " << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tentryCount: " << entry_count << '\n';
+        out << "\tcompositionOffsetTable: " << '\n';
         int i = 0;
         for (auto a: composition_offset_table) {
-            out << "\t[" << ++i << "]:" << std::endl;
-            out << "\t\tsampleCount: " << a.sample_count << std::endl;
-            out << "\t\tcompositionOffset: " << a.composition_offset << std::endl;
+            out << "\t[" << ++i << "]:" << '\n';
+            out << "\t\tsampleCount: " << a.sample_count << '\n';
+            out << "\t\tcompositionOffset: " << a.composition_offset << '\n';
         }
     }
 
@@ -706,16 +751,16 @@ struct CslgAtom: Atom {
     uint32_t display_start_time;
     uint32_t display_end_time;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tcompositionOffsetToDisplayOffsetShift: " << composition_offset_to_display_offset_shift << std::endl;
-        out << "\tleastDisplayOffset: " << least_display_offset << std::endl;
-        out << "\tgreatestDisplayOffset: " << greatest_display_offset << std::endl;
-        out << "\tdisplayStartTime: " << display_start_time << std::endl;
-        out << "\tdisplayEndTime: " << display_end_time << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tcompositionOffsetToDisplayOffsetShift: " << composition_offset_to_display_offset_shift << '\n';
+        out << "\tleastDisplayOffset: " << least_display_offset << '\n';
+        out << "\tgreatestDisplayOffset: " << greatest_display_offset << '\n';
+        out << "\tdisplayStartTime: " << display_start_time << '\n';
+        out << "\tdisplayEndTime: " << display_end_time << '\n';
     }
 
     CslgAtom() {
@@ -729,13 +774,13 @@ struct StssAtom: Atom {
     uint32_t entry_num;
     std::vector<uint32_t> sample_numbers;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tnumberOfEntries: " << entry_num << std::endl;
-        out << "\tsampleNumbers: " << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tnumberOfEntries: " << entry_num << '\n';
+        out << "\tsampleNumbers: " << '\n';
         uint32_t i = 0;
         for (auto a: sample_numbers) {
             if (i++ % 10 == 0) {
@@ -743,7 +788,7 @@ struct StssAtom: Atom {
             }
             out << a << " ";
             if (i % 10 == 0) {
-                out << std::endl;
+                out << '\n';
             }
         }
     }
@@ -759,13 +804,13 @@ struct StpsAtom: Atom {
     uint32_t entry_num;
     std::vector<uint32_t> sample_numbers;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tnumberOfEntries: " << entry_num << std::endl;
-        out << "\tsampleNumbers: " << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tnumberOfEntries: " << entry_num << '\n';
+        out << "\tsampleNumbers: " << '\n';
         uint32_t i = 0;
         for (auto a: sample_numbers) {
             if (i++ % 10 == 0) {
@@ -773,7 +818,7 @@ struct StpsAtom: Atom {
             }
             out << a << " ";
             if (i % 10 == 0) {
-                out << std::endl;
+                out << '\n';
             }
         }
     }
@@ -795,19 +840,19 @@ struct StscAtom: Atom {
     uint32_t entry_num;
     std::vector<StscEntry> sample_to_chunk_table;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tnumberOfEntries: " << entry_num << std::endl;
-        out << "\tsampleToChunkTable: " << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tnumberOfEntries: " << entry_num << '\n';
+        out << "\tsampleToChunkTable: " << '\n';
         int i = 0;
         for (auto a: sample_to_chunk_table) {
-            out << "\t[" << ++i << "]:" << std::endl;
-            out << "\t\tfirstChunk: " << a.first_chunk << std::endl;
-            out << "\t\tsamplePerChunk: " << a.sample_per_chunk << std::endl;
-            out << "\t\tsampleDescriptionId: " << a.sample_description_id << std::endl;
+            out << "\t[" << ++i << "]:" << '\n';
+            out << "\t\tfirstChunk: " << a.first_chunk << '\n';
+            out << "\t\tsamplePerChunk: " << a.sample_per_chunk << '\n';
+            out << "\t\tsampleDescriptionId: " << a.sample_description_id << '\n';
         }
     }
 
@@ -823,14 +868,14 @@ struct StszAtom: Atom {
     uint32_t entry_num;
     std::vector<uint32_t> sample_size_table;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tsampleSize: " << sample_size << std::endl;
-        out << "\tnumberOfEntries: " << entry_num << std::endl;
-        out << "\tsampleSizeTable: " << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tsampleSize: " << sample_size << '\n';
+        out << "\tnumberOfEntries: " << entry_num << '\n';
+        out << "\tsampleSizeTable: " << '\n';
         uint32_t i = 0;
         for (auto a: sample_size_table) {
             if (i++ % 10 == 0) {
@@ -838,7 +883,7 @@ struct StszAtom: Atom {
             }
             out << a << " ";
             if (i % 10 == 0) {
-                out << std::endl;
+                out << '\n';
             }
         }
     }
@@ -854,13 +899,13 @@ struct StcoAtom: Atom {
     uint32_t entry_num;
     std::vector<uint32_t> chunk_offset_table;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tnumberOfEntries: " << entry_num << std::endl;
-        out << "\tchunkOffsetTable: " << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tnumberOfEntries: " << entry_num << '\n';
+        out << "\tchunkOffsetTable: " << '\n';
         uint32_t i = 0;
         for (auto a: chunk_offset_table) {
             if (i++ % 10 == 0) {
@@ -868,7 +913,7 @@ struct StcoAtom: Atom {
             }
             out << a << " ";
             if (i % 10 == 0) {
-                out << std::endl;
+                out << '\n';
             }
         }
     }
@@ -883,12 +928,12 @@ struct SdtpAtom: Atom {
     uint8_t flags[3];
     std::vector<uint8_t> sample_dependency_flags_table;
 
-    void print(std::ostream &out) const override {
-        out << std::string(type, 4) << ":" << std::endl;
-        out << "\tsize: " << size << std::endl;
-        out << "\tversion: " << int(version) << std::endl;
-        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << std::endl;
-        out << "\tsampleDependencyFlagsTable: " << std::endl;
+    void print(TextWriter &out) const override {
+        out << std::string_view(type, 4) << ":" << '\n';
+        out << "\tsize: " << size << '\n';
+        out << "\tversion: " << int(version) << '\n';
+        out << "\tflags: " << int(flags[0]) << int(flags[1]) << int(flags[2]) << '\n';
+        out << "\tsampleDependencyFlagsTable: " << '\n';
         uint32_t i = 0;
         for (auto a: sample_dependency_flags_table) {
             if (i++ % 10 == 0) {
@@ -896,7 +941,7 @@ struct SdtpAtom: Atom {
             }
             out << int(a) << " ";
             if (i % 10 == 0) {
-                out << std::endl;
+                out << '\n';
             }
         }
     }
@@ -911,13 +956,29 @@ public:
     explicit M4aParser(const std::string& filePath);
     ~M4aParser();
 
+    // moov/udta/meta/ilst 中 covr 的各个图片, 需要 parse()/probe() 之后调用
+    int attachments(std::vector<Attachment>& out) override;
+
 private:
     int custom_parse() override;
     int dump_info() override;
     int dump_data() override;
+    int custom_probe() override;
+    int dump_report(ReportWriter& writer) override;
 
     void register_parse_functions();
+    static Atom* find_atom(Atom* atom, const char* type);
     uint64_t parse_atom(size_t start_pos, size_t end_pos, Atom* parent = nullptr);
+    static void dump_atom(TextWriter& out, const Atom* atom);
+    static void dump_atom_report(ReportWriter& writer, const Atom* atom, uint16_t depth);
+    // 不经过 atom 树直接读取 [pos, end) 处的 atom 头部, 返回 atom 总长度, 格式错误时返回 0
+    uint64_t read_atom_header(size_t pos, size_t end, char type[4], size_t& header_size);
+    // 在 [pos, end) 的直接子 atom 中查找 type, 返回其位置, 找不到时返回 end
+    size_t find_child_atom(size_t pos, size_t end, const char* type, uint64_t& atom_size, size_t& header_size);
+    // trak 解析完成后, 若为音频轨道则按 sound description 解析 stsd 中的各个条目
+    void parse_sound_description(Atom* trak);
+    // 解析 esds 中的 DecoderConfigDescriptor, 取得码率
+    void parse_esds(size_t pos, size_t end, MediaDataAtom* entry);
 
     Atom* parse_ftyp(size_t size, size_t data_pos);
     Atom* parse_free(size_t size, size_t data_pos);
@@ -959,8 +1020,8 @@ private:
 
 
 // todo:
-// 1. parse metadata https://developer.apple.com/documentation/quicktime-file-format/metadata_atoms_and_types
-// 2. parse sound_media https://developer.apple.com/documentation/quicktime-file-format/sound_media
+// 1. parse metadata (目前只读取 covr) https://developer.apple.com/documentation/quicktime-file-format/metadata_atoms_and_types
+// 2. parse sound_media 中除 sound description 之外的部分 https://developer.apple.com/documentation/quicktime-file-format/sound_media
 
 
 #endif //MEDIAFORMATPARSER_M4APARSER_H
@@ -0,0 +1,24 @@
+//
+// mediaformat 库的公开头文件.
+// 只引入解析器相关的声明, 不包含 easylogging++ 的宏, 也不需要调用方 INITIALIZE_EASYLOGGINGPP,
+// 包含此头文件或链接库本身不会修改日志配置
+//
+
+#ifndef MEDIAFORMATPARSER_MEDIAFORMAT_H
+#define MEDIAFORMATPARSER_MEDIAFORMAT_H
+
+#include "Parser.h"
+#include "WavParser.h"
+#include "Mp3Parser.h"
+#include "FlvParser.h"
+#include "M4aParser.h"
+#include "ParserFactory.h"
+#include "BatchParser.h"
+#include "ReportWriter.h"
+#include "AsyncLogSink.h"
+#include "Tracer.h"
+#include "Metrics.h"
+#include "LogConfig.h"
+
+
+#endif //MEDIAFORMATPARSER_MEDIAFORMAT_H
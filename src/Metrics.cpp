@@ -0,0 +1,232 @@
+//
+// 指标注册和 Prometheus 文本格式输出
+//
+
+#include "Metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "logger/easylogging++.h"
+
+Histogram::Histogram(std::vector<double> bounds): bounds_(std::move(bounds)) {
+    std::sort(bounds_.begin(), bounds_.end());
+    buckets_ = std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1);
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    // 等于上界的值属于该桶 (le)
+    size_t index = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    double sum = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+    }
+    count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+const std::vector<double>& default_duration_bounds() {
+    static const std::vector<double> bounds = {
+        0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60
+    };
+    return bounds;
+}
+
+// 标签值中的反斜杠, 双引号和换行需要转义
+static void append_label_value(std::string& out, const std::string& value) {
+    for (char c: value) {
+        switch (c) {
+            case '\\':
+                out += "\\\\";
+                break;
+            case '"':
+                out += "\\\"";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            default:
+                out += c;
+                break;
+        }
+    }
+}
+
+static std::string format_labels(const MetricLabels& labels) {
+    std::string out;
+    for (auto& label: labels) {
+        if (!out.empty()) {
+            out += ',';
+        }
+        out += label.first;
+        out += "=\"";
+        append_label_value(out, label.second);
+        out += '"';
+    }
+    return out;
+}
+
+static void write_double(TextWriter& out, double value) {
+    char buffer[32];
+    int len = snprintf(buffer, sizeof(buffer), "%.9g", value);
+    out.write(buffer, len);
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::~MetricsRegistry() {
+    stop_textfile_writer();
+}
+
+MetricsRegistry::MetricSeries& MetricsRegistry::find_series(const std::string& name, const std::string& help,
+                                                            MetricType type, const MetricLabels& labels) {
+    MetricFamily* family = nullptr;
+    for (auto& f: families_) {
+        if (f->name == name) {
+            family = f.get();
+            break;
+        }
+    }
+    if (family == nullptr) {
+        families_.push_back(std::make_unique<MetricFamily>(MetricFamily{name, help, type, {}}));
+        family = families_.back().get();
+    } else if (family->type != type) {
+        LOG(ERROR) << "metric " << name << " registered with a different type";
+    }
+
+    std::string label_text = format_labels(labels);
+    for (auto& series: family->series) {
+        if (series.labels == label_text) {
+            return series;
+        }
+    }
+    family->series.push_back(MetricSeries{std::move(label_text), nullptr, nullptr});
+    return family->series.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MetricSeries& series = find_series(name, help, METRIC_COUNTER, labels);
+    if (!series.counter) {
+        series.counter = std::make_unique<Counter>();
+    }
+    return *series.counter;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const MetricLabels& labels,
+                                      const std::vector<double>& bounds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MetricSeries& series = find_series(name, help, METRIC_HISTOGRAM, labels);
+    if (!series.histogram) {
+        series.histogram = std::make_unique<Histogram>(bounds);
+    }
+    return *series.histogram;
+}
+
+void MetricsRegistry::write(TextWriter& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& family: families_) {
+        out << "# HELP " << family->name << ' ' << family->help << '\n';
+        out << "# TYPE " << family->name << (family->type == METRIC_COUNTER ? " counter\n" : " histogram\n");
+        for (auto& series: family->series) {
+            const std::string& labels = series.labels;
+            if (series.counter) {
+                out << family->name;
+                if (!labels.empty()) {
+                    out << '{' << labels << '}';
+                }
+                out << ' ' << series.counter->value() << '\n';
+                continue;
+            }
+            if (!series.histogram) {
+                continue;
+            }
+            const Histogram& h = *series.histogram;
+            const char* sep = labels.empty() ? "" : ",";
+            // 各桶分别读取, 并发更新时累积值以 _count 为准
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < h.bounds().size(); ++i) {
+                cumulative += h.bucket(i);
+                out << family->name << "_bucket{" << labels << sep << "le=\"";
+                write_double(out, h.bounds()[i]);
+                out << "\"} " << cumulative << '\n';
+            }
+            cumulative += h.bucket(h.bounds().size());
+            uint64_t count = std::max(cumulative, h.count());
+            out << family->name << "_bucket{" << labels << sep << "le=\"+Inf\"} " << count << '\n';
+            out << family->name << "_sum";
+            if (!labels.empty()) {
+                out << '{' << labels << '}';
+            }
+            out << ' ';
+            write_double(out, h.sum());
+            out << '\n';
+            out << family->name << "_count";
+            if (!labels.empty()) {
+                out << '{' << labels << '}';
+            }
+            out << ' ' << count << '\n';
+        }
+    }
+}
+
+int MetricsRegistry::write_textfile(const std::string& file_path) {
+    std::string tmp_path = file_path + ".tmp";
+    TextWriter out;
+    if (out.open(tmp_path) < 0) {
+        return -1;
+    }
+    write(out);
+    if (out.close() < 0) {
+        std::remove(tmp_path.c_str());
+        return -2;
+    }
+    if (std::rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+        LOG(ERROR) << "rename " << tmp_path << " to " << file_path << " failed";
+        std::remove(tmp_path.c_str());
+        return -3;
+    }
+    return 0;
+}
+
+void MetricsRegistry::start_textfile_writer(const std::string& file_path, uint32_t interval_ms) {
+    if (writer_.joinable()) {
+        return;
+    }
+    file_path_ = file_path;
+    interval_ms_ = std::max<uint32_t>(interval_ms, 1);
+    stop_ = false;
+    writer_ = std::thread(&MetricsRegistry::writer_loop, this);
+}
+
+void MetricsRegistry::stop_textfile_writer() {
+    if (!writer_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_ = true;
+    }
+    wake_cv_.notify_one();
+    writer_.join();
+    // 最后一次写出包含停止前的所有更新
+    write_textfile(file_path_);
+}
+
+void MetricsRegistry::writer_loop() {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    while (!stop_) {
+        lock.unlock();
+        write_textfile(file_path_);
+        lock.lock();
+        wake_cv_.wait_for(lock, std::chrono::milliseconds(interval_ms_), [this] {
+            return stop_;
+        });
+    }
+}
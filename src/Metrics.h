@@ -0,0 +1,119 @@
+//
+// 进程内指标, 以 Prometheus 文本格式写出到文件, 供 node_exporter 的 textfile collector 采集.
+// 计数器和直方图的更新只有 relaxed 原子操作, 注册 (按名字和标签查找) 时才加锁,
+// 热路径上应当缓存注册返回的引用. 写出时先写临时文件再 rename, 采集端不会读到写了一半的文件
+//
+
+#ifndef MEDIAFORMATPARSER_METRICS_H
+#define MEDIAFORMATPARSER_METRICS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "TextWriter.h"
+
+// 后台线程默认的写出间隔 (毫秒)
+#define METRICS_DEFAULT_INTERVAL_MS 10000
+
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+class Counter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// 固定上界的直方图, 每个桶单独计数, 写出时再累加成 Prometheus 的累积桶
+class Histogram {
+public:
+    // bounds 为升序的桶上界, 不含 +Inf
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    const std::vector<double>& bounds() const { return bounds_; }
+    // 第 index 个桶的计数 (非累积), index == bounds().size() 为 +Inf 桶
+    uint64_t bucket(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const { return sum_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<double> sum_{0};
+};
+
+// 耗时直方图的默认桶上界 (秒)
+const std::vector<double>& default_duration_bounds();
+
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance();
+
+    // 返回名字和标签对应的指标, 不存在时创建. 返回的引用在进程内一直有效.
+    // 同名指标的类型和直方图的桶上界必须一致, 以第一次注册为准
+    Counter& counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    Histogram& histogram(const std::string& name, const std::string& help, const MetricLabels& labels = {},
+                         const std::vector<double>& bounds = default_duration_bounds());
+
+    // 以 Prometheus 文本格式写出所有指标
+    void write(TextWriter& out);
+    // 写入 file_path.tmp 后 rename 为 file_path, 失败时返回负数
+    int write_textfile(const std::string& file_path);
+
+    // 启动后台线程每隔 interval_ms 写出一次
+    void start_textfile_writer(const std::string& file_path, uint32_t interval_ms = METRICS_DEFAULT_INTERVAL_MS);
+    // 停止后台线程并写出最后一次
+    void stop_textfile_writer();
+
+private:
+    enum MetricType {
+        METRIC_COUNTER,
+        METRIC_HISTOGRAM,
+    };
+
+    struct MetricSeries {
+        std::string labels;  // 已转义的 k="v",... 不含大括号
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    struct MetricFamily {
+        std::string name;
+        std::string help;
+        MetricType type;
+        std::vector<MetricSeries> series;
+    };
+
+    MetricsRegistry() = default;
+    ~MetricsRegistry();
+
+    MetricSeries& find_series(const std::string& name, const std::string& help, MetricType type,
+                              const MetricLabels& labels);
+    void writer_loop();
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<MetricFamily>> families_;
+
+    std::string file_path_;
+    uint32_t interval_ms_ = METRICS_DEFAULT_INTERVAL_MS;
+    bool stop_ = false;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::thread writer_;
+};
+
+
+#endif //MEDIAFORMATPARSER_METRICS_H
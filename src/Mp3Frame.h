@@ -0,0 +1,155 @@
+//
+// MPEG 音频帧头及由帧头得出的帧参数 (帧长, 采样数, 码率, 采样率, 时长).
+// 帧参数在编译期生成为 2048 项的查找表, 解析时每帧只需一次查表
+//
+
+#ifndef MEDIAFORMATPARSER_MP3FRAME_H
+#define MEDIAFORMATPARSER_MP3FRAME_H
+
+#include <array>
+#include <cstdint>
+
+union FrameHeaderUnion {
+    uint32_t raw; // 原始4字节数据
+
+    struct {
+        unsigned int sync1:8; //同步信息 1
+
+        unsigned int error_protection:1; //CRC 校验
+        unsigned int layer:2; //层
+        unsigned int version:2; //版本
+        unsigned int sync2:3; //同步信息 2
+
+        unsigned int extension:1; //私有位
+        unsigned int padding:1; //填充空白字
+        unsigned int sample_rate_index:2; //采样率索引
+        unsigned int bit_rate_index:4; //位率索引
+
+        unsigned int emphasis:2; //强调方式
+        unsigned int original:1; //原始媒体
+        unsigned int copyright:1; //版权标志
+        unsigned int mode_extension:2; //扩展模式,仅用于联合立体声
+        unsigned int channel_mode:2; //声道模式
+    } bits;
+};
+
+// 帧头中决定帧长的字段 (版本, 层, 码率索引, 采样率索引, padding) 共 11 位, 按此查表
+#define FRAME_GEOMETRY_TABLE_SIZE 2048
+
+// 由帧头字段确定的帧参数, 保留或不支持的取值 (含 free format) 全部为 0
+struct FrameGeometry {
+    uint16_t frame_size;    // 整帧字节数, 含 4 字节帧头
+    uint16_t sample_count;  // 每帧采样数
+    uint16_t bit_rate;      // kbps
+    uint16_t sample_rate;
+    uint32_t duration_ns;   // 每帧时长
+};
+
+constexpr uint16_t MP3_BIT_RATES[3][3][16] = {
+    // MPEG 1: Layer I, II, III
+    {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0},
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0},
+    },
+    // MPEG 2: Layer I, II, III
+    {
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0},
+    },
+    // MPEG 2.5 与 MPEG 2 相同
+    {
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0},
+    },
+};
+
+constexpr uint16_t MP3_SAMPLE_RATES[3][3] = {
+    {44100, 48000, 32000},  // MPEG 1
+    {22050, 24000, 16000},  // MPEG 2
+    {11025, 12000, 8000},   // MPEG 2.5
+};
+
+// index = 版本(2) 层(2) 码率索引(4) 采样率索引(2) padding(1), 即帧头第 2 字节的第 1-4 位和第 3 字节的高 7 位
+constexpr FrameGeometry make_frame_geometry(uint32_t index) {
+    uint32_t version = (index >> 9) & 0x03;
+    uint32_t layer = (index >> 7) & 0x03;
+    uint32_t bit_rate_index = (index >> 3) & 0x0f;
+    uint32_t sample_rate_index = (index >> 1) & 0x03;
+    uint32_t padding = index & 0x01;
+
+    // 版本: 3 = MPEG 1, 2 = MPEG 2, 0 = MPEG 2.5, 1 保留; 层: 3 = I, 2 = II, 1 = III, 0 保留
+    if (version == 1 || layer == 0 || sample_rate_index == 3) {
+        return FrameGeometry{0, 0, 0, 0, 0};
+    }
+    uint32_t v = version == 3 ? 0 : (version == 2 ? 1 : 2);
+    uint32_t l = 3 - layer;
+    uint32_t bit_rate = MP3_BIT_RATES[v][l][bit_rate_index];
+    uint32_t sample_rate = MP3_SAMPLE_RATES[v][sample_rate_index];
+    uint32_t sample_count = l == 0 ? 384 : (l == 2 && v != 0 ? 576 : 1152);
+    uint32_t duration_ns = static_cast<uint32_t>(sample_count * 1000000000ull / sample_rate);
+    if (bit_rate == 0) {
+        // free format 的帧长无法由帧头得出
+        return FrameGeometry{0, static_cast<uint16_t>(sample_count), 0, static_cast<uint16_t>(sample_rate), duration_ns};
+    }
+    // Layer I 以 4 字节的 slot 为单位
+    uint32_t frame_size = l == 0
+            ? (12 * bit_rate * 1000 / sample_rate + padding) * 4
+            : sample_count / 8 * bit_rate * 1000 / sample_rate + padding;
+    return FrameGeometry{static_cast<uint16_t>(frame_size), static_cast<uint16_t>(sample_count),
+                         static_cast<uint16_t>(bit_rate), static_cast<uint16_t>(sample_rate), duration_ns};
+}
+
+constexpr std::array<FrameGeometry, FRAME_GEOMETRY_TABLE_SIZE> make_frame_geometry_table() {
+    std::array<FrameGeometry, FRAME_GEOMETRY_TABLE_SIZE> table{};
+    for (uint32_t i = 0; i < FRAME_GEOMETRY_TABLE_SIZE; ++i) {
+        table[i] = make_frame_geometry(i);
+    }
+    return table;
+}
+
+// 编译期生成
+inline constexpr std::array<FrameGeometry, FRAME_GEOMETRY_TABLE_SIZE> frame_geometry_table = make_frame_geometry_table();
+
+// header 指向文件中的 4 字节帧头, 不检查同步字
+inline const FrameGeometry& decode_frame_header(const unsigned char* header) {
+    return frame_geometry_table[(((header[1] >> 1) & 0x0f) << 7) | (header[2] >> 1)];
+}
+
+inline const FrameGeometry& frame_geometry(const FrameHeaderUnion& frame_header) {
+    return frame_geometry_table[(frame_header.bits.version << 9) | (frame_header.bits.layer << 7)
+                                | (frame_header.bits.bit_rate_index << 3)
+                                | (frame_header.bits.sample_rate_index << 1) | frame_header.bits.padding];
+}
+
+inline int get_sample_rate(const FrameHeaderUnion& frame_header) {
+    return frame_geometry(frame_header).sample_rate;
+}
+
+inline int get_bit_rate(const FrameHeaderUnion& frame_header) {
+    return frame_geometry(frame_header).bit_rate;
+}
+
+inline int get_sample_count_per_frame(const FrameHeaderUnion& frame_header) {
+    return frame_geometry(frame_header).sample_count;
+}
+
+// Layer III 帧头 (及 CRC) 之后的 side information 长度
+inline int get_side_info_size(const FrameHeaderUnion& frame_header) {
+    bool mono = frame_header.bits.channel_mode == 3;
+    if (frame_header.bits.version == 3) {
+        return mono ? 17 : 32;
+    }
+    return mono ? 9 : 17;
+}
+
+// 帧头之后的字节数, 帧长未知时为 0
+inline int get_frame_data_size(const FrameHeaderUnion& frame_header) {
+    int frame_size = frame_geometry(frame_header).frame_size;
+    return frame_size > 4 ? frame_size - 4 : 0;
+}
+
+
+#endif //MEDIAFORMATPARSER_MP3FRAME_H
@@ -0,0 +1,163 @@
+//
+// MP3 帧索引实现
+//
+
+#include "Mp3FrameIndex.h"
+
+#include <algorithm>
+
+void Mp3FrameIndex::clear() {
+    entries_.clear();
+    checkpoints_.clear();
+    headers_.clear();
+    durations_ns_.clear();
+    last_header_id_ = 0;
+    last_offset_ = 0;
+    time_ns_ = 0;
+    full_ = false;
+}
+
+int Mp3FrameIndex::header_id(const FrameHeaderUnion& header) {
+    // 相邻帧的帧头大多相同, 先比较上一帧
+    if (!headers_.empty() && headers_[last_header_id_].raw == header.raw) {
+        return last_header_id_;
+    }
+    for (size_t i = 0; i < headers_.size(); ++i) {
+        if (headers_[i].raw == header.raw) {
+            last_header_id_ = static_cast<uint16_t>(i);
+            return last_header_id_;
+        }
+    }
+    if (headers_.size() >= FRAME_INDEX_MAX_HEADERS) {
+        return -1;
+    }
+    headers_.push_back(header);
+    durations_ns_.push_back(frame_geometry(header).duration_ns);
+    last_header_id_ = static_cast<uint16_t>(headers_.size() - 1);
+    return last_header_id_;
+}
+
+int Mp3FrameIndex::add(uint64_t offset, const FrameHeaderUnion& header) {
+    if (full_) {
+        return -1;
+    }
+    int id = header_id(header);
+    if (id < 0) {
+        full_ = true;
+        return -1;
+    }
+
+    uint64_t index = entries_.size();
+    uint64_t delta = offset - last_offset_;
+    if (checkpoints_.empty() || index - checkpoints_.back().first_frame >= FRAME_INDEX_BLOCK_SIZE
+        || delta > UINT16_MAX) {
+        checkpoints_.push_back(Checkpoint{index, offset, time_ns_});
+        delta = 0;
+    }
+    entries_.push_back(Entry{static_cast<uint16_t>(delta), static_cast<uint16_t>(id)});
+    last_offset_ = offset;
+    time_ns_ += durations_ns_[id];
+    return 0;
+}
+
+void Mp3FrameIndex::shrink_to_fit() {
+    entries_.shrink_to_fit();
+    checkpoints_.shrink_to_fit();
+    headers_.shrink_to_fit();
+    durations_ns_.shrink_to_fit();
+}
+
+size_t Mp3FrameIndex::memory_usage() const {
+    return entries_.capacity() * sizeof(Entry) + checkpoints_.capacity() * sizeof(Checkpoint)
+        + headers_.capacity() * sizeof(FrameHeaderUnion) + durations_ns_.capacity() * sizeof(uint32_t);
+}
+
+void Mp3FrameIndex::fill(uint64_t index, uint64_t offset, uint64_t time_ns, Mp3FrameInfo& info) const {
+    const FrameHeaderUnion& header = headers_[entries_[index].header_id];
+    info.index = index;
+    info.offset = offset;
+    info.size = frame_geometry(header).frame_size;
+    info.time_ns = time_ns;
+    info.header = header;
+    info.exact = true;
+}
+
+int Mp3FrameIndex::frame(uint64_t index, Mp3FrameInfo& info) const {
+    if (index >= entries_.size()) {
+        return -1;
+    }
+    // 最后一个 first_frame <= index 的检查点
+    auto it = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), index,
+                               [](uint64_t i, const Checkpoint& c) { return i < c.first_frame; });
+    const Checkpoint& checkpoint = *(it - 1);
+    uint64_t offset = checkpoint.offset;
+    uint64_t time_ns = checkpoint.time_ns;
+    for (uint64_t i = checkpoint.first_frame; i < index; ++i) {
+        offset += entries_[i + 1].delta;
+        time_ns += durations_ns_[entries_[i].header_id];
+    }
+    fill(index, offset, time_ns, info);
+    return 0;
+}
+
+int Mp3FrameIndex::frame_at(uint64_t offset, Mp3FrameInfo& info) const {
+    if (entries_.empty()) {
+        return -1;
+    }
+    auto it = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), offset,
+                               [](uint64_t o, const Checkpoint& c) { return o < c.offset; });
+    if (it == checkpoints_.begin()) {
+        // 在第一帧之前
+        fill(0, checkpoints_[0].offset, 0, info);
+        return 0;
+    }
+    const Checkpoint& checkpoint = *(it - 1);
+    uint64_t block_end = it == checkpoints_.end() ? entries_.size() : it->first_frame;
+    uint64_t frame_offset = checkpoint.offset;
+    uint64_t time_ns = checkpoint.time_ns;
+    for (uint64_t i = checkpoint.first_frame; i < block_end; ++i) {
+        const FrameHeaderUnion& header = headers_[entries_[i].header_id];
+        if (offset < frame_offset + frame_geometry(header).frame_size) {
+            fill(i, frame_offset, time_ns, info);
+            return 0;
+        }
+        time_ns += durations_ns_[entries_[i].header_id];
+        if (i + 1 < block_end) {
+            uint64_t next = frame_offset + entries_[i + 1].delta;
+            // offset 落在本帧结尾和下一帧之间的垃圾数据中
+            if (offset < next) {
+                fill(i + 1, next, time_ns, info);
+                return 0;
+            }
+            frame_offset = next;
+        }
+    }
+    if (it == checkpoints_.end()) {
+        return -1;
+    }
+    fill(block_end, it->offset, it->time_ns, info);
+    return 0;
+}
+
+int Mp3FrameIndex::seek_to_time(uint64_t ms, Mp3FrameInfo& info) const {
+    uint64_t target_ns = ms * 1000000;
+    if (entries_.empty() || target_ns >= time_ns_) {
+        return -1;
+    }
+    auto it = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), target_ns,
+                               [](uint64_t t, const Checkpoint& c) { return t < c.time_ns; });
+    const Checkpoint& checkpoint = *(it - 1);
+    uint64_t block_end = it == checkpoints_.end() ? entries_.size() : it->first_frame;
+    uint64_t offset = checkpoint.offset;
+    uint64_t time_ns = checkpoint.time_ns;
+    for (uint64_t i = checkpoint.first_frame; i < block_end; ++i) {
+        uint64_t end_ns = time_ns + durations_ns_[entries_[i].header_id];
+        if (target_ns < end_ns || i + 1 == block_end) {
+            fill(i, offset, time_ns, info);
+            return 0;
+        }
+        time_ns = end_ns;
+        offset += entries_[i + 1].delta;
+    }
+    return -1;
+}
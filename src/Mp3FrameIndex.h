@@ -0,0 +1,81 @@
+//
+// MP3 帧索引: 扫描帧头时逐帧追加, 每帧 4 字节 (与上一帧的偏移差 + 去重后的帧头编号),
+// 每 FRAME_INDEX_BLOCK_SIZE 帧一个检查点记录绝对偏移和累计时长.
+// 按偏移或时间查找时先在检查点上二分, 再在块内顺序累加, 不需要重新扫描文件.
+// 索引大小与帧数成正比 (约 4.1 字节/帧), 不像 Mp3FrameRun 那样按帧头去重压缩,
+// 所以 Mp3Parser 只在 set_build_frame_index 或并行解码时建立
+//
+
+#ifndef MEDIAFORMATPARSER_MP3FRAMEINDEX_H
+#define MEDIAFORMATPARSER_MP3FRAMEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Mp3Frame.h"
+
+// 每个检查点覆盖的最大帧数, 偏移差超过 16 位时提前开始新块
+#define FRAME_INDEX_BLOCK_SIZE 256
+// 帧头编号为 16 位
+#define FRAME_INDEX_MAX_HEADERS 65536
+
+struct Mp3FrameInfo {
+    uint64_t index = 0;      // 帧序号, 从 0 开始; 估算结果中无意义
+    uint64_t offset = 0;     // 帧头的文件偏移
+    uint32_t size = 0;       // 帧长, 含帧头
+    uint64_t time_ns = 0;    // 帧的起始时刻
+    FrameHeaderUnion header{};
+    bool exact = true;       // false 表示由 TOC 或平均码率估算后对齐到帧头
+};
+
+class Mp3FrameIndex {
+public:
+    void clear();
+    // 按文件偏移递增的顺序追加, 帧头种类超过 FRAME_INDEX_MAX_HEADERS 时返回 -1 且不再追加
+    int add(uint64_t offset, const FrameHeaderUnion& header);
+    // 追加完成后释放多余的容量
+    void shrink_to_fit();
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    uint64_t duration_ns() const { return time_ns_; }
+    size_t memory_usage() const;
+
+    // 第 index 帧, 越界时返回 -1
+    int frame(uint64_t index, Mp3FrameInfo& info) const;
+    // 包含文件偏移 offset 的帧; offset 位于两帧之间 (垃圾数据) 时返回之后的一帧, 之后没有帧时返回 -1
+    int frame_at(uint64_t offset, Mp3FrameInfo& info) const;
+    // 包含时刻 ms 的帧, 超过总时长时返回 -1
+    int seek_to_time(uint64_t ms, Mp3FrameInfo& info) const;
+
+private:
+    struct Entry {
+        uint16_t delta;      // 与块内上一帧的偏移差, 块首为 0
+        uint16_t header_id;  // headers_ 的下标
+    };
+
+    struct Checkpoint {
+        uint64_t first_frame;
+        uint64_t offset;
+        uint64_t time_ns;
+    };
+
+    // 帧头编号, 编号用完时返回 -1
+    int header_id(const FrameHeaderUnion& header);
+    void fill(uint64_t index, uint64_t offset, uint64_t time_ns, Mp3FrameInfo& info) const;
+
+private:
+    std::vector<Entry> entries_;
+    std::vector<Checkpoint> checkpoints_;
+    std::vector<FrameHeaderUnion> headers_;
+    std::vector<uint32_t> durations_ns_;  // 与 headers_ 一一对应
+    uint16_t last_header_id_ = 0;
+
+    uint64_t last_offset_ = 0;
+    uint64_t time_ns_ = 0;
+    bool full_ = false;
+};
+
+
+#endif //MEDIAFORMATPARSER_MP3FRAMEINDEX_H
@@ -3,66 +3,140 @@
 //
 
 #include "Mp3Parser.h"
-#include "logger/easylogging++.h"
+#include "ByteScan.h"
+#include "TextWriter.h"
+#include "ParserLog.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
 #include "utils.h"
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <mpg123.h>
 
-std::ostream& operator << (std::ostream &out, const FrameHeaderUnion &c) {
-    out << "frame header:" << std::endl;
-    out << "\tsync: " << std::bitset<8>(c.bits.sync1) << std::bitset<3>(c.bits.sync2) << std::endl;
-    out << "\tversion: " << std::bitset<2>(c.bits.version) << std::endl;
-    out << "\tlayer: " << std::bitset<2>(c.bits.layer) << std::endl;
-    out << "\tcrc: " << std::bitset<1>(c.bits.error_protection) << std::endl;
-    out << "\tbitRateIndex: " << std::bitset<4>(c.bits.bit_rate_index) << " (" << get_bit_rate(c) << ")" << std::endl;
-    out << "\tsampleRateIndex: " << std::bitset<2>(c.bits.sample_rate_index) << " (" << get_sample_rate(c) << ")" << std::endl;
-    out << "\tpadding: " << std::bitset<1>(c.bits.padding) << std::endl;
-    out << "\textension: " << std::bitset<1>(c.bits.extension) << std::endl;
-    out << "\tchannelMode: " << std::bitset<2>(c.bits.channel_mode) << std::endl;
-    out << "\tmodeExtension: " << std::bitset<2>(c.bits.mode_extension) << std::endl;
-    out << "\tcopyright: " << std::bitset<1>(c.bits.copyright) << std::endl;
-    out << "\toriginal: " << std::bitset<1>(c.bits.original) << std::endl;
-    out << "\temphasis: " << std::bitset<2>(c.bits.emphasis) << std::endl;
+// MPEG 1 Layer III, 128 kbps, 44100 Hz
+static_assert(frame_geometry_table[(3 << 9) | (1 << 7) | (9 << 3)].frame_size == 417);
+static_assert(frame_geometry_table[(3 << 9) | (1 << 7) | (9 << 3) | 1].frame_size == 418);
+// MPEG 2 Layer III, 64 kbps, 22050 Hz
+static_assert(frame_geometry_table[(2 << 9) | (1 << 7) | (8 << 3)].frame_size == 208);
+// MPEG 1 Layer I, 384 kbps, 48000 Hz, padding
+static_assert(frame_geometry_table[(3 << 9) | (3 << 7) | (12 << 3) | (1 << 1) | 1].frame_size == 388);
+
+TextWriter& operator<<(TextWriter &out, const FrameHeaderUnion &c) {
+    out << "frame header:" << '\n';
+    out << "\tsync: " << std::bitset<8>(c.bits.sync1) << std::bitset<3>(c.bits.sync2) << '\n';
+    out << "\tversion: " << std::bitset<2>(c.bits.version) << '\n';
+    out << "\tlayer: " << std::bitset<2>(c.bits.layer) << '\n';
+    out << "\tcrc: " << std::bitset<1>(c.bits.error_protection) << '\n';
+    out << "\tbitRateIndex: " << std::bitset<4>(c.bits.bit_rate_index) << " (" << get_bit_rate(c) << ")" << '\n';
+    out << "\tsampleRateIndex: " << std::bitset<2>(c.bits.sample_rate_index) << " (" << get_sample_rate(c) << ")" << '\n';
+    out << "\tpadding: " << std::bitset<1>(c.bits.padding) << '\n';
+    out << "\textension: " << std::bitset<1>(c.bits.extension) << '\n';
+    out << "\tchannelMode: " << std::bitset<2>(c.bits.channel_mode) << '\n';
+    out << "\tmodeExtension: " << std::bitset<2>(c.bits.mode_extension) << '\n';
+    out << "\tcopyright: " << std::bitset<1>(c.bits.copyright) << '\n';
+    out << "\toriginal: " << std::bitset<1>(c.bits.original) << '\n';
+    out << "\temphasis: " << std::bitset<2>(c.bits.emphasis) << '\n';
     return out;
 }
 
-std::ostream& operator << (std::ostream &out, const Id3v1 &c) {
-    out << "Id3TagV1:" << std::endl;
-    out << "\tId: " << std::string(c.id, 3) << std::endl;
-    out << "\tsongName: " << std::string(c.song_name, 30) << std::endl;
-    out << "\tartist: " << std::string(c.artist, 30) << std::endl;
-    out << "\talbum: " << std::string(c.album, 30) << std::endl;
-    out << "\tyear: " << std::string(c.year, 4) << std::endl;
-    out << "\tcomment: " << std::string(c.comment, 30) << std::endl;
-    out << "\tgenre: " << static_cast<int>(c.genre) << std::endl;
+std::ostream& operator<<(std::ostream &out, const FrameHeaderUnion &c) {
+    return write_text(out, c);
+}
+
+TextWriter& operator<<(TextWriter &out, const Id3v1 &c) {
+    out << "Id3TagV1:" << '\n';
+    out << "\tId: " << std::string_view(c.id, 3) << '\n';
+    out << "\tsongName: " << std::string_view(c.song_name, 30) << '\n';
+    out << "\tartist: " << std::string_view(c.artist, 30) << '\n';
+    out << "\talbum: " << std::string_view(c.album, 30) << '\n';
+    out << "\tyear: " << std::string_view(c.year, 4) << '\n';
+    out << "\tcomment: " << std::string_view(c.comment, 30) << '\n';
+    out << "\tgenre: " << static_cast<int>(c.genre) << '\n';
     return out;
 }
 
-std::ostream& operator << (std::ostream &out, const Id3v2Header &c) {
-    out << "Id3TagV2 header:" << std::endl;
-    out << "\tid: " << std::string(c.id, 3) << std::endl;
-    out << "\tversion: " << int(c.version[0]) << " " << int(c.version[1]) << std::endl;
-    out << "\tflags: " << std::bitset<8>(c.flags) << std::endl;
-    out << "\tsize: " << c.size << std::endl;
+std::ostream& operator<<(std::ostream &out, const Id3v1 &c) {
+    return write_text(out, c);
+}
+
+TextWriter& operator<<(TextWriter &out, const Id3v2Header &c) {
+    out << "Id3TagV2 header:" << '\n';
+    out << "\tid: " << std::string_view(c.id, 3) << '\n';
+    out << "\tversion: " << int(c.version[0]) << " " << int(c.version[1]) << '\n';
+    out << "\tflags: " << std::bitset<8>(c.flags) << '\n';
+    out << "\tsize: " << c.size << '\n';
     return out;
 }
 
-std::ostream& operator << (std::ostream &out, const Id3v2ExtendedHeader &c) {
-    out << "Id3TagV2 extended header:" << std::endl;
-    out << "\textendedHeaderSize: " << c.header_size << std::endl;
-    out << "\textendedFlags: " << c.flags << std::endl;
-    out << "\tpaddingSize: " << c.padding_size << std::endl;
+std::ostream& operator<<(std::ostream &out, const Id3v2Header &c) {
+    return write_text(out, c);
+}
+
+TextWriter& operator<<(TextWriter &out, const Id3v2ExtendedHeader &c) {
+    out << "Id3TagV2 extended header:" << '\n';
+    out << "\textendedHeaderSize: " << c.header_size << '\n';
+    out << "\textendedFlags: " << c.flags << '\n';
+    out << "\tpaddingSize: " << c.padding_size << '\n';
+    return out;
+}
+
+std::ostream& operator<<(std::ostream &out, const Id3v2ExtendedHeader &c) {
+    return write_text(out, c);
+}
+
+TextWriter& operator<<(TextWriter &out, const Id3v2FrameHeader &c) {
+    out << "Id3TagV2 frame header:" << '\n';
+    out << "\tframeId: " << std::string_view(c.frame_id, c.frame_id[3] == '\0' ? 3 : 4) << '\n';
+    out << "\tsize: " << c.size << '\n';
+    out << "\tflags: " << c.flags << '\n';
     return out;
 }
 
-std::ostream& operator << (std::ostream &out, const Id3v2FrameHeader &c) {
-    out << "Id3TagV2 frame header:" << std::endl;
-    out << "\tframeId: " << std::string(c.frame_id, 4) << std::endl;
-    out << "\tsize: " << c.size << std::endl;
-    out << "\tflags: " << c.flags << std::endl;
+std::ostream& operator<<(std::ostream &out, const Id3v2FrameHeader &c) {
+    return write_text(out, c);
+}
+
+static const char* vbr_header_name(VbrHeaderType type) {
+    switch (type) {
+        case VBR_HEADER_XING:
+            return "Xing";
+        case VBR_HEADER_INFO:
+            return "Info";
+        case VBR_HEADER_VBRI:
+            return "VBRI";
+        default:
+            return "none";
+    }
+}
+
+TextWriter& operator<<(TextWriter &out, const VbrHeader &c) {
+    out << "vbr header:" << '\n';
+    out << "\ttype: " << vbr_header_name(c.type) << '\n';
+    out << "\toffset: " << c.offset << '\n';
+    out << "\tframes: " << c.frames << '\n';
+    out << "\tbytes: " << c.bytes << '\n';
+    out << "\tquality: " << c.quality << '\n';
+    out << "\ttoc: " << (c.has_toc ? XING_TOC_SIZE : c.vbri_toc.size()) << " entries" << '\n';
+    if (c.type == VBR_HEADER_VBRI) {
+        out << "\tframesPerEntry: " << c.vbri_frames_per_entry << '\n';
+        out << "\tdelay: " << c.vbri_delay << '\n';
+    }
+    if (c.encoder[0] != '\0') {
+        out << "\tencoder: " << c.encoder << '\n';
+        out << "\tencoderDelay: " << c.encoder_delay << '\n';
+        out << "\tencoderPadding: " << c.encoder_padding << '\n';
+    }
     return out;
 }
 
+std::ostream& operator<<(std::ostream &out, const VbrHeader &c) {
+    return write_text(out, c);
+}
+
 Mp3Parser::Mp3Parser(const std::string& file_path): Parser(file_path) {
 
 }
@@ -71,451 +145,1182 @@ Mp3Parser::~Mp3Parser() {
 
 }
 
+void Mp3Parser::set_build_frame_index(bool build_frame_index) {
+    build_frame_index_ = build_frame_index;
+}
+
 void Mp3Parser::parse_id3tag_v2_header() {
-    while (pos_ + 2 < data_size_) {
-        if (data_[pos_] == 'I' && data_[pos_ + 1] == 'D' && data_[pos_ + 2] == '3') {
-            LOG(DEBUG) << "got tag v2";
-            memcpy(&id3v2_header.id, data_ + pos_, 3);
-            pos_ += 3;
-            memcpy(id3v2_header.version, data_ + pos_, 2);
-            pos_ += 2;
-            if (id3v2_header.version[0] != 3) {
-                LOG(WARNING) << "not tag v2 version 3, got " << int(id3v2_header.version[0]);
-                break;
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    // ID3v2 标签只在文件开头识别, 音频帧负载中出现的 "ID3" 字节不是标签.
+    // 没有标签时从原位置继续查找音频帧
+    if (pos_ + ID3V2_HEADER_SIZE > data_size_ || memcmp(fetch(pos_, 3), "ID3", 3) != 0) {
+        return;
+    }
+    MFP_LOG(DEBUG) << "got tag v2";
+    const unsigned char* p = fetch(pos_, ID3V2_HEADER_SIZE);
+    memcpy(id3v2_header.id, p, 3);
+    memcpy(id3v2_header.version, p + 3, 2);
+    id3v2_header.flags = p[5];
+    id3v2_header.size = id3v2_syncsafe(p + 6);
+    pos_ += ID3V2_HEADER_SIZE;
+    MFP_LOG(TRACE) << id3v2_header;
+
+    int version = id3v2_header.version[0];
+    uint8_t flags = id3v2_header.flags;
+    size_t tag_end = std::min(pos_ + id3v2_header.size, data_size_);
+    // v2.4 可以在标签之后带 10 字节的 footer
+    size_t next_pos = std::min(pos_ + id3v2_header.size + (version == 4 && (flags & ID3V2_FLAG_FOOTER)
+            ? ID3V2_FOOTER_SIZE : 0), data_size_);
+    if (version < 2 || version > 4) {
+        LOG(WARNING) << "unsupported tag v2 version " << version;
+        pos_ = next_pos;
+        return;
+    }
+    // v2.2 的这一位表示压缩, 规范没有定义压缩方法
+    if (version == 2 && (flags & ID3V2_FLAG_EXTENDED_HEADER)) {
+        LOG(WARNING) << "compressed tag v2.2 is not supported";
+        pos_ = next_pos;
+        return;
+    }
+    has_id3v2_ = true;
+
+    // v2.2/2.3 的 unsynchronisation 作用于整个标签 (包括帧头), 重同步后在缓冲区中解析;
+    // v2.4 只作用于各帧负载, 帧头位置不变
+    size_t pos = pos_;
+    size_t end = tag_end;
+    bool buffered = version < 4 && (flags & ID3V2_FLAG_UNSYNCHRONISATION);
+    id3v2_buffer_.clear();
+    if (buffered) {
+        std::vector<unsigned char> raw;
+        read_range(pos_, tag_end - pos_, raw);
+        id3v2_resync(raw.data(), raw.size(), id3v2_buffer_);
+        pos = 0;
+        end = id3v2_buffer_.size();
+    }
+
+    has_extended_header_ = version >= 3 && (flags & ID3V2_FLAG_EXTENDED_HEADER) != 0;
+    if (has_extended_header_ && pos + 6 <= end) {
+        const unsigned char* e = id3v2_bytes(buffered, pos, 6);
+        if (version == 3) {
+            // 大小不含自身的 4 字节, 之后为 2 字节 flags 和 4 字节 padding 大小
+            id3v2_extended_header.header_size = bytes_to_int4_be(e);
+            id3v2_extended_header.flags = bytes_to_int2_be(e + 4);
+            if (pos + 10 <= end) {
+                id3v2_extended_header.padding_size = bytes_to_int4_be(id3v2_bytes(buffered, pos + 6, 4));
             }
+            pos += 4 + id3v2_extended_header.header_size;
+        } else {
+            // syncsafe 大小包含自身, 之后为 flag 字节数和 flags
+            id3v2_extended_header.header_size = id3v2_syncsafe(e);
+            id3v2_extended_header.flags = e[5];
+            pos += std::max<uint32_t>(id3v2_extended_header.header_size, 6);
+        }
+        MFP_LOG(TRACE) << id3v2_extended_header;
+    }
 
-            memcpy(&id3v2_header.flags, data_ + pos_, 1);
-            has_extended_header_ = ((id3v2_header.flags && 0b01000000) >> 6) == 1;
-            pos_++;
+    parse_id3v2_frames(pos, end, version, buffered);
+    pos_ = next_pos;
+}
 
-            id3v2_header.size =
-            (data_[pos_]&0x7F)*0x200000
-            + (data_[pos_+1]&0x7F)*0x4000
-            + (data_[pos_+2]&0x7F)*0x80
-            + (data_[pos_+3]&0x7F);
-            pos_ += 4;
+const unsigned char* Mp3Parser::id3v2_bytes(bool buffered, size_t pos, size_t len) {
+    return buffered ? id3v2_buffer_.data() + pos : fetch(pos, len);
+}
 
-            if (has_extended_header_) {
-                id3v2_extended_header.header_size = bytes_to_int4_be(data_ + pos_);
-                pos_ += 4;
+void Mp3Parser::parse_id3v2_frames(size_t pos, size_t end, int version, bool buffered) {
+    int id_size = version == 2 ? 3 : 4;
+    size_t header_size = version == 2 ? 6 : 10;
+    bool tag_unsync = version == 4 && (id3v2_header.flags & ID3V2_FLAG_UNSYNCHRONISATION);
+    while (pos + header_size <= end) {
+        const unsigned char* p = id3v2_bytes(buffered, pos, header_size);
+        Id3v2FrameHeader header{};
+        memcpy(header.frame_id, p, id_size);
+        // 帧之后的 padding 全为 0
+        if (!id3v2_valid_frame_id(header.frame_id, id_size)) {
+            break;
+        }
+        if (version == 2) {
+            header.size = bytes_to_int3_be(p + 3);
+        } else {
+            header.size = version == 4 ? id3v2_syncsafe(p + 4) : bytes_to_int4_be(p + 4);
+            header.flags = bytes_to_int2_be(p + 8);
+        }
+        pos += header_size;
+        if (pos + header.size > end) {
+            LOG(WARNING) << "tag v2 frame " << std::string_view(header.frame_id, id_size) << " exceeds the tag";
+            break;
+        }
 
-                memcpy(&id3v2_extended_header.flags, data_ + pos_, 2);
-                pos_ += 2;
+        // 第二个 flags 字节中的格式标志决定负载前的附加字节
+        uint8_t format_flags = header.flags & 0xFF;
+        size_t extra = 0;
+        if (version == 3) {
+            header.compressed = format_flags & 0x80;  // 4 字节解压后大小
+            header.encrypted = format_flags & 0x40;   // 1 字节加密方式
+            extra = (header.compressed ? 4 : 0) + (header.encrypted ? 1 : 0) + ((format_flags & 0x20) ? 1 : 0);
+        } else if (version == 4) {
+            header.compressed = format_flags & 0x08;
+            header.encrypted = format_flags & 0x04;
+            header.unsynchronised = tag_unsync || (format_flags & 0x02);
+            // 分组 ID, 加密方式, 4 字节数据长度
+            extra = ((format_flags & 0x40) ? 1 : 0) + (header.encrypted ? 1 : 0) + ((format_flags & 0x01) ? 4 : 0);
+        }
+        extra = std::min<size_t>(extra, header.size);
+        header.data_offset = pos + extra;
+        header.data_size = header.size - extra;
+        header.buffered = buffered;
+        MFP_LOG(TRACE) << header;
 
-                id3v2_extended_header.padding_size = bytes_to_int4_be(data_ + pos_);
-                pos_ += 4;
+        id3v2_frame_headers.push_back(header);
+        pos += header.size;
+    }
+}
 
-                pos_ += id3v2_extended_header.header_size;
-                LOG(INFO) << id3v2_extended_header;
-            }
-            LOG(INFO) << id3v2_header;
-
-            size_t start_pos = pos_;
-            while (pos_ - start_pos < id3v2_header.size) {
-                Id3v2FrameHeader header{};
-                memcpy(header.frame_id, data_ + pos_, 4);
-                bool valid_frame_id_ch = false;
-                for (int i =0; i< 4; ++i) {
-                    valid_frame_id_ch = header.frame_id[i] >= 'A' && header.frame_id[i] <= 'Z';
-                    if (i > 0) {
-                        valid_frame_id_ch = valid_frame_id_ch ||
-                                isdigit(header.frame_id[i]);
-                    }
-                    if (!valid_frame_id_ch) {
-                        break;
-                    }
-                }
-                if (!valid_frame_id_ch) {
-                    break;
-                }
-                pos_ += 4;
-                header.size = bytes_to_int4_be(data_ + pos_);
-                pos_ += 4;
-                memcpy(&header.flags, data_ + pos_, 2);
-                pos_ += 2;
-                LOG(INFO) << header;
+int Mp3Parser::read_range(size_t pos, size_t len, std::vector<unsigned char>& out) {
+    if (pos + len > data_size_) {
+        return -1;
+    }
+    size_t chunk_size = std::max<size_t>(window_capacity(), 1);
+    out.reserve(out.size() + len);
+    while (len > 0) {
+        size_t n = std::min(len, chunk_size);
+        const unsigned char* p = fetch(pos, n);
+        if (p == nullptr) {
+            return -1;
+        }
+        out.insert(out.end(), p, p + n);
+        pos += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int Mp3Parser::read_id3v2_frame(const Id3v2FrameHeader& frame, std::vector<unsigned char>& data) {
+    data.clear();
+    if (frame.compressed || frame.encrypted) {
+        return -1;
+    }
+    if (frame.buffered) {
+        if (frame.data_offset + frame.data_size > id3v2_buffer_.size()) {
+            return -1;
+        }
+        data.assign(id3v2_buffer_.begin() + frame.data_offset,
+                    id3v2_buffer_.begin() + frame.data_offset + frame.data_size);
+        return 0;
+    }
+    if (!frame.unsynchronised) {
+        return read_range(frame.data_offset, frame.data_size, data);
+    }
+    std::vector<unsigned char> raw;
+    if (read_range(frame.data_offset, frame.data_size, raw) < 0) {
+        return -1;
+    }
+    id3v2_resync(raw.data(), raw.size(), data);
+    return 0;
+}
 
-//                std::string str(reinterpret_cast<const char*>(data_ + pos_), header.size);
-//                LOG(INFO) << str;
+int Mp3Parser::id3v2_text(const Id3v2FrameHeader& frame, std::string& text) {
+    text.clear();
+    // 先按帧 ID 判断, 不读取其他帧的负载
+    bool v22 = frame.frame_id[3] == '\0';
+    if (frame.frame_id[0] != 'T' && memcmp(frame.frame_id, v22 ? "COM" : "COMM", v22 ? 3 : 4) != 0) {
+        return -1;
+    }
+    std::vector<unsigned char> data;
+    if (read_id3v2_frame(frame, data) < 0) {
+        return -1;
+    }
+    return id3v2_decode_text(frame.frame_id, data.data(), data.size(), text);
+}
 
-                pos_ += header.size;
-                id3v2_frame_headers.push_back(header);
-            }
-            pos_ = start_pos + id3v2_header.size;
-            break;
+int Mp3Parser::id3v2_picture(const Id3v2FrameHeader& frame, Id3v2Picture& picture) {
+    if (!id3v2_is_picture(frame.frame_id) || frame.compressed || frame.encrypted) {
+        return -1;
+    }
+    bool v22 = frame.frame_id[3] == '\0';
+    std::vector<unsigned char> data;
+    if (frame.buffered || frame.unsynchronised) {
+        // 图像数据在文件中不是原样的字节, 只能整体读取
+        if (read_id3v2_frame(frame, data) < 0) {
+            return -1;
+        }
+        int header_size = id3v2_parse_picture(v22, data.data(), data.size(), picture);
+        if (header_size < 0) {
+            return -1;
+        }
+        picture.contiguous = false;
+        picture.data_offset = 0;
+        picture.data_size = data.size() - header_size;
+        return 0;
+    }
+
+    // 先只读取开头部分, 描述过长时再读取整个负载
+    size_t prefix_size = std::min<size_t>(frame.data_size, ID3V2_PICTURE_PREFIX_SIZE);
+    if (read_range(frame.data_offset, prefix_size, data) < 0) {
+        return -1;
+    }
+    int header_size = id3v2_parse_picture(v22, data.data(), data.size(), picture);
+    if (header_size < 0 && prefix_size < frame.data_size) {
+        data.clear();
+        if (read_range(frame.data_offset, frame.data_size, data) < 0) {
+            return -1;
+        }
+        header_size = id3v2_parse_picture(v22, data.data(), data.size(), picture);
+    }
+    if (header_size < 0) {
+        return -1;
+    }
+    picture.contiguous = true;
+    picture.data_offset = frame.data_offset + header_size;
+    picture.data_size = frame.data_size - header_size;
+    return 0;
+}
+
+int Mp3Parser::attachments(std::vector<Attachment>& out) {
+    for (auto& frame: id3v2_frame_headers) {
+        Id3v2Picture picture;
+        if (!id3v2_is_picture(frame.frame_id) || id3v2_picture(frame, picture) < 0) {
+            continue;
+        }
+        Attachment attachment;
+        attachment.mime = picture.mime;
+        attachment.description = "type " + std::to_string(picture.type);
+        if (!picture.description.empty()) {
+            attachment.description += ": " + picture.description;
+        }
+        attachment.length = picture.data_size;
+        if (picture.contiguous) {
+            attachment.offset = picture.data_offset;
         } else {
-            pos_ ++;
+            // 只有少数经过 unsynchronisation 的标签需要复制还原后的图像数据
+            std::vector<unsigned char> data;
+            if (read_id3v2_frame(frame, data) < 0 || data.size() < picture.data_size) {
+                continue;
+            }
+            attachment.contiguous = false;
+            attachment.data.assign(data.end() - picture.data_size, data.end());
         }
+        out.push_back(std::move(attachment));
     }
+    return 0;
 }
 
 void Mp3Parser::parse_frame_headers() {
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    frame_index_.clear();
+    size_t threads = scan_threads_ == 0 ? std::thread::hardware_concurrency() : scan_threads_;
+    if (threads > 1 && data_ != nullptr && data_size_ - pos_ >= 2 * MP3_SCAN_MIN_RANGE
+        && parse_frame_headers_parallel(threads) == 0) {
+        frame_index_.shrink_to_fit();
+        return;
+    }
     while (pos_ + 1 < data_size_) {
-        if (data_[pos_] == 0xff && ((data_[pos_ + 1] & 0xe0) == 0xe0)) {
-            // LOG(DEBUG) << "got a frame header at " << pos_;
-            FrameHeaderUnion frame_header{};
-            memcpy(&frame_header.raw, data_ + pos_, 4);
-            LOG(INFO) << frame_header;
-
-            if (version_ == -1) {
-                version_ = frame_header.bits.version;
-            } else {
-                if (frame_header.bits.version != version_) {
-                    pos_ += 4;
-                    continue;
-                }
-            }
+        pos_ = find_sync(pos_, data_size_);
+        if (pos_ + 1 >= data_size_) {
+            break;
+        }
+        // LOG(DEBUG) << "got a frame header at " << pos_;
+        const unsigned char* p = fetch(pos_, 4);
+        FrameHeaderUnion frame_header{};
+        memcpy(&frame_header.raw, p, 4);
+        MFP_LOG(TRACE) << frame_header;
 
-            if (layer_ == -1) {
-                layer_ = frame_header.bits.layer;
-            } else {
-                if (frame_header.bits.layer != layer_) {
-                    pos_ += 4;
-                    continue;
-                }
+        if (version_ == -1) {
+            version_ = frame_header.bits.version;
+        } else {
+            if (frame_header.bits.version != version_) {
+                pos_ += 4;
+                continue;
             }
+        }
 
-            frame_headers.push_back(frame_header);
-            last_frame_pos_ = pos_;
-            uint32_t data_size = get_frame_data_size(frame_header);
-            LOG(INFO) << "data size: " << data_size;
-            pos_ += 4 + data_size;
+        if (layer_ == -1) {
+            layer_ = frame_header.bits.layer;
         } else {
-            pos_++;
+            if (frame_header.bits.layer != layer_) {
+                pos_ += 4;
+                continue;
+            }
+        }
+
+        if (frame_runs_.empty()) {
+            first_frame_pos_ = pos_;
+        }
+        add_frame(pos_, frame_header);
+        if (index_frames_) {
+            frame_index_.add(pos_, frame_header);
         }
+        last_frame_pos_ = pos_;
+        // 帧长包含帧头; 帧长未知 (free format 或保留取值) 时跳过帧头继续查找
+        uint32_t frame_size = decode_frame_header(p).frame_size;
+        MFP_LOG(TRACE) << "frame size: " << frame_size;
+        pos_ += std::max<uint32_t>(frame_size, 4);
     }
+    frame_index_.shrink_to_fit();
 }
 
-void Mp3Parser::parse_id3tag_v1() {
-    size_t pos = last_frame_pos_;
-    while (pos + 2 < data_size_) {
-        if (data_[pos] == 'T' && data_[pos + 1] == 'A' && data_[pos + 2] == 'G') {
-            LOG(DEBUG) << "got tag v1";
-            memcpy(&id3v1.id, data_ + pos, 3);
-            pos += 3;
-            memcpy(&id3v1.song_name, data_ + pos, 30);
-            pos += 30;
-            memcpy(&id3v1.artist, data_ + pos, 30);
-            pos += 30;
-            memcpy(&id3v1.album, data_ + pos, 30);
-            pos += 30;
-            memcpy(&id3v1.year, data_ + pos, 4);
-            pos += 4;
-            memcpy(&id3v1.comment, data_ + pos, 30);
-            pos += 30;
-            memcpy(&id3v1.genre, data_ + pos, 1);
-            LOG(INFO) << id3v1;
+FrameHeaderUnion Mp3Parser::header_at(size_t pos) const {
+    FrameHeaderUnion frame_header{};
+    memcpy(&frame_header.raw, data_ + pos, std::min<size_t>(4, data_size_ - pos));
+    return frame_header;
+}
+
+size_t Mp3Parser::walk_frames(size_t pos, size_t end, std::vector<uint64_t>& frames, size_t max_frames) const {
+    size_t accepted = 0;
+    while (pos < end && pos + 1 < data_size_ && accepted < max_frames) {
+        pos += find_mp3_sync(data_ + pos, data_size_ - pos);
+        if (pos + 1 >= data_size_) {
             break;
-        } else {
-            pos += 1;
         }
+        FrameHeaderUnion frame_header = header_at(pos);
+        if (frame_header.bits.version != version_ || frame_header.bits.layer != layer_) {
+            pos += 4;
+            continue;
+        }
+        frames.push_back(pos);
+        accepted++;
+        pos += std::max<uint32_t>(frame_geometry(frame_header).frame_size, 4);
     }
+    return pos;
 }
 
-int Mp3Parser::custom_parse() {
-    parse_id3tag_v2_header();
-    parse_frame_headers();
-    parse_id3tag_v1();
-
-    return 0;
+size_t Mp3Parser::find_sync_chain(size_t pos, size_t end) const {
+    while (pos < end) {
+        pos += find_mp3_sync(data_ + pos, end - pos);
+        if (pos >= end) {
+            break;
+        }
+        FrameHeaderUnion first = header_at(pos);
+        size_t next = pos;
+        int chained = 0;
+        while (chained < MP3_SCAN_CHAIN_FRAMES && next + 4 <= data_size_) {
+            FrameHeaderUnion h = header_at(next);
+            const unsigned char* p = data_ + next;
+            uint32_t frame_size = frame_geometry(h).frame_size;
+            if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0 || frame_size == 0 || h.bits.version != version_
+                || h.bits.layer != layer_ || h.bits.sample_rate_index != first.bits.sample_rate_index) {
+                break;
+            }
+            chained++;
+            next += frame_size;
+        }
+        // 文件末尾不足 MP3_SCAN_CHAIN_FRAMES 帧时以到达末尾为准
+        if (chained == MP3_SCAN_CHAIN_FRAMES || next == data_size_) {
+            return pos;
+        }
+        pos++;
+    }
+    return end;
 }
 
-int Mp3Parser::dump_info() {
-    std::string file_path = get_output_path() + ".txt";
-    std::ofstream file(file_path);
-    if (!file.is_open()) {
+int Mp3Parser::parse_frame_headers_parallel(size_t threads) {
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    // 第一个候选同步字之后不足两段时 (例如帧之前有大量垃圾数据) 由串行扫描处理
+    size_t start = pos_ + find_mp3_sync(data_ + pos_, data_size_ - pos_);
+    size_t range_count = start < data_size_ ? std::min(threads, (data_size_ - start) / MP3_SCAN_MIN_RANGE) : 0;
+    if (range_count < 2) {
         return -1;
     }
+    // 第一个候选同步字总是被接受, 并决定之后所有帧的版本和层, 与串行扫描一致
+    FrameHeaderUnion first_header = header_at(start);
+    version_ = first_header.bits.version;
+    layer_ = first_header.bits.layer;
 
-    for (auto header: id3v2_frame_headers) {
-        file << header;
+    std::vector<size_t> bounds(range_count + 1);
+    for (size_t i = 0; i <= range_count; ++i) {
+        bounds[i] = start + (data_size_ - start) / range_count * i;
     }
-    file << std::endl;
-
-    file << id3v1 << std::endl;
+    bounds[range_count] = data_size_;
 
-    if (frame_headers.empty()) {
-        return 0;
+    // 各段从同步链开始扫描到段尾, 记录接受的帧和越过段尾时的位置
+    std::vector<std::vector<uint64_t>> range_frames(range_count);
+    std::vector<size_t> range_exits(range_count);
+    {
+        ThreadPool pool(std::min(threads, range_count));
+        for (size_t i = 0; i < range_count; ++i) {
+            pool.submit([this, i, &bounds, &range_frames, &range_exits] {
+                MFP_TRACE_SCOPE("scan_range");
+                size_t pos = i == 0 ? bounds[0] : find_sync_chain(bounds[i], bounds[i + 1]);
+                range_exits[i] = walk_frames(pos, bounds[i + 1], range_frames[i]);
+            });
+        }
+        pool.wait();
     }
 
-    int start_index = 1;
-    for (int i = 1; i < frame_headers.size(); ++i) {
-        if (frame_headers[i].raw != frame_headers[i-1].raw) {
-            if (start_index == i) {
-                file << "[" << start_index << "] " << frame_headers[i-1];
-            } else {
-                file << "[" << start_index << " - " << i << "] " << frame_headers[i-1];
-            }
-            start_index = i + 1;
+    // 按顺序衔接: pos 为串行扫描进入本段时的位置, 由此找到串行扫描在本段接受的第一帧,
+    // 该帧也在本段的扫描结果中时之后的帧完全相同, 否则 (同步链落在了帧负载中的伪同步字上) 重新串行扫描本段
+    std::vector<uint64_t> frames;
+    size_t pos = start;
+    int rescanned = 0;
+    for (size_t i = 0; i < range_count; ++i) {
+        if (pos >= bounds[i + 1]) {
+            continue;
+        }
+        std::vector<uint64_t> head;
+        size_t next = walk_frames(pos, bounds[i + 1], head, 1);
+        if (head.empty()) {
+            pos = next;
+            continue;
+        }
+        const std::vector<uint64_t>& candidates = range_frames[i];
+        auto it = std::lower_bound(candidates.begin(), candidates.end(), head[0]);
+        if (it != candidates.end() && *it == head[0]) {
+            frames.insert(frames.end(), it, candidates.end());
+            pos = range_exits[i];
+        } else {
+            rescanned++;
+            pos = walk_frames(pos, bounds[i + 1], frames);
         }
     }
+    pos_ = pos;
+    MFP_LOG(DEBUG) << "parallel frame scan: " << range_count << " ranges, " << rescanned << " rescanned, "
+        << frames.size() << " frames";
 
-    file.close();
+    for (uint64_t offset: frames) {
+        FrameHeaderUnion header = header_at(offset);
+        add_frame(offset, header);
+        if (index_frames_) {
+            frame_index_.add(offset, header);
+        }
+    }
+    if (!frames.empty()) {
+        first_frame_pos_ = frames.front();
+        last_frame_pos_ = frames.back();
+    }
     return 0;
 }
 
-int Mp3Parser::dump_data() {
-    std::string output_file_path = get_output_path() + ".pcm";
+void Mp3Parser::add_frame(size_t pos, const FrameHeaderUnion& frame_header) {
+    if (!frame_runs_.empty() && frame_runs_.back().header.raw == frame_header.raw) {
+        frame_runs_.back().count++;
+    } else {
+        frame_runs_.push_back(Mp3FrameRun{frame_header, frame_count_, 1, pos});
+    }
+    frame_count_++;
+}
 
-    mpg123_init();
-    mpg123_handle *mh = mpg123_new(NULL, NULL);
-    mpg123_open(mh, file_path_.c_str());
+void Mp3Parser::parse_id3tag_v1() {
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    size_t pos = find_marker(last_frame_pos_, data_size_, "TAG");
+    if (pos < data_size_) {
+        parse_id3tag_v1_at(pos);
+    }
+}
 
-    long rate;
-    int channels, encoding;
-    if (mpg123_getformat(mh, &rate, &channels, &encoding) != MPG123_OK) {
-        LOG(ERROR) << "Failed to get audio format!" << std::endl;
+void Mp3Parser::parse_id3tag_v1_at(size_t pos) {
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << "got tag v1";
+    memcpy(&id3v1.id, fetch(pos, 3), 3);
+    pos += 3;
+    memcpy(&id3v1.song_name, fetch(pos, 30), 30);
+    pos += 30;
+    memcpy(&id3v1.artist, fetch(pos, 30), 30);
+    pos += 30;
+    memcpy(&id3v1.album, fetch(pos, 30), 30);
+    pos += 30;
+    memcpy(&id3v1.year, fetch(pos, 4), 4);
+    pos += 4;
+    memcpy(&id3v1.comment, fetch(pos, 30), 30);
+    pos += 30;
+    memcpy(&id3v1.genre, fetch(pos, 1), 1);
+    MFP_LOG(TRACE) << id3v1;
+}
+
+int Mp3Parser::parse_vbr_header(size_t frame_pos) {
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    FrameHeaderUnion frame_header{};
+    memcpy(&frame_header.raw, fetch(frame_pos, 4), 4);
+    const FrameGeometry& geometry = frame_geometry(frame_header);
+    // 只有 Layer III 会写入 VBR 头
+    if (frame_header.bits.layer != 1 || geometry.frame_size == 0) {
         return -1;
     }
+    size_t frame_end = std::min(frame_pos + geometry.frame_size, data_size_);
 
-    LOG(INFO) << "Sample rate: " << rate << ", Channels: " << channels << ", encoding: " << encoding << std::endl;
+    // Xing/Info 紧跟在 side information 之后, error_protection 为 0 时帧头后有 2 字节 CRC
+    size_t xing_pos = frame_pos + 4 + (frame_header.bits.error_protection ? 0 : 2)
+            + get_side_info_size(frame_header);
+    if (parse_xing_header(xing_pos, frame_end) == 0) {
+        vbr_header_.offset = frame_pos;
+        return 0;
+    }
+    // VBRI 固定位于帧头之后 32 字节
+    if (parse_vbri_header(frame_pos + 4 + 32, frame_end) == 0) {
+        vbr_header_.offset = frame_pos;
+        return 0;
+    }
+    return -1;
+}
 
-    const size_t buffer_size = 8192;
-    unsigned char buffer[buffer_size];
-    size_t done;
+int Mp3Parser::parse_xing_header(size_t pos, size_t frame_end) {
+    if (pos + 8 > frame_end) {
+        return -1;
+    }
+    const unsigned char* p = fetch(pos, 8);
+    VbrHeaderType type;
+    if (memcmp(p, "Xing", 4) == 0) {
+        type = VBR_HEADER_XING;
+    } else if (memcmp(p, "Info", 4) == 0) {
+        type = VBR_HEADER_INFO;
+    } else {
+        return -1;
+    }
+    VbrHeader header;
+    header.type = type;
+    uint32_t flags = bytes_to_int4_be(p + 4);
+    pos += 8;
 
-    std::ofstream out(output_file_path.c_str(), std::ios::binary);
-    while (mpg123_read(mh, buffer, buffer_size, &done) == MPG123_OK) {
-        out.write(reinterpret_cast<char *>(buffer), done);
+    if ((flags & 0x01) && pos + 4 <= frame_end) {
+        header.frames = bytes_to_int4_be(fetch(pos, 4));
+        pos += 4;
+    }
+    if ((flags & 0x02) && pos + 4 <= frame_end) {
+        header.bytes = bytes_to_int4_be(fetch(pos, 4));
+        pos += 4;
+    }
+    if ((flags & 0x04) && pos + XING_TOC_SIZE <= frame_end) {
+        memcpy(header.toc, fetch(pos, XING_TOC_SIZE), XING_TOC_SIZE);
+        header.has_toc = true;
+        pos += XING_TOC_SIZE;
+    }
+    if ((flags & 0x08) && pos + 4 <= frame_end) {
+        header.quality = bytes_to_int4_be(fetch(pos, 4));
+        pos += 4;
     }
 
-    out.close();
-    mpg123_close(mh);
-    mpg123_delete(mh);
-    mpg123_exit();
+    // LAME 扩展: 9 字节编码器版本, 第 21-23 字节为各 12 位的 encoder delay 和 padding
+    if (pos + 24 <= frame_end) {
+        const unsigned char* lame = fetch(pos, 24);
+        if (isalpha(lame[0]) && isalpha(lame[1]) && isalpha(lame[2]) && isalpha(lame[3])) {
+            memcpy(header.encoder, lame, LAME_ENCODER_SIZE);
+            header.encoder[LAME_ENCODER_SIZE] = '\0';
+            header.encoder_delay = (lame[21] << 4) | (lame[22] >> 4);
+            header.encoder_padding = ((lame[22] & 0x0f) << 8) | lame[23];
+        }
+    }
 
+    vbr_header_ = std::move(header);
+    MFP_LOG(DEBUG) << vbr_header_;
     return 0;
 }
 
-int get_sample_rate(const FrameHeaderUnion& frame_header) {
-    int sample_rate = 1;
+int Mp3Parser::parse_vbri_header(size_t pos, size_t frame_end) {
+    // "VBRI", 版本, delay, quality, 字节数, 帧数, TOC 项数, 缩放, 项大小, 每项帧数
+    if (pos + 26 > frame_end || memcmp(fetch(pos, 4), "VBRI", 4) != 0) {
+        return -1;
+    }
+    const unsigned char* p = fetch(pos, 26);
+    VbrHeader header;
+    header.type = VBR_HEADER_VBRI;
+    header.vbri_delay = bytes_to_int2_be(p + 6);
+    header.quality = bytes_to_int2_be(p + 8);
+    header.bytes = bytes_to_int4_be(p + 10);
+    header.frames = bytes_to_int4_be(p + 14);
+    uint16_t entry_count = bytes_to_int2_be(p + 18);
+    uint16_t scale = bytes_to_int2_be(p + 20);
+    uint16_t entry_size = bytes_to_int2_be(p + 22);
+    header.vbri_frames_per_entry = bytes_to_int2_be(p + 24);
+    pos += 26;
 
-    // MPEG 2.5
-    if (frame_header.bits.version == 0) {
-        if (frame_header.bits.sample_rate_index == 0) {
-            sample_rate = 11025;
-        } else if (frame_header.bits.sample_rate_index == 1) {
-            sample_rate = 12000;
-        } else if (frame_header.bits.sample_rate_index == 2) {
-            sample_rate = 8000;
+    // TOC 不受帧长限制, 但不能超出文件
+    if (entry_size >= 1 && entry_size <= 4 && pos + static_cast<size_t>(entry_count) * entry_size <= data_size_) {
+        header.vbri_toc.reserve(entry_count);
+        for (uint16_t i = 0; i < entry_count; ++i) {
+            const unsigned char* e = fetch(pos, entry_size);
+            uint32_t value = 0;
+            for (uint16_t j = 0; j < entry_size; ++j) {
+                value = (value << 8) | e[j];
+            }
+            header.vbri_toc.push_back(value * scale);
+            pos += entry_size;
         }
     }
-    // MPEG 2
-    else if (frame_header.bits.version == 2) {
-        if (frame_header.bits.sample_rate_index == 0) {
-            sample_rate = 22050;
-        } else if (frame_header.bits.sample_rate_index == 1) {
-            sample_rate = 24000;
-        } else if (frame_header.bits.sample_rate_index == 2) {
-            sample_rate = 16000;
-        }
+
+    vbr_header_ = std::move(header);
+    MFP_LOG(DEBUG) << vbr_header_;
+    return 0;
+}
+
+double Mp3Parser::vbr_duration(const FrameHeaderUnion& first_frame) const {
+    const FrameGeometry& geometry = frame_geometry(first_frame);
+    if (vbr_header_.frames == 0 || geometry.sample_rate == 0) {
+        return 0;
+    }
+    // 去掉编码器在首尾补的样本, 与无缝播放的时长一致
+    double samples = static_cast<double>(vbr_header_.frames) * geometry.sample_count;
+    double trimmed = samples - vbr_header_.encoder_delay - vbr_header_.encoder_padding;
+    return (trimmed > 0 ? trimmed : samples) / geometry.sample_rate;
+}
+
+bool Mp3Parser::is_chained_frame(size_t pos, size_t end, const FrameHeaderUnion& first_frame) {
+    const unsigned char* p = fetch(pos, 4);
+    FrameHeaderUnion frame_header{};
+    memcpy(&frame_header.raw, p, 4);
+    if (frame_header.bits.version != first_frame.bits.version || frame_header.bits.layer != first_frame.bits.layer
+        || frame_header.bits.sample_rate_index != first_frame.bits.sample_rate_index) {
+        return false;
+    }
+    uint32_t frame_size = decode_frame_header(p).frame_size;
+    if (frame_size == 0) {
+        return false;
+    }
+    // 最后一帧之后没有下一帧可以校验
+    size_t next = pos + frame_size;
+    if (next + 4 > end) {
+        return next <= end;
     }
-        // MPEG 1
-    else if (frame_header.bits.version == 3) {
-        if (frame_header.bits.sample_rate_index == 0) {
-            sample_rate = 44100;
-        } else if (frame_header.bits.sample_rate_index == 1) {
-            sample_rate = 48000;
-        } else if (frame_header.bits.sample_rate_index == 2) {
-            sample_rate = 32000;
+    const unsigned char* n = fetch(next, 4);
+    return n[0] == 0xff && (n[1] & 0xe0) == 0xe0 && ((n[1] >> 1) & 0x0f) == ((p[1] >> 1) & 0x0f)
+        && ((n[2] >> 2) & 0x03) == ((p[2] >> 2) & 0x03);
+}
+
+double Mp3Parser::sample_bit_rate(size_t start, size_t end, const FrameHeaderUnion& first_frame) {
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    // 每帧时长相同, 各帧码率的算术平均就是按时长加权的平均码率
+    double sum = get_bit_rate(first_frame);
+    int count = 1;
+    for (int i = 1; i <= PROBE_SAMPLE_COUNT; ++i) {
+        size_t pos = start + (end - start) / (PROBE_SAMPLE_COUNT + 1) * i;
+        size_t limit = std::min(end, pos + PROBE_SAMPLE_RANGE);
+        while (pos + 4 <= limit) {
+            pos = find_sync(pos, limit);
+            if (pos + 4 > limit) {
+                break;
+            }
+            if (!is_chained_frame(pos, end, first_frame)) {
+                pos++;
+                continue;
+            }
+            for (int n = 0; n < PROBE_SAMPLE_FRAMES && pos + 4 <= end; ++n) {
+                const FrameGeometry& geometry = decode_frame_header(fetch(pos, 4));
+                if (geometry.frame_size == 0 || !is_chained_frame(pos, end, first_frame)) {
+                    break;
+                }
+                sum += geometry.bit_rate;
+                count++;
+                pos += geometry.frame_size;
+            }
+            break;
         }
     }
+    return sum / count;
+}
 
-    return sample_rate;
+size_t Mp3Parser::find_sync(size_t pos, size_t end) {
+    return scan_for(pos, end, 2, find_mp3_sync);
 }
 
-int get_bit_rate(const FrameHeaderUnion& frame_header) {
-    int bitrate = 0;
-    // MPEG 1
-    if (frame_header.bits.version == 3) {
-        // Layer I
-        if (frame_header.bits.layer == 3) {
-            if (frame_header.bits.bit_rate_index >= 1 && frame_header.bits.bit_rate_index <= 14) {
-                bitrate = frame_header.bits.bit_rate_index*32;
+size_t Mp3Parser::find_marker(size_t pos, size_t end, const char* marker) {
+    return scan_for(pos, end, 3, [marker](const unsigned char* data, size_t size) {
+        return find_marker3(data, size, marker);
+    });
+}
+
+uint64_t Mp3Parser::estimate_offset(uint64_t ms) const {
+    double duration_ms = stream_info_.duration * 1000;
+    double audio_bytes = static_cast<double>(audio_end_ - first_frame_pos_);
+    if (vbr_header_.bytes > 0) {
+        audio_bytes = std::min<double>(vbr_header_.bytes, audio_bytes);
+    }
+
+    if (vbr_header_.has_toc) {
+        // toc[i] 为 i% 时长处的字节位置 (按 1/256 计), 相邻两项之间线性插值
+        double percent = std::min(ms / duration_ms * 100, 99.999);
+        int i = static_cast<int>(percent);
+        double a = vbr_header_.toc[i];
+        double b = i + 1 < XING_TOC_SIZE ? vbr_header_.toc[i + 1] : 256;
+        double position = a + (b - a) * (percent - i);
+        return first_frame_pos_ + static_cast<uint64_t>(position / 256 * audio_bytes);
+    }
+
+    if (!vbr_header_.vbri_toc.empty() && vbr_header_.vbri_frames_per_entry > 0) {
+        // 每项时长相同, 在所在项内线性插值
+        const FrameHeaderUnion& first_frame = frame_runs_[0].header;
+        double entry_ms = 1000.0 * vbr_header_.vbri_frames_per_entry * get_sample_count_per_frame(first_frame)
+            / get_sample_rate(first_frame);
+        uint64_t offset = first_frame_pos_;
+        double time_ms = 0;
+        for (uint32_t bytes: vbr_header_.vbri_toc) {
+            if (time_ms + entry_ms > ms) {
+                return offset + static_cast<uint64_t>((ms - time_ms) / entry_ms * bytes);
             }
+            offset += bytes;
+            time_ms += entry_ms;
         }
-        // Layer II
-        else if (frame_header.bits.layer == 2) {
-            if (frame_header.bits.bit_rate_index == 1) {
-                bitrate = 32;
-            } else if (frame_header.bits.bit_rate_index == 2) {
-                bitrate = 48;
-            } else if (frame_header.bits.bit_rate_index == 3) {
-                bitrate = 56;
-            } else if (frame_header.bits.bit_rate_index == 4) {
-                bitrate = 64;
-            } else if (frame_header.bits.bit_rate_index == 5) {
-                bitrate = 80;
-            } else if (frame_header.bits.bit_rate_index == 6) {
-                bitrate = 96;
-            } else if (frame_header.bits.bit_rate_index == 7) {
-                bitrate = 112;
-            } else if (frame_header.bits.bit_rate_index == 8) {
-                bitrate = 128;
-            } else if (frame_header.bits.bit_rate_index == 9) {
-                bitrate = 160;
-            } else if (frame_header.bits.bit_rate_index == 10) {
-                bitrate = 192;
-            } else if (frame_header.bits.bit_rate_index == 11) {
-                bitrate = 224;
-            } else if (frame_header.bits.bit_rate_index == 12) {
-                bitrate = 256;
-            } else if (frame_header.bits.bit_rate_index == 13) {
-                bitrate = 320;
-            } else if (frame_header.bits.bit_rate_index == 14) {
-                bitrate = 384;
-            }
+        return offset;
+    }
+
+    return first_frame_pos_ + static_cast<uint64_t>(ms / duration_ms * audio_bytes);
+}
+
+int Mp3Parser::align_frame(size_t pos, Mp3FrameInfo& info) {
+    const FrameHeaderUnion& first_frame = frame_runs_[0].header;
+    size_t limit = std::min(audio_end_, pos + PROBE_SAMPLE_RANGE);
+    while (pos + 4 <= limit) {
+        pos = find_sync(pos, limit);
+        if (pos + 4 > limit) {
+            break;
         }
-        // Layer III
-        else if (frame_header.bits.layer == 1) {
-            if (frame_header.bits.bit_rate_index == 1) {
-                bitrate = 32;
-            } else if (frame_header.bits.bit_rate_index == 2) {
-                bitrate = 40;
-            } else if (frame_header.bits.bit_rate_index == 3) {
-                bitrate = 48;
-            } else if (frame_header.bits.bit_rate_index == 4) {
-                bitrate = 56;
-            } else if (frame_header.bits.bit_rate_index == 5) {
-                bitrate = 64;
-            } else if (frame_header.bits.bit_rate_index == 6) {
-                bitrate = 80;
-            } else if (frame_header.bits.bit_rate_index == 7) {
-                bitrate = 96;
-            } else if (frame_header.bits.bit_rate_index == 8) {
-                bitrate = 112;
-            } else if (frame_header.bits.bit_rate_index == 9) {
-                bitrate = 128;
-            } else if (frame_header.bits.bit_rate_index == 10) {
-                bitrate = 160;
-            } else if (frame_header.bits.bit_rate_index == 11) {
-                bitrate = 192;
-            } else if (frame_header.bits.bit_rate_index == 12) {
-                bitrate = 224;
-            } else if (frame_header.bits.bit_rate_index == 13) {
-                bitrate = 256;
-            } else if (frame_header.bits.bit_rate_index == 14) {
-                bitrate = 320;
-            }
+        if (!is_chained_frame(pos, audio_end_, first_frame)) {
+            pos++;
+            continue;
         }
+        info.index = 0;
+        info.offset = pos;
+        memcpy(&info.header.raw, fetch(pos, 4), 4);
+        info.size = frame_geometry(info.header).frame_size;
+        info.exact = false;
+        return 0;
     }
-    // MPEG 2, MPEG 2.5
-    else if (frame_header.bits.version == 0 || frame_header.bits.version == 2) {
-        // Layer I
-        if (frame_header.bits.layer == 3) {
-            if (frame_header.bits.bit_rate_index == 1) {
-                bitrate = 32;
-            } else if (frame_header.bits.bit_rate_index == 2) {
-                bitrate = 48;
-            } else if (frame_header.bits.bit_rate_index == 3) {
-                bitrate = 56;
-            } else if (frame_header.bits.bit_rate_index == 4) {
-                bitrate = 64;
-            } else if (frame_header.bits.bit_rate_index == 5) {
-                bitrate = 80;
-            } else if (frame_header.bits.bit_rate_index == 6) {
-                bitrate = 96;
-            } else if (frame_header.bits.bit_rate_index == 7) {
-                bitrate = 112;
-            } else if (frame_header.bits.bit_rate_index == 8) {
-                bitrate = 128;
-            } else if (frame_header.bits.bit_rate_index == 9) {
-                bitrate = 144;
-            } else if (frame_header.bits.bit_rate_index == 10) {
-                bitrate = 160;
-            } else if (frame_header.bits.bit_rate_index == 11) {
-                bitrate = 176;
-            } else if (frame_header.bits.bit_rate_index == 12) {
-                bitrate = 192;
-            } else if (frame_header.bits.bit_rate_index == 13) {
-                bitrate = 224;
-            } else if (frame_header.bits.bit_rate_index == 14) {
-                bitrate = 256;
+    return -1;
+}
+
+int Mp3Parser::frame_at(uint64_t offset, Mp3FrameInfo& info) {
+    if (!frame_index_.empty()) {
+        return frame_index_.frame_at(offset, info);
+    }
+    if (frame_runs_.empty() || offset >= audio_end_) {
+        return -1;
+    }
+    if (align_frame(std::max<uint64_t>(offset, first_frame_pos_), info) < 0) {
+        return -1;
+    }
+    // 按平均码率折算起始时刻
+    info.time_ns = static_cast<uint64_t>(static_cast<double>(info.offset - first_frame_pos_) * 8
+        / (stream_info_.bit_rate * 1000.0) * 1e9);
+    return 0;
+}
+
+int Mp3Parser::seek_to_time(uint64_t ms, Mp3FrameInfo& info) {
+    if (!frame_index_.empty()) {
+        return frame_index_.seek_to_time(ms, info);
+    }
+    if (frame_runs_.empty() || stream_info_.duration <= 0 || ms >= stream_info_.duration * 1000) {
+        return -1;
+    }
+    uint64_t offset = estimate_offset(ms);
+    if (align_frame(offset, info) < 0) {
+        // 估算位置在最后一帧中时向后找不到帧头, 改为从前一段开始对齐, 再逐帧前进到包含该位置的帧
+        size_t start = offset - std::min<uint64_t>(offset - first_frame_pos_, PROBE_SAMPLE_RANGE);
+        if (align_frame(start, info) < 0) {
+            return -1;
+        }
+        while (info.size > 0 && info.offset + info.size <= offset
+               && is_chained_frame(info.offset + info.size, audio_end_, frame_runs_[0].header)) {
+            info.offset += info.size;
+            memcpy(&info.header.raw, fetch(info.offset, 4), 4);
+            info.size = frame_geometry(info.header).frame_size;
+        }
+    }
+    info.time_ns = ms * 1000000;
+    return 0;
+}
+
+int Mp3Parser::custom_parse() {
+    size_t decode_threads = decode_threads_ == 0 ? std::thread::hardware_concurrency() : decode_threads_;
+    index_frames_ = build_frame_index_ || decode_threads > 1;
+    parse_id3tag_v2_header();
+    parse_frame_headers();
+    parse_id3tag_v1();
+    if (!frame_runs_.empty()) {
+        parse_vbr_header(first_frame_pos_);
+        fill_stream_info();
+    }
+    MFP_LOG(DEBUG) << "frame index: " << frame_index_.size() << " frames, " << frame_index_.memory_usage() << " bytes";
+
+    stats_.items = frame_count_;
+    stats_.item_unit = "frames";
+    return 0;
+}
+
+void Mp3Parser::fill_stream_info() {
+    const FrameHeaderUnion& header = frame_runs_.front().header;
+    double duration = 0;
+    for (auto& run: frame_runs_) {
+        duration += run.count * (frame_geometry(run.header).duration_ns / 1e9);
+    }
+    audio_end_ = last_frame_pos_ + frame_geometry(frame_runs_.back().header).frame_size;
+
+    stream_info_.format = "mp3";
+    stream_info_.has_audio = true;
+    stream_info_.sample_rate = get_sample_rate(header);
+    stream_info_.channels = header.bits.channel_mode == 3 ? 1 : 2;
+    stream_info_.duration = duration;
+    if (duration > 0) {
+        stream_info_.bit_rate = static_cast<uint32_t>((audio_end_ - first_frame_pos_) * 8 / duration / 1000 + 0.5);
+    }
+}
+
+int Mp3Parser::custom_probe() {
+    stream_info_.format = "mp3";
+
+    parse_id3tag_v2_header();
+
+    // 只在标签之后的有限范围内寻找第一个音频帧
+    size_t search_end = std::min(data_size_, pos_ + PROBE_SYNC_RANGE);
+    FrameHeaderUnion frame_header{};
+    bool found = false;
+    while (pos_ + 4 <= search_end) {
+        pos_ = find_sync(pos_, search_end);
+        if (pos_ + 4 > search_end) {
+            break;
+        }
+        const unsigned char* p = fetch(pos_, 4);
+        if (p[0] == 0xff && ((p[1] & 0xe0) == 0xe0)) {
+            memcpy(&frame_header.raw, p, 4);
+            if (frame_header.bits.layer != 0 && get_bit_rate(frame_header) > 0
+                && frame_header.bits.sample_rate_index != 3) {
+                found = true;
+                break;
             }
         }
-        // Layer II, Layer III
-        else if (frame_header.bits.layer == 2 || frame_header.bits.layer == 1) {
-            if (frame_header.bits.bit_rate_index == 1) {
-                bitrate = 8;
-            } else if (frame_header.bits.bit_rate_index == 2) {
-                bitrate = 16;
-            } else if (frame_header.bits.bit_rate_index == 3) {
-                bitrate = 24;
-            } else if (frame_header.bits.bit_rate_index == 4) {
-                bitrate = 32;
-            } else if (frame_header.bits.bit_rate_index == 5) {
-                bitrate = 40;
-            } else if (frame_header.bits.bit_rate_index == 6) {
-                bitrate = 48;
-            } else if (frame_header.bits.bit_rate_index == 7) {
-                bitrate = 56;
-            } else if (frame_header.bits.bit_rate_index == 8) {
-                bitrate = 64;
-            } else if (frame_header.bits.bit_rate_index == 9) {
-                bitrate = 80;
-            } else if (frame_header.bits.bit_rate_index == 10) {
-                bitrate = 96;
-            } else if (frame_header.bits.bit_rate_index == 11) {
-                bitrate = 112;
-            } else if (frame_header.bits.bit_rate_index == 12) {
-                bitrate = 128;
-            } else if (frame_header.bits.bit_rate_index == 13) {
-                bitrate = 144;
-            } else if (frame_header.bits.bit_rate_index == 14) {
-                bitrate = 160;
+        pos_++;
+    }
+    if (!found) {
+        LOG(ERROR) << "no frame header found";
+        return -1;
+    }
+    add_frame(pos_, frame_header);
+    first_frame_pos_ = pos_;
+    version_ = frame_header.bits.version;
+    layer_ = frame_header.bits.layer;
+
+    // ID3v1 固定位于文件最后 128 字节, 直接读取尾部
+    size_t audio_end = data_size_;
+    if (data_size_ >= pos_ + ID3V1_SIZE && memcmp(fetch(data_size_ - ID3V1_SIZE, 3), "TAG", 3) == 0) {
+        parse_id3tag_v1_at(data_size_ - ID3V1_SIZE);
+        audio_end -= ID3V1_SIZE;
+    }
+    audio_end_ = audio_end;
+
+    stream_info_.has_audio = true;
+    stream_info_.sample_rate = get_sample_rate(frame_header);
+    stream_info_.channels = frame_header.bits.channel_mode == 3 ? 1 : 2;
+
+    // 有 Xing/Info/VBRI 头时直接由帧数得出时长, 不需要扫描文件
+    double duration = 0;
+    if (parse_vbr_header(pos_) == 0) {
+        duration = vbr_duration(frame_header);
+    }
+    if (duration > 0) {
+        uint64_t bytes = vbr_header_.bytes > 0 ? vbr_header_.bytes : audio_end - pos_;
+        stream_info_.duration = duration;
+        stream_info_.bit_rate = static_cast<uint32_t>(bytes * 8 / duration / 1000 + 0.5);
+    } else {
+        // 按抽样帧的平均码率估算, 对 CBR 文件准确
+        double bit_rate = sample_bit_rate(pos_, audio_end, frame_header);
+        stream_info_.bit_rate = static_cast<uint32_t>(bit_rate + 0.5);
+        stream_info_.duration = (audio_end - pos_) * 8.0 / (bit_rate * 1000);
+    }
+    return 0;
+}
+
+int Mp3Parser::dump_info() {
+    std::string file_path = get_output_path() + ".txt";
+    TextWriter file;
+    if (file.open(file_path) < 0) {
+        return -1;
+    }
+
+    // 文本和图片帧在这里才读取负载, 图片只输出位置
+    std::string text;
+    Id3v2Picture picture;
+    for (auto& header: id3v2_frame_headers) {
+        file << header;
+        if (id3v2_text(header, text) == 0) {
+            file << "\ttext: " << text << '\n';
+        } else if (id3v2_picture(header, picture) == 0) {
+            file << "\tpicture: " << picture.mime << ", type " << int(picture.type) << ", " << picture.data_size
+                << " bytes";
+            if (picture.contiguous) {
+                file << " at " << picture.data_offset;
             }
+            file << '\n';
+        }
+    }
+    file << '\n';
+
+    file << id3v1 << '\n';
+
+    if (vbr_header_.type != VBR_HEADER_NONE) {
+        file << vbr_header_ << '\n';
+    }
+
+    // 帧序号从 1 开始
+    for (const Mp3FrameRun& run: frame_runs_) {
+        if (run.count == 1) {
+            file << "[" << run.start_frame + 1 << "] " << run.header;
+        } else {
+            file << "[" << run.start_frame + 1 << " - " << run.start_frame + run.count << "] " << run.header;
         }
     }
-    return bitrate;
+
+    add_bytes_written(file.bytes_written());
+    return file.close();
+}
+
+int Mp3Parser::dump_report(ReportWriter& writer) {
+    writer.write(FileRecord{"mp3", file_path_, data_size_});
+
+    for (const Mp3FrameRun& run: frame_runs_) {
+        const FrameHeaderUnion& h = run.header;
+        // 按文件中的字节顺序组成帧头
+        const auto* b = reinterpret_cast<const unsigned char *>(&h.raw);
+        uint32_t header = (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | b[3];
+        writer.write(Mp3FrameRunRecord{
+                static_cast<uint32_t>(run.start_frame + 1), static_cast<uint32_t>(run.start_frame + run.count), header,
+                static_cast<uint32_t>(get_bit_rate(h)), static_cast<uint32_t>(get_sample_rate(h)),
+                static_cast<uint8_t>(h.bits.version), static_cast<uint8_t>(h.bits.layer),
+                static_cast<uint8_t>(h.bits.channel_mode), static_cast<uint8_t>(h.bits.padding)});
+    }
+    return 0;
 }
 
-int get_sample_count_per_frame(const FrameHeaderUnion& frame_header) {
-    int count = 0;
-    // MPEG 2.5
-    if (frame_header.bits.version == 0) {
-        if (frame_header.bits.layer == 3) {
-            count = 384;
-        } else if (frame_header.bits.layer == 2) {
-            count = 1152;
-        } else if (frame_header.bits.layer == 1) {
-            count = 576;
+// 每个线程复用一个解码句柄和输出缓冲区, 批量解析时不必为每个文件重新创建
+struct Mpg123Decoder {
+    mpg123_handle* handle = nullptr;
+    std::unique_ptr<unsigned char[]> buffer;
+
+    ~Mpg123Decoder() {
+        if (handle) {
+            mpg123_delete(handle);
         }
     }
-        // MPEG 2
-    else if (frame_header.bits.version == 2) {
-        if (frame_header.bits.layer == 3) {
-            count = 384;
-        } else if (frame_header.bits.layer == 2) {
-            count = 1152;
-        } else if (frame_header.bits.layer == 1) {
-            count = 576;
+};
+
+static Mpg123Decoder* thread_decoder() {
+    static std::once_flag init_flag;
+    static int init_result = MPG123_ERR;
+    std::call_once(init_flag, [] {
+        init_result = mpg123_init();
+    });
+    if (init_result != MPG123_OK) {
+        LOG(ERROR) << "mpg123_init failed: " << mpg123_plain_strerror(init_result);
+        return nullptr;
+    }
+
+    thread_local Mpg123Decoder decoder;
+    if (decoder.handle == nullptr) {
+        int error = MPG123_OK;
+        decoder.handle = mpg123_new(nullptr, &error);
+        if (decoder.handle == nullptr) {
+            LOG(ERROR) << "mpg123_new failed: " << mpg123_plain_strerror(error);
+            return nullptr;
         }
+        decoder.buffer = std::make_unique<unsigned char[]>(MP3_DECODE_OUTPUT_SIZE);
     }
-    // MPEG 1
-    else if (frame_header.bits.version == 3) {
-        if (frame_header.bits.layer == 3) {
-            count = 384;
-        } else if (frame_header.bits.layer == 2) {
-            count = 1152;
-        } else if (frame_header.bits.layer == 1) {
-            count = 1152;
+    return &decoder;
+}
+
+// 解码器在第一帧给出的 PCM 格式
+struct Mp3PcmFormat {
+    long rate = 0;
+    int channels = 0;
+    int encoding = 0;
+};
+
+// 以 feed 方式解码: next_input(in, in_size) 取下一段输入, 没有更多输入时返回 false,
+// 解码出的 PCM 依次交给 output(data, size). gapless 为 true 时由 mpg123 按 LAME 头去掉首尾补齐的样本
+template <typename Input, typename Output>
+static int feed_decode(Mpg123Decoder* decoder, bool gapless, Input next_input, Output output,
+                       Mp3PcmFormat& format) {
+    mpg123_handle* mh = decoder->handle;
+    mpg123_param(mh, gapless ? MPG123_ADD_FLAGS : MPG123_REMOVE_FLAGS, MPG123_GAPLESS, 0);
+    if (mpg123_open_feed(mh) != MPG123_OK) {
+        LOG(ERROR) << "mpg123_open_feed failed: " << mpg123_strerror(mh);
+        return -1;
+    }
+
+    int ret = MPG123_NEED_MORE;
+    while (true) {
+        // 只有解码器要求更多输入时才送入下一段, 否则继续取出已送入数据的解码结果
+        const unsigned char* in = nullptr;
+        size_t in_size = 0;
+        if (ret == MPG123_NEED_MORE && !next_input(in, in_size)) {
+            break;
         }
+        size_t done = 0;
+        ret = mpg123_decode(mh, in, in_size, decoder->buffer.get(), MP3_DECODE_OUTPUT_SIZE, &done);
+        if (ret == MPG123_NEW_FORMAT) {
+            mpg123_getformat(mh, &format.rate, &format.channels, &format.encoding);
+        }
+        if (done > 0) {
+            output(decoder->buffer.get(), done);
+        }
+        if (ret == MPG123_ERR || ret == MPG123_DONE) {
+            break;
+        }
+    }
+
+    if (ret == MPG123_ERR) {
+        LOG(ERROR) << "mpg123_decode failed: " << mpg123_strerror(mh);
+    }
+    mpg123_close(mh);
+    return ret == MPG123_ERR ? -1 : 0;
+}
+
+int Mp3Parser::dump_data() {
+    size_t threads = decode_threads_ == 0 ? std::thread::hardware_concurrency() : decode_threads_;
+    // 各线程直接读取 data_, 流式读取时只能串行解码
+    if (threads > 1 && data_ != nullptr && frame_index_.size() >= 2 * MP3_DECODE_SEGMENT_FRAMES) {
+        return dump_data_parallel(threads);
     }
 
-    return count;
+    std::string output_file_path = get_output_path() + ".pcm";
+    Mpg123Decoder* decoder = thread_decoder();
+    if (decoder == nullptr) {
+        return -1;
+    }
+
+    // 文件已在内存 (或流式窗口) 中, 以 feed 方式交给解码器, 不再由 mpg123 重新打开读取
+    std::ofstream out(output_file_path.c_str(), std::ios::binary);
+    size_t chunk_size = std::min<size_t>(MP3_DECODE_INPUT_SIZE, window_capacity());
+    size_t pos = 0;
+    Mp3PcmFormat format;
+    int ret = feed_decode(decoder, true, [this, chunk_size, &pos](const unsigned char*& in, size_t& in_size) {
+        if (pos >= data_size_) {
+            return false;
+        }
+        in_size = std::min(chunk_size, data_size_ - pos);
+        in = fetch(pos, in_size);
+        pos += in_size;
+        return in != nullptr;
+    }, [&out](const unsigned char* data, size_t size) {
+        out.write(reinterpret_cast<const char *>(data), size);
+    }, format);
+
+    add_bytes_written(out);
+    out.close();
+    if (ret < 0) {
+        return -1;
+    }
+    if (format.channels == 0) {
+        LOG(ERROR) << "Failed to get audio format!";
+        return -1;
+    }
+    MFP_LOG(INFO) << "Sample rate: " << format.rate << ", Channels: " << format.channels
+        << ", encoding: " << format.encoding;
+    return 0;
 }
 
-int get_frame_data_size(const FrameHeaderUnion& frame_header) {
-    int data_size = 0;
-    int sample_count = get_sample_count_per_frame(frame_header);
-    int bitrate = get_bit_rate(frame_header) * 1000;
-    int sample_rate = get_sample_rate(frame_header);
-    int padding = frame_header.bits.padding;
-    if (frame_header.bits.layer == 3) {
-        data_size = sample_count * bitrate / 8 / sample_rate + padding*4;
+struct Mp3DecodeSegment {
+    uint64_t first_frame = 0;
+    uint64_t end_frame = 0;
+    std::vector<unsigned char> pcm;
+    Mp3PcmFormat format;
+    int ret = 0;
+};
+
+int Mp3Parser::dump_data_parallel(size_t threads) {
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    std::string output_file_path = get_output_path() + ".pcm";
+    uint64_t frame_count = frame_index_.size();
+    size_t segment_count = (frame_count + MP3_DECODE_SEGMENT_FRAMES - 1) / MP3_DECODE_SEGMENT_FRAMES;
+    threads = std::min(threads, segment_count);
+    Mp3FrameInfo last_frame;
+    frame_index_.frame(frame_count - 1, last_frame);
+    size_t audio_end = std::min<size_t>(last_frame.offset + last_frame.size, data_size_);
+    uint32_t sample_count = get_sample_count_per_frame(frame_runs_[0].header);
+
+    // 各段关闭 gapless 解码, 再按 LAME 头自行去掉首尾补齐的样本, 结果与串行解码一致:
+    // 开头去掉 encoder delay + 解码器延迟, 结尾去掉 padding - 解码器延迟
+    bool gapless = vbr_header_.encoder[0] != '\0';
+    uint64_t skip_samples = gapless ? vbr_header_.encoder_delay + MP3_DECODER_DELAY : 0;
+    uint64_t trim_samples = gapless && vbr_header_.encoder_padding > MP3_DECODER_DELAY
+            ? vbr_header_.encoder_padding - MP3_DECODER_DELAY : 0;
+
+    auto decode_segment = [this, audio_end](Mp3DecodeSegment& segment) {
+        MFP_TRACE_SCOPE("decode_segment");
+        Mpg123Decoder* decoder = thread_decoder();
+        if (decoder == nullptr) {
+            segment.ret = -1;
+            return;
+        }
+        // 从前几帧开始解码, 段首帧引用的 bit reservoir 数据和重叠相加的前一帧都已解码过
+        uint64_t start_frame = segment.first_frame - std::min<uint64_t>(segment.first_frame, MP3_DECODE_OVERLAP_FRAMES);
+        Mp3FrameInfo frame;
+        frame_index_.frame(start_frame, frame);
+        size_t pos = frame.offset;
+        size_t end = audio_end;
+        if (segment.end_frame < frame_index_.size()) {
+            frame_index_.frame(segment.end_frame, frame);
+            end = frame.offset;
+        }
+        segment.pcm.clear();
+        segment.ret = feed_decode(decoder, false, [this, &pos, end](const unsigned char*& in, size_t& in_size) {
+            if (pos >= end) {
+                return false;
+            }
+            in_size = std::min<size_t>(MP3_DECODE_INPUT_SIZE, end - pos);
+            in = data_ + pos;
+            pos += in_size;
+            return true;
+        }, [&segment](const unsigned char* data, size_t size) {
+            segment.pcm.insert(segment.pcm.end(), data, data + size);
+        }, segment.format);
+    };
+
+    std::ofstream out(output_file_path.c_str(), std::ios::binary);
+    std::unique_ptr<ThreadPool> local_pool;
+    ThreadPool* pool = decode_pool_;
+    if (pool == nullptr) {
+        local_pool = std::make_unique<ThreadPool>(threads);
+        pool = local_pool.get();
     }
-    if (frame_header.bits.layer == 1 || frame_header.bits.layer == 2) {
-        data_size =  sample_count * bitrate / 8 / sample_rate + padding;
+    TaskGroup group(*pool);
+    std::vector<Mp3DecodeSegment> segments(threads);
+    Mp3PcmFormat format;
+    int ret = 0;
+    // 每轮解码 threads 段, 按顺序写出后再开始下一轮, 内存中最多保留 threads 段的 PCM
+    for (size_t first = 0; first < segment_count && ret == 0; first += threads) {
+        size_t count = std::min(threads, segment_count - first);
+        for (size_t i = 0; i < count; ++i) {
+            Mp3DecodeSegment& segment = segments[i];
+            segment.first_frame = (first + i) * MP3_DECODE_SEGMENT_FRAMES;
+            segment.end_frame = std::min<uint64_t>(segment.first_frame + MP3_DECODE_SEGMENT_FRAMES, frame_count);
+            group.submit([&decode_segment, &segment] {
+                decode_segment(segment);
+            });
+        }
+        group.wait();
+
+        for (size_t i = 0; i < count; ++i) {
+            Mp3DecodeSegment& segment = segments[i];
+            if (segment.ret < 0 || segment.format.channels == 0) {
+                LOG(ERROR) << "decode segment from frame " << segment.first_frame << " failed";
+                ret = -1;
+                break;
+            }
+            if (format.channels == 0) {
+                format = segment.format;
+            } else if (segment.format.rate != format.rate || segment.format.channels != format.channels
+                       || segment.format.encoding != format.encoding) {
+                LOG(ERROR) << "PCM format changed at frame " << segment.first_frame;
+                ret = -1;
+                break;
+            }
+
+            // 只保留本段各帧的输出, 丢掉前面多解码的帧. 第一段没有多解码的帧, 其中的 Xing/Info 帧也不输出 PCM
+            size_t sample_bytes = static_cast<size_t>(format.channels) * mpg123_encsize(format.encoding);
+            size_t begin = 0;
+            size_t end = segment.pcm.size();
+            if (segment.first_frame > 0) {
+                size_t keep = (segment.end_frame - segment.first_frame) * sample_count * sample_bytes;
+                begin = end > keep ? end - keep : 0;
+            } else {
+                begin = std::min<size_t>(end, skip_samples * sample_bytes);
+            }
+            if (segment.end_frame == frame_count) {
+                end -= std::min<size_t>(end - begin, trim_samples * sample_bytes);
+            }
+            out.write(reinterpret_cast<const char *>(segment.pcm.data() + begin), end - begin);
+        }
+    }
+
+    add_bytes_written(out);
+    out.close();
+    if (ret == 0) {
+        MFP_LOG(INFO) << "Sample rate: " << format.rate << ", Channels: " << format.channels
+            << ", encoding: " << format.encoding << ", " << segment_count << " segments on " << threads << " threads";
     }
-    return data_size;
+    return ret;
 }
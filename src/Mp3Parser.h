@@ -10,33 +10,37 @@
 #ifndef MEDIAFORMATPARSER_MP3PARSER_H
 #define MEDIAFORMATPARSER_MP3PARSER_H
 
+#include <cstdint>
+#include <string>
 #include <vector>
 
+#include "Id3v2.h"
+#include "Mp3Frame.h"
+#include "Mp3FrameIndex.h"
 #include "Parser.h"
 
-union FrameHeaderUnion {
-    uint32_t raw; // 原始4字节数据
-
-    struct {
-        unsigned int sync1:8; //同步信息 1
-
-        unsigned int error_protection:1; //CRC 校验
-        unsigned int layer:2; //层
-        unsigned int version:2; //版本
-        unsigned int sync2:3; //同步信息 2
-
-        unsigned int extension:1; //私有位
-        unsigned int padding:1; //填充空白字
-        unsigned int sample_rate_index:2; //采样率索引
-        unsigned int bit_rate_index:4; //位率索引
-
-        unsigned int emphasis:2; //强调方式
-        unsigned int original:1; //原始媒体
-        unsigned int copyright:1; //版权标志
-        unsigned int mode_extension:2; //扩展模式,仅用于联合立体声
-        unsigned int channel_mode:2; //声道模式
-    } bits;
-};
+#define ID3V1_SIZE 128
+// probe 时寻找第一个音频帧的最大范围
+#define PROBE_SYNC_RANGE (64 * 1024)
+// 没有 VBR 头时 probe 在文件中均匀取的抽样点数, 每个抽样点向后查找帧的范围和连续读取的帧数
+#define PROBE_SAMPLE_COUNT 16
+#define PROBE_SAMPLE_RANGE (8 * 1024)
+#define PROBE_SAMPLE_FRAMES 8
+// dump_data 每次交给解码器的输入字节数和 PCM 输出缓冲区大小
+#define MP3_DECODE_INPUT_SIZE (256 * 1024)
+#define MP3_DECODE_OUTPUT_SIZE (1024 * 1024)
+// 并行解码时每段的帧数 (44.1 kHz 约 52 秒), 以及每段向前多解码用于填充 bit reservoir 的帧数
+#define MP3_DECODE_SEGMENT_FRAMES 2000
+#define MP3_DECODE_OVERLAP_FRAMES 10
+// 并行扫描帧头时每段的最小字节数, 以及各段起点需要连续校验的帧数
+#define MP3_SCAN_MIN_RANGE (4 * 1024 * 1024)
+#define MP3_SCAN_CHAIN_FRAMES 4
+// mpg123 gapless 处理中解码器自身的延迟样本数
+#define MP3_DECODER_DELAY 529
+// 解析 APIC 帧时先读取的负载字节数, 需要容纳 MIME 类型和描述
+#define ID3V2_PICTURE_PREFIX_SIZE 1024
+#define XING_TOC_SIZE 100
+#define LAME_ENCODER_SIZE 9
 
 struct Id3v1 {
     char id[3];
@@ -48,52 +52,144 @@ struct Id3v1 {
     uint8_t genre;
 };
 
-struct Id3v2Header {
-    char id[3];
-    uint8_t version[2];
-    uint8_t flags;
-    uint32_t size;
+// 第一个帧负载中的 VBR 信息头
+enum VbrHeaderType {
+    VBR_HEADER_NONE,
+    VBR_HEADER_XING,  // "Xing", VBR
+    VBR_HEADER_INFO,  // "Info", LAME 为 CBR 文件写入, 结构与 Xing 相同
+    VBR_HEADER_VBRI,  // Fraunhofer 编码器
 };
 
-struct Id3v2ExtendedHeader {
-    uint32_t header_size;
-    uint16_t flags;
-    uint32_t padding_size;
+struct VbrHeader {
+    VbrHeaderType type = VBR_HEADER_NONE;
+    size_t offset = 0;        // 所在帧的文件偏移
+    uint32_t frames = 0;      // 音频帧数, 不含此头所在的帧; 0 表示未给出
+    uint32_t bytes = 0;       // 音频数据字节数; 0 表示未给出
+    uint32_t quality = 0;
+    // Xing TOC: toc[i] * bytes / 256 为第 i% 时长对应的字节位置
+    bool has_toc = false;
+    uint8_t toc[XING_TOC_SIZE] = {};
+    // VBRI TOC: 每项为 vbri_frames_per_entry 帧的字节数
+    std::vector<uint32_t> vbri_toc;
+    uint16_t vbri_frames_per_entry = 0;
+    uint16_t vbri_delay = 0;
+    // LAME 扩展, encoder 为空表示没有
+    char encoder[LAME_ENCODER_SIZE + 1] = {};
+    uint16_t encoder_delay = 0;    // 起始处编码器插入的样本数
+    uint16_t encoder_padding = 0;  // 末尾补齐的样本数
 };
 
-struct Id3v2FrameHeader {
-    char frame_id[4];
-    uint32_t size;
-    uint16_t flags;
+// 帧头完全相同的连续帧, CBR 文件通常只有少数几段
+struct Mp3FrameRun {
+    FrameHeaderUnion header;
+    uint64_t start_frame;   // 第一帧的序号, 从 0 开始
+    uint64_t count;
+    uint64_t start_offset;  // 第一帧的文件偏移
 };
 
-int get_sample_rate(const FrameHeaderUnion& frame_header);
-int get_bit_rate(const FrameHeaderUnion& frame_header);
-int get_sample_count_per_frame(const FrameHeaderUnion& frame_header);
-int get_frame_data_size(const FrameHeaderUnion& frame_header);
-
 class Mp3Parser: public Parser {
 public:
     Mp3Parser(const std::string& file_path);
     ~Mp3Parser();
 
+    // parse()/probe() 后有效
+    const VbrHeader& vbr_header() const { return vbr_header_; }
+    // parse() 时额外建立逐帧索引 (约 4 字节/帧), 用于精确的 frame_at/seek_to_time.
+    // 默认关闭, 只保留帧头 run, 内存不随帧数增长; 分段并行解码依赖帧索引, decode_threads 大于 1 时总会建立
+    void set_build_frame_index(bool build_frame_index);
+    // 建立了帧索引的 parse() 后有效
+    const Mp3FrameIndex& frame_index() const { return frame_index_; }
+    const std::vector<Mp3FrameRun>& frame_runs() const { return frame_runs_; }
+    uint64_t frame_count() const { return frame_count_; }
+
+    // ID3v2 标签的版本 (2-4), 没有标签时为 0; 以下均在 parse()/probe() 后有效
+    int id3v2_version() const { return has_id3v2_ ? id3v2_header.version[0] : 0; }
+    const std::vector<Id3v2FrameHeader>& id3v2_frames() const { return id3v2_frame_headers; }
+    // 读取帧负载并去除 unsynchronisation, 压缩或加密的帧返回 -1
+    int read_id3v2_frame(const Id3v2FrameHeader& frame, std::vector<unsigned char>& data);
+    // 将文本帧 (T***, COMM) 解码为 UTF-8, 其他帧返回 -1
+    int id3v2_text(const Id3v2FrameHeader& frame, std::string& text);
+    // 解析 APIC/PIC 帧, 只读取图像数据之前的部分, 图像数据以文件中的位置给出
+    int id3v2_picture(const Id3v2FrameHeader& frame, Id3v2Picture& picture);
+    // ID3v2 中的全部图片, 描述为图片类型和说明
+    int attachments(std::vector<Attachment>& out) override;
+
+    // 包含文件偏移 offset 的帧. 建立了帧索引时精确查找;
+    // 否则 (包括只 probe 过) 从 offset 向后对齐到第一个有效帧头, info.exact 为 false. 找不到时返回 -1
+    int frame_at(uint64_t offset, Mp3FrameInfo& info);
+    // 包含时刻 ms 的帧. 建立了帧索引时精确查找;
+    // 否则 (包括只 probe 过) 按 Xing/VBRI TOC (没有时按平均码率) 估算偏移再对齐到帧头, info.exact 为 false
+    int seek_to_time(uint64_t ms, Mp3FrameInfo& info);
+
 private:
     int custom_parse() override;
     int dump_info() override;
     int dump_data() override;
+    int custom_probe() override;
+    int dump_report(ReportWriter& writer) override;
 
     void parse_id3tag_v2_header();
+    // 解析 [pos, end) 内的帧头; buffered 为 true 时位置为 id3v2_buffer_ 中的偏移
+    void parse_id3v2_frames(size_t pos, size_t end, int version, bool buffered);
+    const unsigned char* id3v2_bytes(bool buffered, size_t pos, size_t len);
+    // 将文件中 [pos, pos + len) 按窗口大小分段追加到 out, 超出文件时返回 -1
+    int read_range(size_t pos, size_t len, std::vector<unsigned char>& out);
     void parse_frame_headers();
+    // 把文件按字节分段, 各段先对齐到连续 MP3_SCAN_CHAIN_FRAMES 帧的同步链再扫描到段尾,
+    // 合并时用串行扫描的规则校验衔接, 结果与串行扫描相同. 只在整个文件位于 data_ 时使用;
+    // 第一个同步字之后不足两段时返回 -1, 不改变 pos_
+    int parse_frame_headers_parallel(size_t threads);
+    // 从 pos 开始按串行扫描的规则前进, 直到 pos >= end 或接受了 max_frames 帧, 帧偏移追加到 frames,
+    // 返回停止时的位置. 只读取 data_, 可以在多个线程中同时调用
+    size_t walk_frames(size_t pos, size_t end, std::vector<uint64_t>& frames, size_t max_frames = SIZE_MAX) const;
+    // [pos, end) 内第一个起始的连续 MP3_SCAN_CHAIN_FRAMES 帧的位置, 没有时返回 end
+    size_t find_sync_chain(size_t pos, size_t end) const;
+    // 读取 data_ 中 pos 处的帧头, 超出文件的部分为 0
+    FrameHeaderUnion header_at(size_t pos) const;
+    // 与上一段帧头相同时只增加计数, 否则开始新的一段
+    void add_frame(size_t pos, const FrameHeaderUnion& frame_header);
     void parse_id3tag_v1();
+    void parse_id3tag_v1_at(size_t pos);
+    // 解析 frame_pos 处帧中的 Xing/Info/VBRI 头, 没有时返回 -1
+    int parse_vbr_header(size_t frame_pos);
+    int parse_xing_header(size_t pos, size_t frame_end);
+    int parse_vbri_header(size_t pos, size_t frame_end);
+    // 由 VBR 头的帧数得出时长 (秒), 没有帧数时返回 0
+    double vbr_duration(const FrameHeaderUnion& first_frame) const;
+    // 在 [start, end) 内均匀取 PROBE_SAMPLE_COUNT 个抽样点, 每处连续读取若干帧, 返回码率的平均值 (kbps)
+    double sample_bit_rate(size_t start, size_t end, const FrameHeaderUnion& first_frame);
+    // pos 处是否为与 first_frame 参数一致且后面紧跟下一帧的帧头
+    bool is_chained_frame(size_t pos, size_t end, const FrameHeaderUnion& first_frame);
+    // 返回 [pos, end) 内下一个帧同步字或 3 字节标记的候选位置, 没有时返回 end
+    size_t find_sync(size_t pos, size_t end);
+    size_t find_marker(size_t pos, size_t end, const char* marker);
+    // 按帧索引分段, 各段在线程池中用各自的解码句柄解码后按顺序写出
+    int dump_data_parallel(size_t threads);
+    // 由 TOC 或平均码率估算 ms 对应的文件偏移
+    uint64_t estimate_offset(uint64_t ms) const;
+    // parse() 后由全部帧头 run 得出时长和平均码率, 没有帧索引时 frame_at/seek_to_time 以此估算
+    void fill_stream_info();
+    // 从 pos 起在 PROBE_SAMPLE_RANGE 内对齐到与第一帧参数一致的帧头, 没有时返回 -1
+    int align_frame(size_t pos, Mp3FrameInfo& info);
 
 private:
+    size_t first_frame_pos_ = 0;
     size_t last_frame_pos_ = 0;
-    std::vector<FrameHeaderUnion> frame_headers;
+    size_t audio_end_ = 0;  // 音频数据结尾, 不含 ID3v1
+    VbrHeader vbr_header_;
+    std::vector<Mp3FrameRun> frame_runs_;
+    uint64_t frame_count_ = 0;
+    Mp3FrameIndex frame_index_;
+    bool build_frame_index_ = false;
+    bool index_frames_ = false;  // 本次 parse() 是否建立帧索引
     Id3v1 id3v1;
-    Id3v2Header id3v2_header;
-    Id3v2ExtendedHeader id3v2_extended_header;
-    bool has_extended_header_;
+    bool has_id3v2_ = false;
+    Id3v2Header id3v2_header{};
+    Id3v2ExtendedHeader id3v2_extended_header{};
+    bool has_extended_header_ = false;
     std::vector<Id3v2FrameHeader> id3v2_frame_headers;
+    // v2.2/2.3 整个标签经过 unsynchronisation 时, 重同步后的标签内容
+    std::vector<unsigned char> id3v2_buffer_;
     int version_ = -1;
     int layer_ = -1;
 };
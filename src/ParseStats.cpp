@@ -0,0 +1,64 @@
+//
+// 解析计时和计数
+//
+
+#include "ParseStats.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef MFP_COUNT_ALLOCATIONS
+
+static thread_local uint64_t t_allocations = 0;
+
+// 数组和 nothrow 版本的默认实现都会调用这里
+void* operator new(std::size_t size) {
+    t_allocations++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    free(p);
+}
+
+uint64_t thread_allocation_count() {
+    return t_allocations;
+}
+
+#else
+
+uint64_t thread_allocation_count() {
+    return 0;
+}
+
+#endif
+
+static FixedValue to_ms(uint64_t ns) {
+    return fixed_value(ns / 1e6, 3);
+}
+
+TextWriter& operator<<(TextWriter &out, const ParseStats &s) {
+    out << "open_ms=" << to_ms(s.open_ns)
+        << " parse_ms=" << to_ms(s.parse_ns)
+        << " dump_info_ms=" << to_ms(s.dump_info_ns)
+        << " report_ms=" << to_ms(s.report_ns)
+        << " dump_data_ms=" << to_ms(s.dump_data_ns)
+        << " total_ms=" << to_ms(s.total_ns)
+        << " bytes_read=" << s.bytes_read
+        << " bytes_written=" << s.bytes_written
+        << ' ' << s.item_unit << '=' << s.items
+        << " allocations=" << s.allocations;
+    return out;
+}
+
+std::ostream& operator<<(std::ostream &out, const ParseStats &s) {
+    return write_text(out, s);
+}
@@ -0,0 +1,48 @@
+//
+// 单个文件解析过程的计时和计数.
+// Parser::parse() 按阶段 (open_file / custom_parse / dump_info / 报告 / dump_data) 记录单调时钟耗时,
+// 并统计读入/写出字节数和解析出的帧/tag/atom/chunk 数, 可以输出为一行 key=value 摘要.
+// 堆分配次数需要以 MFP_COUNT_ALLOCATIONS 编译, 此时库会替换全局 operator new
+//
+
+#ifndef MEDIAFORMATPARSER_PARSESTATS_H
+#define MEDIAFORMATPARSER_PARSESTATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#include "TextWriter.h"
+
+struct ParseStats {
+    uint64_t open_ns = 0;
+    uint64_t parse_ns = 0;
+    uint64_t dump_info_ns = 0;
+    uint64_t report_ns = 0;
+    uint64_t dump_data_ns = 0;
+    uint64_t total_ns = 0;
+
+    // mmap/整文件读入时为文件大小, 流式读取时为实际 pread 的字节数
+    uint64_t bytes_read = 0;
+    // .txt, 报告和导出数据的总字节数
+    uint64_t bytes_written = 0;
+    // parse() 期间调用线程的堆分配次数, 未开启 MFP_COUNT_ALLOCATIONS 时为 0
+    uint64_t allocations = 0;
+    // 解析出的条目数, 单位由各解析器给出 (frames, tags, atoms, chunks)
+    uint64_t items = 0;
+    const char* item_unit = "items";
+};
+
+inline uint64_t monotonic_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 当前线程累计的堆分配次数
+uint64_t thread_allocation_count();
+
+TextWriter& operator<<(TextWriter &out, const ParseStats &s);
+std::ostream& operator<<(std::ostream &out, const ParseStats &s);
+
+
+#endif //MEDIAFORMATPARSER_PARSESTATS_H
@@ -4,8 +4,20 @@
 
 #include "Parser.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <utility>
-#include "logger/easylogging++.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include "Tracer.h"
+#include "ParserLog.h"
 #include "utils.h"
 
 Parser::Parser(const std::string& filePath): file_path_(std::move(filePath)) {
@@ -13,56 +25,465 @@ Parser::Parser(const std::string& filePath): file_path_(std::move(filePath)) {
 }
 
 Parser::~Parser() {
-    if (data_) {
-        delete[] data_;
+    release_data();
+    if (input_fd_ >= 0) {
+        ::close(input_fd_);
     }
 }
 
 int Parser::parse() {
-    if (open_file() < 0) {
+    MFP_TRACE_SCOPE("parse", file_path_);
+    stats_ = ParseStats();
+    uint64_t allocations = thread_allocation_count();
+    uint64_t start = monotonic_ns();
+
+    int ret = parse_phases();
+
+    stats_.total_ns = monotonic_ns() - start;
+    stats_.allocations = thread_allocation_count() - allocations;
+    if (source_) {
+        stats_.bytes_read = source_->bytes_read();
+    }
+    if (log_stats_) {
+        LOG(INFO) << file_path_ << ": " << stats_;
+    }
+    return ret;
+}
+
+int Parser::parse_phases() {
+    uint64_t t = monotonic_ns();
+    // 返回上一个时间点到现在的耗时
+    auto lap = [&t]() {
+        uint64_t now = monotonic_ns();
+        uint64_t elapsed = now - t;
+        t = now;
+        return elapsed;
+    };
+
+    int ret = open_file();
+    stats_.open_ns = lap();
+    if (ret < 0) {
         return -1;
     }
 
-    if (custom_parse() < 0) {
+    {
+        MFP_TRACE_SCOPE("custom_parse");
+        ret = custom_parse();
+    }
+    stats_.parse_ns = lap();
+    if (ret < 0) {
         return -2;
     }
 
-    dump_info();
-    dump_data();
+    {
+        MFP_TRACE_SCOPE("dump_info");
+        dump_info();
+    }
+    stats_.dump_info_ns = lap();
+    if (report_format_ != REPORT_NONE) {
+        write_report();
+        stats_.report_ns = lap();
+    }
+    {
+        MFP_TRACE_SCOPE("dump_data");
+        dump_data();
+    }
+    stats_.dump_data_ns = lap();
     return 0;
 }
 
+int Parser::probe() {
+    MFP_TRACE_SCOPE("probe", file_path_);
+    stats_ = ParseStats();
+    int ret = 0;
+    if (open_stream(PROBE_WINDOW) < 0) {
+        ret = -1;
+    } else if (custom_probe() < 0) {
+        ret = -2;
+    }
+
+    // probe 只统计读取的字节数
+    if (source_) {
+        stats_.bytes_read = source_->bytes_read();
+    }
+    return ret;
+}
+
+void Parser::set_use_mmap(bool use_mmap) {
+    use_mmap_ = use_mmap;
+}
+
+void Parser::set_stream_window(size_t window_size) {
+    stream_window_ = window_size;
+}
+
+void Parser::set_report_format(ReportFormat format) {
+    report_format_ = format;
+}
+
+void Parser::set_log_stats(bool log_stats) {
+    log_stats_ = log_stats;
+}
+
+void Parser::set_decode_threads(size_t decode_threads) {
+    decode_threads_ = decode_threads;
+}
+
+void Parser::set_decode_pool(ThreadPool* decode_pool) {
+    decode_pool_ = decode_pool;
+}
+
+void Parser::set_scan_threads(size_t scan_threads) {
+    scan_threads_ = scan_threads;
+}
+
+void Parser::set_input(int fd, const unsigned char* head, size_t head_size) {
+    if (input_fd_ >= 0) {
+        ::close(input_fd_);
+    }
+    input_fd_ = fd;
+    input_head_.assign(head, head + head_size);
+}
+
+void Parser::set_output_name(const std::string& output_name) {
+    output_name_ = output_name;
+}
+
+int Parser::write_report() {
+    MFP_TRACE_SCOPE("write_report");
+    std::unique_ptr<ReportWriter> writer = create_report_writer(report_format_);
+    std::string file_path = get_output_path() + report_extension(report_format_);
+    if (writer->open(file_path) < 0) {
+        return -1;
+    }
+    int ret = dump_report(*writer);
+    stats_.bytes_written += writer->bytes_written();
+    if (ret < 0) {
+        writer->close();
+        return -2;
+    }
+    return writer->close();
+}
+
 int Parser::open_file() {
-    LOG(DEBUG) << __FUNCTION__;
+    MFP_TRACE_SCOPE("open_file");
+    MFP_LOG(DEBUG) << __FUNCTION__;
+
+    release_data();
+
+    if (stream_window_ > 0) {
+        return open_stream(stream_window_);
+    }
+
+    int ret = -1;
+    if (use_mmap_) {
+        ret = map_file();
+    }
+    if (ret < 0) {
+        ret = read_file();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    source_ = std::make_unique<MemoryByteSource>(data_, data_size_);
+    MFP_LOG(DEBUG) << "read data size: " << data_size_;
+    return 0;
+}
+
+int Parser::open_stream(size_t window_size) {
+    release_data();
+
+    std::unique_ptr<FileByteSource> source;
+    if (input_fd_ >= 0) {
+        source = std::make_unique<FileByteSource>(input_fd_, window_size, input_head_.data(), input_head_.size());
+    } else {
+        source = std::make_unique<FileByteSource>(file_path_, window_size);
+    }
+    if (!source->is_open()) {
+        return -1;
+    }
+    data_size_ = source->size();
+    source_ = std::move(source);
+    MFP_LOG(DEBUG) << "stream data size: " << data_size_ << ", window: " << window_size;
+    return 0;
+}
 
-    std::ifstream file(file_path_, std::ios::binary);
-    if (!file) {
+int Parser::open_input() {
+    if (input_fd_ >= 0) {
+        return input_fd_;
+    }
+    return ::open(file_path_.c_str(), O_RDONLY);
+}
+
+void Parser::close_input(int fd) {
+    if (fd >= 0 && fd != input_fd_) {
+        ::close(fd);
+    }
+}
+
+int Parser::map_file() {
+    int fd = open_input();
+    if (fd < 0) {
+        LOG(WARNING) << "open file " << file_path_ << " for mmap failed";
+        return -1;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        // 空文件无法 mmap, 交给 read_file 处理
+        close_input(fd);
+        return -2;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // 映射建立后即可关闭 fd
+    close_input(fd);
+    if (addr == MAP_FAILED) {
+        LOG(WARNING) << "mmap file " << file_path_ << " failed, fall back to read";
+        return -3;
+    }
+
+    // 解析基本是顺序访问, 提示内核加大预读
+    madvise(addr, size, MADV_SEQUENTIAL);
+    madvise(addr, size, MADV_WILLNEED);
+
+    // 映射为只读, 子类只能读取 data_
+    data_ = static_cast<unsigned char *>(addr);
+    data_size_ = size;
+    mapped_ = true;
+    MFP_LOG(DEBUG) << "map file successfully";
+    return 0;
+}
+
+int Parser::read_file() {
+    int fd = open_input();
+    if (fd < 0) {
         LOG(ERROR) << "open file " << file_path_ << " failed";
         return -1;
     }
 
-    // TODO: 大文件读取优化
-    file.seekg(0, std::ios::end);
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    struct stat st{};
+    if (fstat(fd, &st) < 0) {
+        LOG(ERROR) << "stat file " << file_path_ << " failed";
+        close_input(fd);
+        return -1;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
 
     data_ = new(std::nothrow) unsigned char[size];
     if (!data_) {
         LOG(ERROR) << "alloc memory failed";
+        close_input(fd);
         return -2;
     }
-    if (file.read(reinterpret_cast<char *>(data_), size)) {
-        LOG(DEBUG) << "read file successfully";
-    } else {
+
+    // 识别格式时已读取的头部不再重复读取
+    size_t filled = std::min(size, input_head_.size());
+    memcpy(data_, input_head_.data(), filled);
+    while (filled < size) {
+        ssize_t n = pread(fd, data_ + filled, size - filled, static_cast<off_t>(filled));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        filled += n;
+    }
+    close_input(fd);
+    if (filled < size) {
         LOG(ERROR) << "read file failed";
+        delete[] data_;
+        data_ = nullptr;
         return -3;
     }
+    MFP_LOG(DEBUG) << "read file successfully";
     data_size_ = size;
-    LOG(DEBUG) << "read data size: " << data_size_;
-    file.close();
     return 0;
 }
 
+const unsigned char* Parser::refill(size_t pos, size_t len) {
+    if (!source_) {
+        return nullptr;
+    }
+    ByteWindow window = source_->load(pos, len);
+    if (window.data == nullptr) {
+        LOG(ERROR) << "fetch " << len << " bytes at " << pos << " failed";
+        return nullptr;
+    }
+    window_ = window;
+    return window_.data + (pos - window_.pos);
+}
+
+size_t Parser::scan_chunk_size() const {
+    if (!source_) {
+        return SCAN_CHUNK_SIZE;
+    }
+    return std::min<size_t>(SCAN_CHUNK_SIZE, source_->capacity());
+}
+
+size_t Parser::window_capacity() const {
+    return source_ ? source_->capacity() : 0;
+}
+
+int Parser::write_range(std::ostream& out, size_t pos, size_t len) {
+    if (!source_) {
+        return -1;
+    }
+    size_t chunk_size = source_->capacity();
+    while (len > 0) {
+        size_t n = std::min(len, chunk_size);
+        const unsigned char* p = fetch(pos, n);
+        if (p == nullptr) {
+            return -1;
+        }
+        out.write(reinterpret_cast<const char *>(p), n);
+        pos += n;
+        len -= n;
+    }
+    return out ? 0 : -1;
+}
+
+// 按 MIME 类型选择附件文件的扩展名
+static const char* attachment_extension(const std::string& mime) {
+    if (mime == "image/jpeg" || mime == "image/jpg") {
+        return ".jpg";
+    } else if (mime == "image/png") {
+        return ".png";
+    } else if (mime == "image/gif") {
+        return ".gif";
+    } else if (mime == "image/bmp") {
+        return ".bmp";
+    }
+    return ".bin";
+}
+
+int Parser::dump_attachments() {
+    MFP_TRACE_SCOPE("dump_attachments");
+    std::vector<Attachment> items;
+    if (attachments(items) < 0) {
+        return -1;
+    }
+    if (items.empty()) {
+        return 0;
+    }
+
+    int in_fd = open_input();
+    if (in_fd < 0) {
+        LOG(ERROR) << "open file " << file_path_ << " failed";
+        return -2;
+    }
+
+    int written = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+        const Attachment& item = items[i];
+        std::string file_path = get_output_path() + ".attachment" + std::to_string(i) + attachment_extension(item.mime);
+        int out_fd = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0) {
+            LOG(ERROR) << "open file " << file_path << " failed";
+            continue;
+        }
+
+        int ret = 0;
+        uint64_t length = item.length;
+        if (item.contiguous) {
+            ret = copy_range(in_fd, out_fd, item.offset, item.length);
+        } else {
+            length = item.data.size();
+            ret = ::write(out_fd, item.data.data(), length) == static_cast<ssize_t>(length) ? 0 : -1;
+        }
+        ::close(out_fd);
+        if (ret < 0) {
+            LOG(ERROR) << "write attachment " << file_path << " failed";
+            continue;
+        }
+        add_bytes_written(length);
+        written++;
+        MFP_LOG(DEBUG) << "write attachment " << file_path << ", " << item.mime << ", " << length << " bytes";
+    }
+    close_input(in_fd);
+    return written;
+}
+
+int Parser::copy_range(int in_fd, int out_fd, uint64_t pos, uint64_t len) {
+    if (pos > data_size_ || len > data_size_ - pos) {
+        return -1;
+    }
+
+#ifdef __linux__
+    // 优先在内核中复制, 文件系统或内核不支持时依次回退
+    off_t in_pos = static_cast<off_t>(pos);
+    bool copy_file_range_supported = true;
+    bool sendfile_supported = true;
+    while (len > 0 && (copy_file_range_supported || sendfile_supported)) {
+        ssize_t n;
+        if (copy_file_range_supported) {
+            n = copy_file_range(in_fd, &in_pos, out_fd, nullptr, len, 0);
+        } else {
+            n = sendfile(out_fd, in_fd, &in_pos, len);
+        }
+        if (n > 0) {
+            len -= n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+            if (copy_file_range_supported) {
+                copy_file_range_supported = false;
+            } else {
+                sendfile_supported = false;
+            }
+            continue;
+        }
+        return -1;
+    }
+    pos = static_cast<uint64_t>(in_pos);
+#endif
+
+    size_t chunk_size = window_capacity();
+    if (len > 0 && chunk_size == 0) {
+        return -1;
+    }
+    while (len > 0) {
+        size_t n = std::min<uint64_t>(len, chunk_size);
+        const unsigned char* p = fetch(pos, n);
+        if (p == nullptr || ::write(out_fd, p, n) != static_cast<ssize_t>(n)) {
+            return -1;
+        }
+        pos += n;
+        len -= n;
+    }
+    return 0;
+}
+
+void Parser::add_bytes_written(std::ostream& out) {
+    std::streamoff size = out.tellp();
+    if (size > 0) {
+        stats_.bytes_written += size;
+    }
+}
+
+void Parser::release_data() {
+    window_ = ByteWindow();
+    source_.reset();
+    if (data_) {
+        if (mapped_) {
+            munmap(data_, data_size_);
+        } else {
+            delete[] data_;
+        }
+    }
+    data_ = nullptr;
+    data_size_ = 0;
+    mapped_ = false;
+}
+
 std::string Parser::get_output_path() {
+    if (!output_name_.empty()) {
+        return get_output_dir() + output_name_;
+    }
     return get_output_dir() + get_filename_without_extension(file_path_);
 }
@@ -5,27 +5,179 @@
 #ifndef MEDIAFORMATPARSER_PARSER_H
 #define MEDIAFORMATPARSER_PARSER_H
 
+#include <algorithm>
+#include <memory>
+#include <ostream>
 #include <string>
+#include <vector>
+
+#include "ByteSource.h"
+#include "ParseStats.h"
+#include "ReportWriter.h"
+
+class ThreadPool;
+
+// probe 使用的读取窗口, 只需要容纳单个头部结构
+#define PROBE_WINDOW (16 * 1024)
+// scan_for 每次交给查找函数的最大字节数
+#define SCAN_CHUNK_SIZE (64 * 1024)
+
+// probe 得到的流信息, 未知字段保持为 0
+struct StreamInfo {
+    std::string format;
+    bool has_audio = false;
+    bool has_video = false;
+    uint32_t sample_rate = 0;
+    uint16_t channels = 0;
+    uint16_t bits_per_sample = 0;
+    uint32_t bit_rate = 0; // kbps
+    uint32_t width = 0;
+    uint32_t height = 0;
+    double duration = 0; // 秒
+};
+
+// 内嵌附件 (封面图片等), 只记录数据在输入文件中的位置, 不复制负载
+struct Attachment {
+    std::string mime;
+    std::string description;  // UTF-8, 可以为空
+    uint64_t offset = 0;      // 附件数据的文件偏移
+    uint64_t length = 0;
+    // false 表示文件中不是原样的字节 (如经过 ID3 unsynchronisation), offset 无效,
+    // 还原后的数据放在 data 中
+    bool contiguous = true;
+    std::vector<unsigned char> data;
+};
 
 class Parser {
 public:
     explicit Parser(const std::string& filePath);
     virtual ~Parser();
     int parse();
+    // 只读取流元数据所需的头部区域, 不解析也不导出负载
+    int probe();
+    const StreamInfo& stream_info() const { return stream_info_; }
+    // 默认使用 mmap 读取文件, 关闭后回退为整文件读入堆内存
+    void set_use_mmap(bool use_mmap);
+    // 设置为非 0 时改为流式读取, 内存占用不超过窗口大小
+    void set_stream_window(size_t window_size);
+    // parse() 时在 .txt 之外再输出一份 JSON lines 或二进制报告
+    void set_report_format(ReportFormat format);
+    // 最近一次 parse() 的各阶段耗时和计数
+    const ParseStats& stats() const { return stats_; }
+    // parse() 结束后以 INFO 级别输出一行统计摘要
+    void set_log_stats(bool log_stats);
+    // dump_data 可使用的线程数, 0 为 CPU 核数, 默认 1; 目前只有 MP3 解码会分段并行
+    void set_decode_threads(size_t decode_threads);
+    // 并行解码使用的线程池, 由调用方持有且在解析器使用期间一直有效. 批量解析时各文件共用,
+    // 解码线程及其中的解码器句柄在文件之间复用; 未设置时每次解码临时创建 decode_threads 个线程
+    void set_decode_pool(ThreadPool* decode_pool);
+    // custom_parse 可使用的线程数, 0 为 CPU 核数, 默认 1; 目前只有 MP3 帧头扫描会分段并行
+    void set_scan_threads(size_t scan_threads);
+    // 交给解析器已打开的输入文件 (由 ParserFactory 识别格式时打开) 和已读取的文件头部,
+    // 之后 mmap/读入/流式读取都直接使用该 fd, 不再按路径重新打开. fd 由解析器负责关闭
+    void set_input(int fd, const unsigned char* head, size_t head_size);
+    // 输出文件名 (不含目录和扩展名), 默认为输入文件名去掉扩展名
+    void set_output_name(const std::string& output_name);
+    // probe() 或 parse() 之后列出内嵌附件, 只读取描述附件所需的头部. 不支持附件的格式返回空列表
+    virtual int attachments(std::vector<Attachment>& /*out*/) { return 0; }
+    // probe() 或 parse() 之后将附件逐个写到输出目录, 返回写出的个数.
+    // 位于文件中的附件通过 copy_file_range/sendfile 在内核中复制, 只读取附件本身的字节
+    int dump_attachments();
 
 protected:
     virtual int custom_parse() = 0;
     virtual int dump_info() = 0;
     virtual int dump_data() = 0;
+    virtual int custom_probe() = 0;
+    virtual int dump_report(ReportWriter& writer) = 0;
     int open_file();
     std::string get_output_path();
 
+    // 取得 [pos, pos + len) 的只读视图, 指针在下一次 fetch 前有效.
+    // 超出文件末尾的部分按 0 填充, 超过窗口容量时返回 nullptr
+    const unsigned char* fetch(size_t pos, size_t len) {
+        if (pos >= window_.pos && pos + len <= window_.pos + window_.len) {
+            return window_.data + (pos - window_.pos);
+        }
+        return refill(pos, len);
+    }
+    // 读取失败时返回 0
+    uint8_t byte_at(size_t pos) {
+        const unsigned char* p = fetch(pos, 1);
+        return p ? *p : 0;
+    }
+    // 在 [pos, end) 内分段查找长度为 pattern_len 的候选, 返回第一个候选的位置, 没有时返回 end.
+    // finder(data, len) 返回段内第一个候选的偏移, 没有时返回 len; 相邻两段重叠 pattern_len - 1 字节
+    template <typename Finder>
+    size_t scan_for(size_t pos, size_t end, size_t pattern_len, Finder finder);
+    // 一次 fetch 能取得的最大字节数, mmap/堆内存模式下为整个文件
+    size_t window_capacity() const;
+    // 将 [pos, pos + len) 按窗口大小分段写出
+    int write_range(std::ostream& out, size_t pos, size_t len);
+    // 导出完成后记录输出文件的大小
+    void add_bytes_written(std::ostream& out);
+    void add_bytes_written(uint64_t bytes) { stats_.bytes_written += bytes; }
+
+private:
+    // 返回输入文件的 fd, 没有通过 set_input 传入时按路径打开, 用完后交给 close_input
+    int open_input();
+    void close_input(int fd);
+    int map_file();
+    int read_file();
+    int open_stream(size_t window_size);
+    void release_data();
+    int parse_phases();
+    size_t scan_chunk_size() const;
+    int write_report();
+    // 将输入文件的 [pos, pos + len) 追加到 out_fd, 内核复制不可用时回退为 fetch + write
+    int copy_range(int in_fd, int out_fd, uint64_t pos, uint64_t len);
+    const unsigned char* refill(size_t pos, size_t len);
+
 protected:
     std::string file_path_;
+    // 仅在 mmap/堆内存模式下指向整个文件, 流式读取时为 nullptr
     unsigned char *data_ = nullptr;
     size_t data_size_ = 0;
     size_t pos_ = 0;
+    StreamInfo stream_info_;
+    ParseStats stats_;
+    size_t decode_threads_ = 1;
+    ThreadPool* decode_pool_ = nullptr;
+    size_t scan_threads_ = 1;
+
+private:
+    bool use_mmap_ = true;
+    bool mapped_ = false;
+    size_t stream_window_ = 0;
+    std::string output_name_;
+    int input_fd_ = -1;
+    std::vector<unsigned char> input_head_;
+    ReportFormat report_format_ = REPORT_NONE;
+    bool log_stats_ = false;
+    std::unique_ptr<ByteSource> source_;
+    ByteWindow window_;
 };
 
+template <typename Finder>
+size_t Parser::scan_for(size_t pos, size_t end, size_t pattern_len, Finder finder) {
+    size_t chunk_size = std::max(scan_chunk_size(), pattern_len);
+    while (pos + pattern_len <= end) {
+        size_t n = std::min(end - pos, chunk_size);
+        const unsigned char* p = fetch(pos, n);
+        if (p == nullptr) {
+            break;
+        }
+        size_t offset = finder(p, n);
+        if (offset < n) {
+            return pos + offset;
+        }
+        if (pos + n >= end) {
+            break;
+        }
+        pos += n - (pattern_len - 1);
+    }
+    return end;
+}
+
 
 #endif //MEDIAFORMATPARSER_PARSER_H
@@ -0,0 +1,161 @@
+//
+// 格式识别与解析器工厂实现
+//
+
+#include "ParserFactory.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FlvParser.h"
+#include "M4aParser.h"
+#include "Mp3Parser.h"
+#include "WavParser.h"
+#include "ParserLog.h"
+
+ParserFactory& ParserFactory::instance() {
+    static ParserFactory factory;
+    return factory;
+}
+
+ParserFactory::ParserFactory() {
+    register_builtin_formats();
+}
+
+void ParserFactory::register_builtin_formats() {
+    register_format("wav", 0, RIFF_ID, [](const std::string& file_path) {
+        return std::make_unique<WavParser>(file_path);
+    }, [](const unsigned char* head, size_t size) {
+        return size >= HEAD_CHUNK_SIZE && memcmp(head + 8, WAVE_TAG, 4) == 0;
+    });
+
+    register_format("wav", 0, RF64_ID, [](const std::string& file_path) {
+        return std::make_unique<WavParser>(file_path);
+    }, [](const unsigned char* head, size_t size) {
+        return size >= HEAD_CHUNK_SIZE && memcmp(head + 8, WAVE_TAG, 4) == 0;
+    });
+
+    register_format("mp3", 0, "ID3", [](const std::string& file_path) {
+        return std::make_unique<Mp3Parser>(file_path);
+    });
+
+    // 没有 ID3v2 标签时文件直接以帧同步字 0xFFE 开始, 同时排除保留的 layer/码率/采样率取值
+    register_format("mp3", 0, "\xFF", [](const std::string& file_path) {
+        return std::make_unique<Mp3Parser>(file_path);
+    }, [](const unsigned char* head, size_t size) {
+        return size >= 3 && (head[1] & 0xe0) == 0xe0
+            && ((head[1] >> 1) & 0x03) != 0
+            && (head[2] >> 4) != 0x0f
+            && ((head[2] >> 2) & 0x03) != 0x03;
+    });
+
+    register_format("flv", 0, "FLV", [](const std::string& file_path) {
+        return std::make_unique<FlvParser>(file_path);
+    });
+
+    register_format("m4a", 4, TYPE_FTYP, [](const std::string& file_path) {
+        return std::make_unique<M4aParser>(file_path);
+    });
+}
+
+void ParserFactory::register_format(const std::string& name, size_t offset, const std::string& magic,
+                                    ParserCreator creator, FormatVerifier verifier) {
+    if (magic.empty() || offset + magic.size() > SNIFF_SIZE) {
+        LOG(ERROR) << "invalid magic for format " << name;
+        return;
+    }
+
+    int index = static_cast<int>(formats_.size());
+    formats_.push_back({name, offset, magic, std::move(creator), std::move(verifier)});
+
+    DispatchTable* table = nullptr;
+    for (auto& t: tables_) {
+        if (t.offset == offset) {
+            table = &t;
+            break;
+        }
+    }
+    if (table == nullptr) {
+        tables_.emplace_back();
+        table = &tables_.back();
+        table->offset = offset;
+    }
+    table->candidates[static_cast<unsigned char>(magic[0])].push_back(index);
+}
+
+int ParserFactory::match(const unsigned char* head, size_t size) const {
+    for (auto& table: tables_) {
+        if (table.offset >= size) {
+            continue;
+        }
+        for (int index: table.candidates[head[table.offset]]) {
+            const FormatEntry& format = formats_[index];
+            if (format.offset + format.magic.size() > size) {
+                continue;
+            }
+            if (memcmp(head + format.offset, format.magic.data(), format.magic.size()) != 0) {
+                continue;
+            }
+            if (format.verifier && !format.verifier(head, size)) {
+                continue;
+            }
+            return index;
+        }
+    }
+    return -1;
+}
+
+std::string ParserFactory::sniff(const unsigned char* head, size_t size) const {
+    int index = match(head, size);
+    return index < 0 ? "" : formats_[index].name;
+}
+
+std::vector<std::string> ParserFactory::format_names() const {
+    std::vector<std::string> names;
+    for (auto& format: formats_) {
+        if (std::find(names.begin(), names.end(), format.name) == names.end()) {
+            names.push_back(format.name);
+        }
+    }
+    return names;
+}
+
+std::unique_ptr<Parser> ParserFactory::create(const std::string& file_path, std::string* format_name) const {
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(ERROR) << "open file " << file_path << " failed";
+        return nullptr;
+    }
+
+    unsigned char head[SNIFF_SIZE];
+    ssize_t n = pread(fd, head, sizeof(head), 0);
+    if (n <= 0) {
+        LOG(ERROR) << "read file " << file_path << " failed";
+        ::close(fd);
+        return nullptr;
+    }
+    std::unique_ptr<Parser> parser = create(file_path, head, static_cast<size_t>(n), format_name);
+    if (!parser) {
+        ::close(fd);
+        return nullptr;
+    }
+    // 解析器直接使用已打开的 fd 和已读取的头部, 不再重新打开文件
+    parser->set_input(fd, head, static_cast<size_t>(n));
+    return parser;
+}
+
+std::unique_ptr<Parser> ParserFactory::create(const std::string& file_path, const unsigned char* head,
+                                              size_t size, std::string* format_name) const {
+    int index = match(head, size);
+    if (index < 0) {
+        LOG(WARNING) << "unknown format: " << file_path;
+        return nullptr;
+    }
+    MFP_LOG(DEBUG) << file_path << " sniffed as " << formats_[index].name;
+    if (format_name) {
+        *format_name = formats_[index].name;
+    }
+    return formats_[index].creator(file_path);
+}
@@ -0,0 +1,68 @@
+//
+// 根据文件头部的 magic 字节识别格式并创建对应的解析器.
+// 格式通过 register_format 注册, 识别时按 magic 所在字节查表分派, 不做试解析
+//
+
+#ifndef MEDIAFORMATPARSER_PARSERFACTORY_H
+#define MEDIAFORMATPARSER_PARSERFACTORY_H
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Parser.h"
+
+// 识别格式需要读取的文件头部长度
+#define SNIFF_SIZE 16
+
+using ParserCreator = std::function<std::unique_ptr<Parser>(const std::string&)>;
+// magic 匹配后的进一步校验, 可以为空
+using FormatVerifier = std::function<bool(const unsigned char* head, size_t size)>;
+
+class ParserFactory {
+public:
+    static ParserFactory& instance();
+
+    // 注册一个格式: 文件偏移 offset 处为 magic 时交给 verifier 校验, 通过后用 creator 创建解析器.
+    // 需要在并发调用 create 之前完成注册
+    void register_format(const std::string& name, size_t offset, const std::string& magic,
+                         ParserCreator creator, FormatVerifier verifier = nullptr);
+
+    // 返回匹配的格式名, 无法识别时返回空字符串
+    std::string sniff(const unsigned char* head, size_t size) const;
+    // 已注册的格式名, 按注册顺序去重
+    std::vector<std::string> format_names() const;
+    // 读取文件头部识别格式并创建解析器, 无法识别时返回 nullptr. format_name 不为空时写入识别出的格式名.
+    // 打开的 fd 和读取的头部通过 Parser::set_input 交给解析器, 解析时不再重新打开文件
+    std::unique_ptr<Parser> create(const std::string& file_path, std::string* format_name = nullptr) const;
+    std::unique_ptr<Parser> create(const std::string& file_path, const unsigned char* head, size_t size,
+                                   std::string* format_name = nullptr) const;
+
+private:
+    ParserFactory();
+    void register_builtin_formats();
+    int match(const unsigned char* head, size_t size) const;
+
+private:
+    struct FormatEntry {
+        std::string name;
+        size_t offset;
+        std::string magic;
+        ParserCreator creator;
+        FormatVerifier verifier;
+    };
+
+    // 同一偏移处的 magic 按首字节分派到候选格式
+    struct DispatchTable {
+        size_t offset;
+        std::array<std::vector<int>, 256> candidates;
+    };
+
+    std::vector<FormatEntry> formats_;
+    std::vector<DispatchTable> tables_;
+};
+
+
+#endif //MEDIAFORMATPARSER_PARSERFACTORY_H
@@ -0,0 +1,41 @@
+//
+// 解析日志开关.
+// easylogging++ 的全局存储由库持有, 调用方不需要 INITIALIZE_EASYLOGGINGPP
+//
+
+#include "ParserLog.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+std::atomic<bool> g_log_quiet{false};
+
+void set_log_quiet(bool quiet) {
+    g_log_quiet.store(quiet, std::memory_order_relaxed);
+}
+
+void set_log_enabled(bool enabled) {
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Enabled, enabled ? "true" : "false");
+}
+
+void init_console_log() {
+    el::Configurations conf;
+    conf.setToDefault();
+
+    // 禁用写入日志文件
+    conf.set(el::Level::Global, el::ConfigurationType::ToFile, "false");
+    // 启用输出到控制台
+    conf.set(el::Level::Global, el::ConfigurationType::ToStandardOutput, "true");
+    // 格式化日志
+    conf.set(el::Level::Global, el::ConfigurationType::Format,
+             "[%datetime] [%level] %msg");
+    // 日志颜色
+    conf.set(el::Level::Info, el::ConfigurationType::Format,
+             "\033[32m[%datetime] [%level] %msg\033[0m");  // 绿
+    conf.set(el::Level::Warning, el::ConfigurationType::Format,
+             "\033[33m[%datetime] [%level] %msg\033[0m");  // 黄
+    conf.set(el::Level::Error, el::ConfigurationType::Format,
+             "\033[31m[%datetime] [%level] %msg\033[0m");  // 红
+    conf.set(el::Level::Fatal, el::ConfigurationType::Format,
+             "\033[31m[%datetime] [%level] %msg\033[0m");  // 红
+    el::Loggers::reconfigureAllLoggers(conf);
+}
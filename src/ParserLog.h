@@ -0,0 +1,46 @@
+//
+// 解析热路径日志的编译期/运行期开关.
+// MFP_LOG(LEVEL) 低于编译期级别 MFP_LOG_LEVEL 时整条语句 (包括 << 右侧的格式化) 被编译器消除;
+// 开启 quiet 后 MFP_LOG 中 WARNING 以下的日志在运行期跳过, 同样不会做格式化.
+// 解析器和 Parser 的 INFO/DEBUG 日志都使用 MFP_LOG; 直接使用 LOG(INFO) 的只有批量解析的汇总和 --stats 的统计
+//
+
+#ifndef MEDIAFORMATPARSER_PARSERLOG_H
+#define MEDIAFORMATPARSER_PARSERLOG_H
+
+#include <atomic>
+
+#include "LogConfig.h"
+#include "logger/easylogging++.h"
+
+// 逐帧/逐 tag/逐 atom 的日志
+#define MFP_LOG_LEVEL_TRACE 0
+#define MFP_LOG_LEVEL_DEBUG 1
+#define MFP_LOG_LEVEL_INFO 2
+#define MFP_LOG_LEVEL_WARNING 3
+#define MFP_LOG_LEVEL_ERROR 4
+
+// 编译期最低日志级别, 默认保留所有日志
+#ifndef MFP_LOG_LEVEL
+#define MFP_LOG_LEVEL MFP_LOG_LEVEL_TRACE
+#endif
+
+// TRACE 用于原先以 INFO 输出的逐项内容 (帧头, tag, atom), 仍然以 easylogging++ 的 INFO 级别输出;
+// 原先的 DEBUG 日志 (函数入口等) 使用 MFP_LOG(DEBUG)
+#define MFP_EL_LEVEL_TRACE INFO
+#define MFP_EL_LEVEL_DEBUG DEBUG
+#define MFP_EL_LEVEL_INFO INFO
+#define MFP_EL_LEVEL_WARNING WARNING
+#define MFP_EL_LEVEL_ERROR ERROR
+
+extern std::atomic<bool> g_log_quiet;
+
+inline bool is_log_quiet(int level) {
+    return level < MFP_LOG_LEVEL_WARNING && g_log_quiet.load(std::memory_order_relaxed);
+}
+
+#define MFP_LOG(LEVEL) \
+    if (MFP_LOG_LEVEL_##LEVEL < MFP_LOG_LEVEL || is_log_quiet(MFP_LOG_LEVEL_##LEVEL)) {} else LOG(MFP_EL_LEVEL_##LEVEL)
+
+
+#endif //MEDIAFORMATPARSER_PARSERLOG_H
@@ -0,0 +1,231 @@
+//
+// 解析报告输出实现
+//
+
+#include "ReportWriter.h"
+
+#include <algorithm>
+
+int ReportWriter::open(const std::string& file_path) {
+    return out_.open(file_path);
+}
+
+void write_json_string(TextWriter& out, std::string_view s) {
+    static const char hex[] = "0123456789abcdef";
+    out << '"';
+    size_t start = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.write(s.data() + start, i - start);
+        start = i + 1;
+        if (c == '"' || c == '\\') {
+            out << '\\' << static_cast<char>(c);
+        } else {
+            // 控制字符 (包括 fourcc 中的 \0) 统一转义
+            char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            out.write(escaped, sizeof(escaped));
+        }
+    }
+    out.write(s.data() + start, s.size() - start);
+    out << '"';
+}
+
+void JsonReportWriter::write_string(std::string_view s) {
+    write_json_string(out_, s);
+}
+
+void JsonReportWriter::write(const FileRecord& r) {
+    out_ << "{\"record\":\"file\",\"format\":";
+    write_string(r.format);
+    out_ << ",\"path\":";
+    write_string(r.path);
+    out_ << ",\"size\":" << r.size << "}\n";
+}
+
+void JsonReportWriter::write(const WavChunkRecord& r) {
+    out_ << "{\"record\":\"wav_chunk\",\"id\":";
+    write_string(r.id);
+    out_ << ",\"offset\":" << r.offset
+         << ",\"size\":" << r.size << "}\n";
+}
+
+void JsonReportWriter::write(const WavFormatRecord& r) {
+    out_ << "{\"record\":\"wav_format\",\"audio_format\":" << r.audio_format
+         << ",\"channels\":" << r.channels
+         << ",\"sample_rate\":" << r.sample_rate
+         << ",\"byte_rate\":" << r.byte_rate
+         << ",\"block_align\":" << r.block_align
+         << ",\"bits_per_sample\":" << r.bits_per_sample
+         << ",\"valid_bits_per_sample\":" << r.valid_bits_per_sample
+         << ",\"channel_mask\":" << r.channel_mask << "}\n";
+}
+
+void JsonReportWriter::write(const Mp3FrameRunRecord& r) {
+    out_ << "{\"record\":\"mp3_frame_run\",\"first_frame\":" << r.first_frame
+         << ",\"last_frame\":" << r.last_frame
+         << ",\"header\":" << r.header
+         << ",\"bit_rate\":" << r.bit_rate
+         << ",\"sample_rate\":" << r.sample_rate
+         << ",\"version\":" << int(r.version)
+         << ",\"layer\":" << int(r.layer)
+         << ",\"channel_mode\":" << int(r.channel_mode)
+         << ",\"padding\":" << int(r.padding) << "}\n";
+}
+
+void JsonReportWriter::write(const FlvTagRecord& r) {
+    out_ << "{\"record\":\"flv_tag\",\"offset\":" << r.offset
+         << ",\"type\":" << int(r.type)
+         << ",\"data_size\":" << r.data_size
+         << ",\"timestamp\":" << r.timestamp
+         << ",\"stream_id\":" << r.stream_id
+         << ",\"data_flags\":" << int(r.data_flags) << "}\n";
+}
+
+void JsonReportWriter::write(const M4aAtomRecord& r) {
+    out_ << "{\"record\":\"m4a_atom\",\"offset\":" << r.offset
+         << ",\"size\":" << r.size
+         << ",\"type\":";
+    write_string(r.type);
+    out_ << ",\"depth\":" << r.depth
+         << ",\"child_count\":" << r.child_count << "}\n";
+}
+
+int BinaryReportWriter::open(const std::string& file_path) {
+    if (ReportWriter::open(file_path) < 0) {
+        return -1;
+    }
+    record_.clear();
+    record_.append(REPORT_BINARY_MAGIC, 4);
+    put_u16(REPORT_BINARY_VERSION);
+    out_.write(record_.data(), record_.size());
+    return 0;
+}
+
+void BinaryReportWriter::begin(ReportRecordType type) {
+    record_.clear();
+    put_u16(type);
+    // 负载长度在 end() 中回填
+    put_u32(0);
+}
+
+void BinaryReportWriter::end() {
+    uint32_t payload_size = record_.size() - 6;
+    for (int i = 0; i < 4; ++i) {
+        record_[2 + i] = static_cast<char>(payload_size >> (8 * i));
+    }
+    out_.write(record_.data(), record_.size());
+}
+
+void BinaryReportWriter::put_u8(uint8_t v) {
+    record_.push_back(static_cast<char>(v));
+}
+
+void BinaryReportWriter::put_u16(uint16_t v) {
+    put_u8(v);
+    put_u8(v >> 8);
+}
+
+void BinaryReportWriter::put_u32(uint32_t v) {
+    put_u16(v);
+    put_u16(v >> 16);
+}
+
+void BinaryReportWriter::put_u64(uint64_t v) {
+    put_u32(v);
+    put_u32(v >> 32);
+}
+
+void BinaryReportWriter::put_string(std::string_view s) {
+    size_t len = std::min<size_t>(s.size(), UINT16_MAX);
+    put_u16(len);
+    record_.append(s.data(), len);
+}
+
+void BinaryReportWriter::write(const FileRecord& r) {
+    begin(RECORD_FILE);
+    put_string(r.format);
+    put_string(r.path);
+    put_u64(r.size);
+    end();
+}
+
+void BinaryReportWriter::write(const WavChunkRecord& r) {
+    begin(RECORD_WAV_CHUNK);
+    put_string(r.id);
+    put_u64(r.offset);
+    put_u64(r.size);
+    end();
+}
+
+void BinaryReportWriter::write(const WavFormatRecord& r) {
+    begin(RECORD_WAV_FORMAT);
+    put_u16(r.audio_format);
+    put_u16(r.channels);
+    put_u32(r.sample_rate);
+    put_u32(r.byte_rate);
+    put_u16(r.block_align);
+    put_u16(r.bits_per_sample);
+    put_u16(r.valid_bits_per_sample);
+    put_u32(r.channel_mask);
+    end();
+}
+
+void BinaryReportWriter::write(const Mp3FrameRunRecord& r) {
+    begin(RECORD_MP3_FRAME_RUN);
+    put_u32(r.first_frame);
+    put_u32(r.last_frame);
+    put_u32(r.header);
+    put_u32(r.bit_rate);
+    put_u32(r.sample_rate);
+    put_u8(r.version);
+    put_u8(r.layer);
+    put_u8(r.channel_mode);
+    put_u8(r.padding);
+    end();
+}
+
+void BinaryReportWriter::write(const FlvTagRecord& r) {
+    begin(RECORD_FLV_TAG);
+    put_u64(r.offset);
+    put_u8(r.type);
+    put_u32(r.data_size);
+    put_u32(r.timestamp);
+    put_u32(r.stream_id);
+    put_u8(r.data_flags);
+    end();
+}
+
+void BinaryReportWriter::write(const M4aAtomRecord& r) {
+    begin(RECORD_M4A_ATOM);
+    put_u64(r.offset);
+    put_u64(r.size);
+    put_string(r.type);
+    put_u16(r.depth);
+    put_u16(r.child_count);
+    end();
+}
+
+std::unique_ptr<ReportWriter> create_report_writer(ReportFormat format) {
+    switch (format) {
+        case REPORT_JSON:
+            return std::make_unique<JsonReportWriter>();
+        case REPORT_BINARY:
+            return std::make_unique<BinaryReportWriter>();
+        default:
+            return nullptr;
+    }
+}
+
+const char* report_extension(ReportFormat format) {
+    switch (format) {
+        case REPORT_JSON:
+            return ".jsonl";
+        case REPORT_BINARY:
+            return ".mfpr";
+        default:
+            return "";
+    }
+}
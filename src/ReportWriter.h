@@ -0,0 +1,160 @@
+//
+// 机器可读的解析报告, 与 dump_info 的 .txt 并列输出.
+// JSON lines: 每条记录一行 JSON 对象, "record" 字段为记录类型.
+// 二进制: 文件头 "MFPR" + u16 版本, 之后每条记录为 u16 类型 + u32 负载长度 + 负载.
+// 负载字段按下面结构体的声明顺序以小端序排列, 字符串为 u16 长度 + 字节.
+// 消费方可以按长度跳过不认识的记录类型
+//
+
+#ifndef MEDIAFORMATPARSER_REPORTWRITER_H
+#define MEDIAFORMATPARSER_REPORTWRITER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "TextWriter.h"
+
+#define REPORT_BINARY_MAGIC "MFPR"
+// 版本 2: wav_chunk 的 size 扩展为 64 位 (RF64)
+#define REPORT_BINARY_VERSION 2
+
+enum ReportFormat {
+    REPORT_NONE,
+    REPORT_JSON,
+    REPORT_BINARY,
+};
+
+enum ReportRecordType: uint16_t {
+    RECORD_FILE = 1,
+    RECORD_WAV_CHUNK = 2,
+    RECORD_WAV_FORMAT = 3,
+    RECORD_MP3_FRAME_RUN = 4,
+    RECORD_FLV_TAG = 5,
+    RECORD_M4A_ATOM = 6,
+};
+
+// 每个报告的第一条记录
+struct FileRecord {
+    std::string_view format;
+    std::string_view path;
+    uint64_t size;
+};
+
+struct WavChunkRecord {
+    std::string_view id;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct WavFormatRecord {
+    uint16_t audio_format;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    uint16_t valid_bits_per_sample;
+    uint32_t channel_mask;
+};
+
+// 帧头完全相同的连续帧, 帧序号从 1 开始, 包含 last_frame
+struct Mp3FrameRunRecord {
+    uint32_t first_frame;
+    uint32_t last_frame;
+    uint32_t header;
+    uint32_t bit_rate;     // kbps
+    uint32_t sample_rate;
+    uint8_t version;
+    uint8_t layer;
+    uint8_t channel_mode;
+    uint8_t padding;
+};
+
+struct FlvTagRecord {
+    uint64_t offset;
+    uint8_t type;
+    uint32_t data_size;
+    uint32_t timestamp;    // 已合并扩展时间戳, 毫秒
+    uint32_t stream_id;
+    uint8_t data_flags;    // 音频/视频 tag 数据的第一个字节, 其他 tag 为 0
+};
+
+// atom 按先序输出, depth 为嵌套深度, 顶层为 0
+struct M4aAtomRecord {
+    uint64_t offset;
+    uint64_t size;
+    std::string_view type;
+    uint16_t depth;
+    uint16_t child_count;
+};
+
+class ReportWriter {
+public:
+    virtual ~ReportWriter() = default;
+
+    virtual int open(const std::string& file_path);
+    // 写出缓冲内容并关闭文件, 写入失败时返回负数
+    int close() { return out_.close(); }
+    uint64_t bytes_written() const { return out_.bytes_written(); }
+
+    virtual void write(const FileRecord& r) = 0;
+    virtual void write(const WavChunkRecord& r) = 0;
+    virtual void write(const WavFormatRecord& r) = 0;
+    virtual void write(const Mp3FrameRunRecord& r) = 0;
+    virtual void write(const FlvTagRecord& r) = 0;
+    virtual void write(const M4aAtomRecord& r) = 0;
+
+protected:
+    TextWriter out_;
+};
+
+class JsonReportWriter: public ReportWriter {
+public:
+    void write(const FileRecord& r) override;
+    void write(const WavChunkRecord& r) override;
+    void write(const WavFormatRecord& r) override;
+    void write(const Mp3FrameRunRecord& r) override;
+    void write(const FlvTagRecord& r) override;
+    void write(const M4aAtomRecord& r) override;
+
+private:
+    void write_string(std::string_view s);
+};
+
+class BinaryReportWriter: public ReportWriter {
+public:
+    int open(const std::string& file_path) override;
+
+    void write(const FileRecord& r) override;
+    void write(const WavChunkRecord& r) override;
+    void write(const WavFormatRecord& r) override;
+    void write(const Mp3FrameRunRecord& r) override;
+    void write(const FlvTagRecord& r) override;
+    void write(const M4aAtomRecord& r) override;
+
+private:
+    void begin(ReportRecordType type);
+    void end();
+    void put_u8(uint8_t v);
+    void put_u16(uint16_t v);
+    void put_u32(uint32_t v);
+    void put_u64(uint64_t v);
+    void put_string(std::string_view s);
+
+private:
+    // 当前记录, 写完后整体输出, 复用同一块内存
+    std::string record_;
+};
+
+// 带引号和转义的 JSON 字符串
+void write_json_string(TextWriter& out, std::string_view s);
+
+// REPORT_NONE 返回 nullptr
+std::unique_ptr<ReportWriter> create_report_writer(ReportFormat format);
+// 报告文件扩展名, 含 "."
+const char* report_extension(ReportFormat format);
+
+
+#endif //MEDIAFORMATPARSER_REPORTWRITER_H
@@ -0,0 +1,94 @@
+//
+// 文本输出实现
+//
+
+#include "TextWriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "logger/easylogging++.h"
+
+TextWriter::TextWriter(): buffer_(new char[TEXT_WRITER_BUFFER_SIZE]), capacity_(TEXT_WRITER_BUFFER_SIZE) {}
+
+TextWriter::TextWriter(std::ostream& stream): stream_(&stream),
+    buffer_(new char[TEXT_WRITER_STREAM_BUFFER_SIZE]), capacity_(TEXT_WRITER_STREAM_BUFFER_SIZE) {}
+
+TextWriter::~TextWriter() {
+    close();
+}
+
+int TextWriter::open(const std::string& file_path) {
+    close();
+    fd_ = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        LOG(ERROR) << "open file " << file_path << " failed";
+        return -1;
+    }
+    failed_ = false;
+    written_ = 0;
+    return 0;
+}
+
+int TextWriter::close() {
+    flush_buffer();
+    if (fd_ >= 0) {
+        if (::close(fd_) < 0) {
+            failed_ = true;
+        }
+        fd_ = -1;
+    }
+    stream_ = nullptr;
+    return failed_ ? -1 : 0;
+}
+
+TextWriter& TextWriter::operator<<(FixedValue v) {
+    char s[64];
+    int len = snprintf(s, sizeof(s), "%.*f", v.precision, v.value);
+    if (len < 0) {
+        return *this;
+    }
+    return write(s, std::min(static_cast<size_t>(len), sizeof(s) - 1));
+}
+
+TextWriter& TextWriter::write_slow(const char* s, size_t len) {
+    flush_buffer();
+    if (len <= capacity_) {
+        memcpy(buffer_.get(), s, len);
+        size_ = len;
+        return *this;
+    }
+    // 超过缓冲大小的内容直接写出
+    write_out(s, len);
+    return *this;
+}
+
+void TextWriter::flush_buffer() {
+    if (size_ > 0) {
+        write_out(buffer_.get(), size_);
+        size_ = 0;
+    }
+}
+
+void TextWriter::write_out(const char* p, size_t len) {
+    written_ += len;
+    if (stream_) {
+        stream_->write(p, len);
+        return;
+    }
+    while (fd_ >= 0 && len > 0) {
+        ssize_t n = ::write(fd_, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed_ = true;
+            break;
+        }
+        p += n;
+        len -= n;
+    }
+}
@@ -0,0 +1,132 @@
+//
+// 带大块用户态缓冲的文本输出, 用于 dump_info.
+// 整数用 std::to_chars 格式化, 浮点只支持定点格式, 不经过 iostream, 也不会逐行 flush.
+// 同一套 operator<< 也可以写入 std::ostream (日志), 见 write_text
+//
+
+#ifndef MEDIAFORMATPARSER_TEXTWRITER_H
+#define MEDIAFORMATPARSER_TEXTWRITER_H
+
+#include <bitset>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#define TEXT_WRITER_BUFFER_SIZE (1024 * 1024)
+// 写入 std::ostream 时使用的小缓冲
+#define TEXT_WRITER_STREAM_BUFFER_SIZE 512
+
+// 定点格式的浮点数, 等价于 std::fixed << std::setprecision(precision)
+struct FixedValue {
+    double value;
+    int precision;
+};
+
+inline FixedValue fixed_value(double value, int precision) {
+    return FixedValue{value, precision};
+}
+
+class TextWriter {
+public:
+    TextWriter();
+    // 输出到 stream, 析构时写出剩余内容
+    explicit TextWriter(std::ostream& stream);
+    ~TextWriter();
+
+    TextWriter(const TextWriter&) = delete;
+    TextWriter& operator=(const TextWriter&) = delete;
+
+    int open(const std::string& file_path);
+    bool is_open() const { return fd_ >= 0 || stream_ != nullptr; }
+    // 写出缓冲内容并关闭文件, 写入失败时返回负数
+    int close();
+    // 已写入的字节数, 包括还在缓冲区中的部分
+    uint64_t bytes_written() const { return written_ + size_; }
+
+    TextWriter& write(const char* s, size_t len) {
+        if (len > capacity_ - size_) {
+            return write_slow(s, len);
+        }
+        memcpy(buffer_.get() + size_, s, len);
+        size_ += len;
+        return *this;
+    }
+
+    TextWriter& operator<<(const char* s) { return write(s, strlen(s)); }
+    TextWriter& operator<<(std::string_view s) { return write(s.data(), s.size()); }
+    TextWriter& operator<<(const std::string& s) { return write(s.data(), s.size()); }
+
+    // 与 std::ostream 一致, 字符类型按字符输出
+    TextWriter& operator<<(char c) { return put(c); }
+    TextWriter& operator<<(signed char c) { return put(static_cast<char>(c)); }
+    TextWriter& operator<<(unsigned char c) { return put(static_cast<char>(c)); }
+    TextWriter& operator<<(bool b) { return put(b ? '1' : '0'); }
+
+    TextWriter& operator<<(short v) { return write_integer(v); }
+    TextWriter& operator<<(unsigned short v) { return write_integer(v); }
+    TextWriter& operator<<(int v) { return write_integer(v); }
+    TextWriter& operator<<(unsigned int v) { return write_integer(v); }
+    TextWriter& operator<<(long v) { return write_integer(v); }
+    TextWriter& operator<<(unsigned long v) { return write_integer(v); }
+    TextWriter& operator<<(long long v) { return write_integer(v); }
+    TextWriter& operator<<(unsigned long long v) { return write_integer(v); }
+
+    TextWriter& operator<<(FixedValue v);
+
+    template <size_t N>
+    TextWriter& operator<<(const std::bitset<N>& bits) {
+        char s[N];
+        for (size_t i = 0; i < N; ++i) {
+            s[i] = bits[N - 1 - i] ? '1' : '0';
+        }
+        return write(s, N);
+    }
+
+private:
+    TextWriter& put(char c) {
+        if (size_ == capacity_) {
+            flush_buffer();
+        }
+        buffer_[size_++] = c;
+        return *this;
+    }
+
+    template <typename T>
+    TextWriter& write_integer(T v) {
+        // 64 位整数最多 20 位数字加符号
+        if (capacity_ - size_ < 24) {
+            flush_buffer();
+        }
+        char* p = buffer_.get() + size_;
+        size_ = std::to_chars(p, p + 24, v).ptr - buffer_.get();
+        return *this;
+    }
+
+    TextWriter& write_slow(const char* s, size_t len);
+    void flush_buffer();
+    void write_out(const char* p, size_t len);
+
+private:
+    int fd_ = -1;
+    std::ostream* stream_ = nullptr;
+    bool failed_ = false;
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_;
+    size_t size_ = 0;
+    uint64_t written_ = 0;
+};
+
+// 用 TextWriter 的格式化输出到 std::ostream, 让日志和 dump_info 共用一套 operator<<
+template <typename T>
+std::ostream& write_text(std::ostream& out, const T& value) {
+    TextWriter writer(out);
+    writer << value;
+    return out;
+}
+
+
+#endif //MEDIAFORMATPARSER_TEXTWRITER_H
@@ -0,0 +1,68 @@
+//
+// 工作窃取线程池: 每个线程有自己的任务队列, 空闲时从其他线程的队列尾部窃取任务
+//
+
+#ifndef MEDIAFORMATPARSER_THREADPOOL_H
+#define MEDIAFORMATPARSER_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // thread_count 为 0 时使用 CPU 核数
+    explicit ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+
+    size_t size() const { return threads_.size(); }
+
+    // 任务按提交顺序轮流分配到各线程队列, 线程优先执行自己队列中先提交的任务
+    void submit(std::function<void()> task);
+    // 等待所有已提交的任务执行完毕
+    void wait();
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void worker_loop(size_t index);
+    bool pop_task(size_t index, std::function<void()>& task);
+    bool steal_task(size_t index, std::function<void()>& task);
+
+private:
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> unfinished_{0};
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    bool stop_ = false;
+};
+
+// 提交到共用线程池的一组任务, wait() 只等待本组的任务, 不受其他使用方提交的任务影响
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool): pool_(pool) {}
+
+    void submit(std::function<void()> task);
+    void wait();
+
+private:
+    ThreadPool& pool_;
+    std::mutex mutex_;
+    std::condition_variable done_cv_;
+    size_t pending_ = 0;
+};
+
+
+#endif //MEDIAFORMATPARSER_THREADPOOL_H
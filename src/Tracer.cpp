@@ -0,0 +1,151 @@
+//
+// 耗时追踪
+//
+
+#include "Tracer.h"
+
+#include <algorithm>
+
+#include "ParseStats.h"
+#include "ReportWriter.h"
+#include "TextWriter.h"
+
+#include "logger/easylogging++.h"
+
+struct LocalTraceBuffer {
+    std::shared_ptr<TraceBuffer> buffer;
+    uint64_t generation = 0;
+};
+
+static thread_local LocalTraceBuffer t_local_buffer;
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::~Tracer() {
+    // 进程退出时仍在记录, 写出已有的事件
+    if (enabled()) {
+        enabled_.store(false, std::memory_order_relaxed);
+        write_trace();
+    }
+}
+
+void Tracer::start(const std::string& file_path) {
+    if (enabled()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.clear();
+    }
+    file_path_ = file_path;
+    dropped_.store(0, std::memory_order_relaxed);
+    start_ns_ = monotonic_ns();
+    // 上一次记录留下的线程缓冲区作废
+    generation_.fetch_add(1, std::memory_order_release);
+    enabled_.store(true, std::memory_order_release);
+}
+
+int Tracer::stop() {
+    if (!enabled()) {
+        return 0;
+    }
+    enabled_.store(false, std::memory_order_release);
+    int ret = write_trace();
+    if (dropped() > 0) {
+        LOG(WARNING) << "trace buffer full, " << dropped() << " events dropped";
+    }
+    return ret;
+}
+
+TraceBuffer* Tracer::local_buffer() {
+    uint64_t generation = generation_.load(std::memory_order_acquire);
+    if (t_local_buffer.buffer && t_local_buffer.generation == generation) {
+        return t_local_buffer.buffer.get();
+    }
+    auto buffer = std::make_shared<TraceBuffer>();
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    buffer->tid = buffers_.size() + 1;
+    buffers_.push_back(buffer);
+    t_local_buffer.buffer = buffer;
+    t_local_buffer.generation = generation;
+    return buffer.get();
+}
+
+void Tracer::record(const char* name, uint64_t begin_ns, uint64_t end_ns, std::string detail) {
+    if (!enabled()) {
+        return;
+    }
+    TraceBuffer* buffer = local_buffer();
+    // 只有写出时才会竞争
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    if (buffer->events.size() >= TRACE_MAX_EVENTS_PER_THREAD) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->events.push_back(TraceEvent{name, begin_ns, end_ns, std::move(detail)});
+}
+
+// 时间戳单位为微秒
+static FixedValue to_us(uint64_t ns) {
+    return fixed_value(ns / 1e3, 3);
+}
+
+int Tracer::write_trace() {
+    TextWriter out;
+    if (out.open(file_path_) < 0) {
+        return -1;
+    }
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers = buffers_;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (auto& buffer: buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"thread " << buffer->tid << "\"}}";
+        first = false;
+        for (auto& e: buffer->events) {
+            uint64_t begin = std::max(e.begin_ns, start_ns_) - start_ns_;
+            out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"parse\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << to_us(begin) << ",\"dur\":" << to_us(e.end_ns - e.begin_ns);
+            if (!e.detail.empty()) {
+                out << ",\"args\":{\"detail\":";
+                write_json_string(out, e.detail);
+                out << '}';
+            }
+            out << '}';
+        }
+        buffer->events.clear();
+    }
+    out << "\n]}\n";
+    return out.close();
+}
+
+TraceScope::TraceScope(const char* name) {
+    if (Tracer::instance().enabled()) {
+        name_ = name;
+        begin_ns_ = monotonic_ns();
+    }
+}
+
+TraceScope::TraceScope(const char* name, const std::string& detail) {
+    if (Tracer::instance().enabled()) {
+        name_ = name;
+        detail_ = detail;
+        begin_ns_ = monotonic_ns();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (name_) {
+        Tracer::instance().record(name_, begin_ns_, monotonic_ns(), std::move(detail_));
+    }
+}
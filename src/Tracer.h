@@ -0,0 +1,92 @@
+//
+// Chrome trace event 格式的耗时追踪, 输出的 JSON 可以直接用 chrome://tracing 或 Perfetto 打开.
+// MFP_TRACE_SCOPE 在作用域结束时记录一个完整事件 (ph "X") 到本线程的缓冲区, 停止时统一写出.
+// 未开启时每个作用域只多一次 relaxed 原子读; 以 MFP_NO_TRACE 编译时整个宏为空
+//
+
+#ifndef MEDIAFORMATPARSER_TRACER_H
+#define MEDIAFORMATPARSER_TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 每个线程最多记录的事件数, 超出后丢弃并计数
+#define TRACE_MAX_EVENTS_PER_THREAD (1024 * 1024)
+
+struct TraceEvent {
+    const char* name;     // 必须是静态字符串
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    std::string detail;   // 可选, 输出为 args.detail
+};
+
+// 单个线程的事件缓冲区, 只有所属线程追加, 写出时加锁读取
+struct TraceBuffer {
+    uint32_t tid;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+};
+
+class Tracer {
+public:
+    static Tracer& instance();
+
+    // 开始记录, stop() 时写出到 file_path
+    void start(const std::string& file_path);
+    // 停止记录并写出 trace 文件, 写入失败时返回负数. 需在所有被追踪的线程结束后调用
+    int stop();
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    void record(const char* name, uint64_t begin_ns, uint64_t end_ns, std::string detail = std::string());
+
+private:
+    Tracer() = default;
+    ~Tracer();
+
+    TraceBuffer* local_buffer();
+    int write_trace();
+
+private:
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::string file_path_;
+    uint64_t start_ns_ = 0;
+
+    std::mutex buffers_mutex_;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers_;
+};
+
+// 作用域结束时记录一个事件
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    TraceScope(const char* name, const std::string& detail);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_ = nullptr;
+    uint64_t begin_ns_ = 0;
+    std::string detail_;
+};
+
+#define MFP_TRACE_CONCAT_INNER(a, b) a##b
+#define MFP_TRACE_CONCAT(a, b) MFP_TRACE_CONCAT_INNER(a, b)
+
+#ifdef MFP_NO_TRACE
+#define MFP_TRACE_SCOPE(...)
+#else
+#define MFP_TRACE_SCOPE(...) TraceScope MFP_TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+#endif
+
+
+#endif //MEDIAFORMATPARSER_TRACER_H
@@ -3,13 +3,15 @@
 //
 
 #include "WavParser.h"
+#include "TextWriter.h"
+#include "Tracer.h"
 #include "utils.h"
-#include "logger/easylogging++.h"
+#include "ParserLog.h"
 
 #include <fstream>
 
-std::string get_format_str(uint16_t format) {
-    std::string audio_format_str = "UNKONWN";
+const char* get_format_str(uint16_t format) {
+    const char* audio_format_str = "UNKONWN";
     switch (format) {
         case WAVE_FORMAT_PCM:
             audio_format_str = "PCM";
@@ -30,55 +32,86 @@ std::string get_format_str(uint16_t format) {
     return audio_format_str;
 }
 
-std::ostream & operator << (std::ostream &out, const HeaderChunk &c) {
-    out << "header chunk:" << std::endl;
-    out << "\tid: " << std::string(c.id, 4) << std::endl;
-    out << "\tsize: " << c.size << std::endl;
-    out << "\ttype: " << std::string(c.type, 4) << std::endl;
+TextWriter& operator<<(TextWriter &out, const HeaderChunk &c) {
+    out << "header chunk:" << '\n';
+    out << "\tid: " << std::string_view(c.id, 4) << '\n';
+    out << "\tsize: " << c.size << '\n';
+    out << "\ttype: " << std::string_view(c.type, 4) << '\n';
     return out;
 }
 
-std::ostream & operator << (std::ostream &out, const FormatChunk &c) {
-    std::string audio_format_str = get_format_str(c.audio_format);
-
-    out << "format chunk:" << std::endl;
-    out << "\tid: " << std::string(c.id, 4) << std::endl;
-    out << "\tsize: " << c.size << std::endl;
-    out << "\taudioFormat: " << c.audio_format << " (" << audio_format_str << ")" << std::endl;
-    out << "\tchannels: " << c.channels << std::endl;
-    out << "\tsampleRate: " << c.sample_rate << std::endl;
-    out << "\tbyteRate: " << c.byte_rate << std::endl;
-    out << "\tblockAlign: " << c.block_align << std::endl;
-    out << "\tbitsPerSample: " << c.bits_per_sample << std::endl;
+std::ostream& operator<<(std::ostream &out, const HeaderChunk &c) {
+    return write_text(out, c);
+}
+
+TextWriter& operator<<(TextWriter &out, const Ds64Chunk &c) {
+    out << "ds64 chunk:" << '\n';
+    out << "\tid: " << std::string_view(c.id, 4) << '\n';
+    out << "\tsize: " << c.size << '\n';
+    out << "\triffSize: " << c.riff_size << '\n';
+    out << "\tdataSize: " << c.data_size << '\n';
+    out << "\tsampleCount: " << c.sample_count << '\n';
+    out << "\ttableLength: " << c.table_length << '\n';
+    return out;
+}
+
+std::ostream& operator<<(std::ostream &out, const Ds64Chunk &c) {
+    return write_text(out, c);
+}
+
+TextWriter& operator<<(TextWriter &out, const FormatChunk &c) {
+    const char* audio_format_str = get_format_str(c.audio_format);
+
+    out << "format chunk:" << '\n';
+    out << "\tid: " << std::string_view(c.id, 4) << '\n';
+    out << "\tsize: " << c.size << '\n';
+    out << "\taudioFormat: " << c.audio_format << " (" << audio_format_str << ")" << '\n';
+    out << "\tchannels: " << c.channels << '\n';
+    out << "\tsampleRate: " << c.sample_rate << '\n';
+    out << "\tbyteRate: " << c.byte_rate << '\n';
+    out << "\tblockAlign: " << c.block_align << '\n';
+    out << "\tbitsPerSample: " << c.bits_per_sample << '\n';
     if (c.size > 16) {
-        out << "\textensionSize: " << c.extension_size << std::endl;
+        out << "\textensionSize: " << c.extension_size << '\n';
         if (c.extension_size > 0) {
-            std::string format_str = get_format_str(bytes_to_int2_le(
+            const char* format_str = get_format_str(bytes_to_int2_le(
                     reinterpret_cast<const unsigned char *>(c.sub_format)));
-            out << "\tvalidBitsPerSample: " << c.valid_bits_per_sample << std::endl;
-            out << "\tchannelMask: " << c.channel_mask << std::endl;
-            out << "\tsubFormat: " << std::string(c.sub_format, 16) << " (" + format_str + ") " << std::endl;
+            out << "\tvalidBitsPerSample: " << c.valid_bits_per_sample << '\n';
+            out << "\tchannelMask: " << c.channel_mask << '\n';
+            out << "\tsubFormat: " << std::string_view(c.sub_format, 16) << " (" << format_str << ") " << '\n';
         }
     }
     return out;
 }
 
-std::ostream & operator << (std::ostream &out, const DataChunk &c) {
-    out << "data chunk:" << std::endl;
-    out << "\tid: " << std::string(c.id, 4) << std::endl;
-    out << "\tsize: " << c.size << std::endl;
-    out << "\tpad_byte: " << static_cast<int>(c.pad_byte) << std::endl;
+std::ostream& operator<<(std::ostream &out, const FormatChunk &c) {
+    return write_text(out, c);
+}
+
+TextWriter& operator<<(TextWriter &out, const DataChunk &c) {
+    out << "data chunk:" << '\n';
+    out << "\tid: " << std::string_view(c.id, 4) << '\n';
+    out << "\tsize: " << c.size << '\n';
+    out << "\tpad_byte: " << static_cast<int>(c.pad_byte) << '\n';
     return out;
 }
 
-std::ostream & operator << (std::ostream &out, const FactChunk &c) {
-    out << "fact chunk:" << std::endl;
-    out << "\tid: " << std::string(c.id, 4) << std::endl;
-    out << "\tsize: " << c.size << std::endl;
-    out << "\tsampleLength: " << c.sample_length << std::endl;
+std::ostream& operator<<(std::ostream &out, const DataChunk &c) {
+    return write_text(out, c);
+}
+
+TextWriter& operator<<(TextWriter &out, const FactChunk &c) {
+    out << "fact chunk:" << '\n';
+    out << "\tid: " << std::string_view(c.id, 4) << '\n';
+    out << "\tsize: " << c.size << '\n';
+    out << "\tsampleLength: " << c.sample_length << '\n';
     return out;
 }
 
+std::ostream& operator<<(std::ostream &out, const FactChunk &c) {
+    return write_text(out, c);
+}
+
 WavParser::WavParser(const std::string& filePath): Parser(filePath) {
     
 }
@@ -87,6 +120,10 @@ WavParser::~WavParser() {
     if (header_chunk_) {
         delete header_chunk_;
     }
+
+    if (ds64_chunk_) {
+        delete ds64_chunk_;
+    }
     
     if (format_chunk_) {
         delete format_chunk_;
@@ -97,9 +134,6 @@ WavParser::~WavParser() {
     }
     
     if (data_chunk_) {
-        if (data_chunk_->data) {
-            delete[] data_chunk_->data;
-        }
         delete data_chunk_;
     }
 }
@@ -114,19 +148,22 @@ int WavParser::custom_parse() {
         return -2;
     }
 
-    uint32_t valid_data_size = header_chunk_->size + 8;
+    stats_.item_unit = "chunks";
+    stats_.items = 1;
+    uint64_t valid_data_size = riff_end_;
     char chunk_id[4];
     while (pos_ + 4 < valid_data_size) {
-        memcpy(chunk_id, data_ + pos_, 4);
+        memcpy(chunk_id, fetch(pos_, 4), 4);
         std::string chunk_id_str = std::string(chunk_id, 4);
-        uint32_t chunk_size = bytes_to_int4_le(data_ + pos_ + 4) + 4 + 4;
+        uint64_t chunk_size = get_chunk_size(pos_) + 4 + 4;
 
         if (pos_ + chunk_size > valid_data_size) {
             LOG(ERROR) << "not enough chunk data";
             return -3;
         }
 
-        LOG(DEBUG) << "get chunk id " << chunk_id_str;
+        MFP_LOG(DEBUG) << "get chunk id " << chunk_id_str;
+        stats_.items++;
         if (chunk_id_str == FMT_ID) {
             if (parse_format_chunk() < 0) {
                 return -4;
@@ -148,21 +185,73 @@ int WavParser::custom_parse() {
     return 0;
 }
 
+int WavParser::custom_probe() {
+    stream_info_.format = "wav";
+    if (data_size_ < HEAD_CHUNK_SIZE) {
+        LOG(ERROR) << "not enough header data";
+        return -1;
+    }
+
+    if (parse_header_chunk() < 0) {
+        return -2;
+    }
+
+    // 只读取各个 chunk 的头部, 遇到 data chunk 即停止, 不读取音频数据
+    uint64_t valid_data_size = riff_end_;
+    while (pos_ + 8 <= valid_data_size) {
+        std::string chunk_id_str = std::string(reinterpret_cast<const char *>(fetch(pos_, 4)), 4);
+        uint64_t chunk_size = get_chunk_size(pos_) + 4 + 4;
+
+        if (chunk_id_str == FMT_ID) {
+            if (parse_format_chunk() < 0) {
+                return -4;
+            }
+        } else if (chunk_id_str == FACT_ID) {
+            if (parse_fact_chunk() < 0) {
+                return -5;
+            }
+        } else if (chunk_id_str == DATA_ID) {
+            if (parse_data_chunk(false) < 0) {
+                return -6;
+            }
+            break;
+        }
+        pos_ += chunk_size;
+    }
+
+    if (format_chunk_ == nullptr) {
+        LOG(ERROR) << "no format chunk";
+        return -3;
+    }
+
+    stream_info_.has_audio = true;
+    stream_info_.sample_rate = format_chunk_->sample_rate;
+    stream_info_.channels = format_chunk_->channels;
+    stream_info_.bits_per_sample = format_chunk_->bits_per_sample;
+    stream_info_.bit_rate = format_chunk_->byte_rate * 8 / 1000;
+    if (data_chunk_ && format_chunk_->byte_rate > 0) {
+        stream_info_.duration = static_cast<double>(data_chunk_->size) / format_chunk_->byte_rate;
+    }
+    return 0;
+}
+
 int WavParser::parse_header_chunk() {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
     
     header_chunk_ = new HeaderChunk();
 
-    memcpy(header_chunk_->id, data_ + pos_, 4);
-    if (std::string(header_chunk_->id, 4) != RIFF_ID) {
+    memcpy(header_chunk_->id, fetch(pos_, 4), 4);
+    std::string id = std::string(header_chunk_->id, 4);
+    if (id != RIFF_ID && id != RF64_ID) {
         return -1;
     }
     pos_ += 4;
 
-    header_chunk_->size = bytes_to_int4_le(data_ + pos_);
+    header_chunk_->size = bytes_to_int4_le(fetch(pos_, 4));
     pos_ += 4;
 
-    memcpy(header_chunk_->type, data_ + pos_, 4);
+    memcpy(header_chunk_->type, fetch(pos_, 4), 4);
     pos_ += 4;
 
     if (std::string(header_chunk_->type, 4) != WAVE_TAG) {
@@ -170,89 +259,160 @@ int WavParser::parse_header_chunk() {
         return -2;
     }
 
-    LOG(INFO) << *header_chunk_;
+    MFP_LOG(TRACE) << *header_chunk_;
+    riff_end_ = static_cast<uint64_t>(header_chunk_->size) + 8;
+    if (id == RF64_ID) {
+        // ds64 必须紧跟在 WAVE 之后, 由 chunk 遍历按普通 chunk 跳过
+        if (parse_ds64_chunk() < 0) {
+            return -3;
+        }
+        if (header_chunk_->size == RF64_SIZE_IN_DS64) {
+            riff_end_ = ds64_chunk_->riff_size + 8;
+        }
+    }
+    return 0;
+}
+
+int WavParser::parse_ds64_chunk() {
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
+
+    size_t pos = pos_;
+    if (pos + 8 + DS64_CHUNK_MIN_SIZE > data_size_) {
+        LOG(ERROR) << "not enough ds64 chunk data";
+        return -1;
+    }
+
+    ds64_chunk_ = new Ds64Chunk();
+    ds64_chunk_->offset = pos;
+
+    memcpy(ds64_chunk_->id, fetch(pos, 4), 4);
+    pos += 4;
+
+    if (std::string(ds64_chunk_->id, 4) != DS64_ID) {
+        LOG(ERROR) << "parse id error. got " << std::string(ds64_chunk_->id, 4) << ", expected " << DS64_ID;
+        return -2;
+    }
+
+    ds64_chunk_->size = bytes_to_int4_le(fetch(pos, 4));
+    pos += 4;
+
+    if (ds64_chunk_->size < DS64_CHUNK_MIN_SIZE) {
+        LOG(ERROR) << "ds64 chunk too small: " << ds64_chunk_->size;
+        return -3;
+    }
+
+    ds64_chunk_->riff_size = bytes_to_int8_le(fetch(pos, 8));
+    pos += 8;
+
+    ds64_chunk_->data_size = bytes_to_int8_le(fetch(pos, 8));
+    pos += 8;
+
+    ds64_chunk_->sample_count = bytes_to_int8_le(fetch(pos, 8));
+    pos += 8;
+
+    // 其后是 table_length 项其他 chunk 的 64 位大小, 目前只有 data chunk 会超过 4 GB, 不解析
+    ds64_chunk_->table_length = bytes_to_int4_le(fetch(pos, 4));
+    pos += 4;
+
+    MFP_LOG(TRACE) << *ds64_chunk_;
     return 0;
 }
 
+// chunk 头部中的 size, RF64 的 data chunk 取 ds64 中的实际大小
+uint64_t WavParser::get_chunk_size(size_t pos) {
+    uint32_t size = bytes_to_int4_le(fetch(pos + 4, 4));
+    if (ds64_chunk_ && size == RF64_SIZE_IN_DS64 && memcmp(fetch(pos, 4), DATA_ID, 4) == 0) {
+        return ds64_chunk_->data_size;
+    }
+    return size;
+}
+
 int WavParser::parse_format_chunk() {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
 
-    uint32_t pos = pos_;
+    size_t pos = pos_;
 
-    format_chunk_ = new FormatChunk;
+    format_chunk_ = new FormatChunk();
+    format_chunk_->offset = pos;
 
-    memcpy(format_chunk_->id, data_ + pos, 4);
+    memcpy(format_chunk_->id, fetch(pos, 4), 4);
     pos += 4;
 
-    format_chunk_->size = bytes_to_int4_le(data_ + pos);
+    format_chunk_->size = bytes_to_int4_le(fetch(pos, 4));
     pos += 4;
 
-    format_chunk_->audio_format = bytes_to_int2_le(data_ + pos);
+    format_chunk_->audio_format = bytes_to_int2_le(fetch(pos, 2));
     pos += 2;
 
-    format_chunk_->channels = bytes_to_int2_le(data_ + pos);
+    format_chunk_->channels = bytes_to_int2_le(fetch(pos, 2));
     pos += 2;
 
-    format_chunk_->sample_rate = bytes_to_int4_le(data_ + pos);
+    format_chunk_->sample_rate = bytes_to_int4_le(fetch(pos, 4));
     pos += 4;
 
-    format_chunk_->byte_rate = bytes_to_int4_le(data_ + pos);
+    format_chunk_->byte_rate = bytes_to_int4_le(fetch(pos, 4));
     pos += 4;
 
-    format_chunk_->block_align = bytes_to_int2_le(data_ + pos);
+    format_chunk_->block_align = bytes_to_int2_le(fetch(pos, 2));
     pos += 2;
 
-    format_chunk_->bits_per_sample = bytes_to_int2_le(data_ + pos);
+    format_chunk_->bits_per_sample = bytes_to_int2_le(fetch(pos, 2));
     pos += 2;
 
     if (format_chunk_->size > 16) {
-        format_chunk_->extension_size = bytes_to_int2_le(data_ + pos);
+        format_chunk_->extension_size = bytes_to_int2_le(fetch(pos, 2));
         pos += 2;
 
         if (format_chunk_->extension_size > 0) {
-            format_chunk_->valid_bits_per_sample = bytes_to_int2_le(data_ + pos);
+            format_chunk_->valid_bits_per_sample = bytes_to_int2_le(fetch(pos, 2));
             pos += 2;
 
-            format_chunk_->channel_mask = bytes_to_int4_le(data_ + pos);
+            format_chunk_->channel_mask = bytes_to_int4_le(fetch(pos, 4));
             pos += 4;
 
-            memcpy(format_chunk_->sub_format, data_ + pos, 16);
+            memcpy(format_chunk_->sub_format, fetch(pos, 16), 16);
             pos += 16;
         }
     }
 
-    LOG(INFO) << *format_chunk_;
+    MFP_LOG(TRACE) << *format_chunk_;
     return 0;
 }
 
 int WavParser::parse_fact_chunk() {
-    LOG(DEBUG) << __FUNCTION__ ;
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
 
-    uint32_t pos = pos_;
+    size_t pos = pos_;
 
-    fact_chunk_ = new FactChunk;
+    fact_chunk_ = new FactChunk();
+    fact_chunk_->offset = pos;
 
-    memcpy(fact_chunk_->id, data_ + pos, 4);
+    memcpy(fact_chunk_->id, fetch(pos, 4), 4);
     pos += 4;
 
-    fact_chunk_->size = bytes_to_int4_le(data_ + pos);
+    fact_chunk_->size = bytes_to_int4_le(fetch(pos, 4));
     pos += 4;
 
-    fact_chunk_->sample_length = bytes_to_int4_le(data_ + pos);
+    fact_chunk_->sample_length = bytes_to_int4_le(fetch(pos, 4));
     pos += 4;
 
-    LOG(INFO) << *fact_chunk_;
+    MFP_LOG(TRACE) << *fact_chunk_;
     return 0;
 }
 
-int WavParser::parse_data_chunk() {
-    LOG(DEBUG) << __FUNCTION__ ;
+int WavParser::parse_data_chunk(bool read_pad_byte) {
+    MFP_TRACE_SCOPE(__FUNCTION__);
+    MFP_LOG(DEBUG) << __FUNCTION__ ;
 
-    uint32_t pos = pos_;
+    size_t pos = pos_;
 
-    data_chunk_ = new DataChunk;
+    data_chunk_ = new DataChunk();
+    data_chunk_->offset = pos;
 
-    memcpy(data_chunk_->id, data_ + pos, 4);
+    memcpy(data_chunk_->id, fetch(pos, 4), 4);
     pos += 4;
 
     if (std::string(data_chunk_->id, 4) != DATA_ID) {
@@ -260,67 +420,96 @@ int WavParser::parse_data_chunk() {
         return -1;
     }
 
-    data_chunk_->size = bytes_to_int4_le(data_ + pos);
+    data_chunk_->size = get_chunk_size(data_chunk_->offset);
     pos += 4;
 
-    data_chunk_->data = new(std::nothrow) unsigned char[data_chunk_->size];
-    if (data_chunk_->data == nullptr) {
-        LOG(ERROR) << "alloc memory failed";
-        return -2;
-    }
-
-    memcpy(data_chunk_->data, data_ + pos, data_chunk_->size);
+    // 只记录音频数据的位置, dump 时再按窗口读取
+    data_chunk_->data_pos = pos;
     pos += data_chunk_->size;
 
-    if (data_chunk_->size % 2) {
-        data_chunk_->pad_byte = int_value(*(data_ + pos));
+    if (read_pad_byte && data_chunk_->size % 2) {
+        data_chunk_->pad_byte = byte_at(pos);
         pos += 1;
     }
 
-    LOG(INFO) << *data_chunk_;
+    MFP_LOG(TRACE) << *data_chunk_;
     return 0;
 }
 
 int WavParser::dump_info() {
     std::string file_path = get_output_path() + ".txt";
-    std::ofstream file(file_path);
-    if (!file.is_open()) {
+    TextWriter file;
+    if (file.open(file_path) < 0) {
+        return -1;
+    }
+
+    if (header_chunk_) {
+        file << *header_chunk_ << '\n';
+    }
+    if (ds64_chunk_) {
+        file << *ds64_chunk_ << '\n';
+    }
+    if (format_chunk_) {
+        file << *format_chunk_ << '\n';
+    }
+    if (fact_chunk_) {
+        file << *fact_chunk_ << '\n';
+    }
+    if (data_chunk_) {
+        file << *data_chunk_ << '\n';
+    }
+    add_bytes_written(file.bytes_written());
+    if (file.close() < 0) {
         return -1;
     }
+    MFP_LOG(INFO) << "file info has dumped to " << file_path;
+    return 0;
+}
 
+int WavParser::dump_report(ReportWriter& writer) {
+    writer.write(FileRecord{"wav", file_path_, data_size_});
     if (header_chunk_) {
-        file << *header_chunk_ << std::endl;
+        writer.write(WavChunkRecord{std::string_view(header_chunk_->id, 4), 0, header_chunk_->size});
+    }
+    if (ds64_chunk_) {
+        writer.write(WavChunkRecord{std::string_view(ds64_chunk_->id, 4), ds64_chunk_->offset, ds64_chunk_->size});
     }
     if (format_chunk_) {
-        file << *format_chunk_ << std::endl;
+        const FormatChunk& c = *format_chunk_;
+        writer.write(WavChunkRecord{std::string_view(c.id, 4), c.offset, c.size});
+        writer.write(WavFormatRecord{c.audio_format, c.channels, c.sample_rate, c.byte_rate, c.block_align,
+                                     c.bits_per_sample, c.valid_bits_per_sample, c.channel_mask});
     }
     if (fact_chunk_) {
-        file << *fact_chunk_ << std::endl;
+        writer.write(WavChunkRecord{std::string_view(fact_chunk_->id, 4), fact_chunk_->offset, fact_chunk_->size});
     }
     if (data_chunk_) {
-        file << *data_chunk_ << std::endl;
+        writer.write(WavChunkRecord{std::string_view(data_chunk_->id, 4), data_chunk_->offset, data_chunk_->size});
     }
-    file.close();
-    LOG(INFO) << "file info has dumped to " << file_path;
     return 0;
 }
 
 int WavParser::dump_data() {
-    if (data_chunk_->data == nullptr) {
+    if (data_chunk_ == nullptr) {
         LOG(ERROR) << "no data to dump";
         return -1;
     }
-    std::string dump_file_name = get_filename_without_extension(file_path_) + ".pcm";
-    std::string file_path = get_output_dir() + dump_file_name;
-    int ret = write_data(file_path, data_chunk_->data, data_chunk_->size);
+    std::string file_path = get_output_path() + ".pcm";
+    std::ofstream out(file_path, std::ios::binary);
+    if (!out) {
+        return -1;
+    }
+    int ret = write_range(out, data_chunk_->data_pos, data_chunk_->size);
+    add_bytes_written(out);
+    out.close();
     if (ret == 0) {
-        LOG(INFO) << "data has dumped to " << file_path;
+        MFP_LOG(INFO) << "data has dumped to " << file_path;
     }
     return ret;
 }
 
 void WavParser::print_ffplay_command() {
-    std::string dump_file_name = get_filename_without_extension(file_path_) + ".pcm";
+    std::string dump_file_name = get_output_path() + ".pcm";
     int audio_format = format_chunk_->audio_format;
     int bit_depth = format_chunk_->bits_per_sample;
 
@@ -351,8 +540,8 @@ void WavParser::print_ffplay_command() {
         format_str = "mulaw";
     }
 
-    LOG(INFO) << "ffplay command:";
-    LOG(INFO) << "ffplay -autoexit -f " << format_str << " -ar " << format_chunk_->sample_rate << " -ac "
+    MFP_LOG(INFO) << "ffplay command:";
+    MFP_LOG(INFO) << "ffplay -autoexit -f " << format_str << " -ar " << format_chunk_->sample_rate << " -ac "
         << format_chunk_->channels << " " << dump_file_name;
 
 }
@@ -3,6 +3,8 @@
 //
 
 // ref: https://www.mmsp.ece.mcgill.ca/Documents/AudioFormats/WAVE/WAVE.html
+// RF64: EBU Tech 3306, 超过 4 GB 的文件把 RIFF/data 的 size 写为 0xFFFFFFFF, 实际大小在 ds64 chunk 中
+// todo addf8-GSM-GW.wav gsm数据适配
 
 #ifndef MEDIAFORMATPARSER_WAVPARSER_H
 #define MEDIAFORMATPARSER_WAVPARSER_H
@@ -14,6 +16,8 @@
 #include "Parser.h"
 
 #define HEAD_CHUNK_SIZE 12
+#define DS64_CHUNK_MIN_SIZE 28
+#define RF64_SIZE_IN_DS64 0xFFFFFFFF
 
 #define WAVE_FORMAT_PCM 0x0001
 #define WAVE_FORMAT_IEEE_FLOAT 0x0003
@@ -24,6 +28,8 @@
 #define WAVE_TAG "WAVE"
 
 #define RIFF_ID "RIFF"
+#define RF64_ID "RF64"
+#define DS64_ID "ds64"
 #define FMT_ID "fmt "
 #define FACT_ID "fact"
 #define DATA_ID "data"
@@ -34,6 +40,16 @@ struct HeaderChunk {
     char type[4];
 };
 
+struct Ds64Chunk {
+    char id[4];
+    uint32_t size;
+    uint64_t riff_size;
+    uint64_t data_size;
+    uint64_t sample_count;
+    uint32_t table_length;
+    size_t offset = 0; // chunk 在文件中的偏移
+};
+
 struct FormatChunk {
     char id[4];
     uint32_t size;
@@ -47,19 +63,22 @@ struct FormatChunk {
     uint16_t valid_bits_per_sample;
     uint32_t channel_mask;
     char sub_format[16];
+    size_t offset = 0; // chunk 在文件中的偏移
 };
 
 struct FactChunk {
     char id[4];
     uint32_t size;
     uint32_t sample_length;
+    size_t offset = 0; // chunk 在文件中的偏移
 };
 
 struct DataChunk {
     char id[4];
-    uint32_t size;
-    unsigned char *data = nullptr;
+    uint64_t size;      // RF64 时为 ds64 中的实际大小
+    size_t data_pos = 0; // 音频数据在文件中的偏移
     uint8_t pad_byte = 0;
+    size_t offset = 0; // chunk 在文件中的偏移
 };
 
 struct AudioData {
@@ -77,13 +96,19 @@ private:
     int custom_parse() override;
     int dump_info() override;
     int dump_data() override;
+    int custom_probe() override;
+    int dump_report(ReportWriter& writer) override;
     int parse_header_chunk();
+    int parse_ds64_chunk();
+    uint64_t get_chunk_size(size_t pos);
     int parse_format_chunk();
     int parse_fact_chunk();
-    int parse_data_chunk();
+    int parse_data_chunk(bool read_pad_byte = true);
 
 private:
     HeaderChunk *header_chunk_ = nullptr;
+    Ds64Chunk *ds64_chunk_ = nullptr;
+    uint64_t riff_end_ = 0;
     FormatChunk *format_chunk_ = nullptr;
     FactChunk *fact_chunk_ = nullptr;
     DataChunk *data_chunk_ = nullptr;
@@ -1,76 +1,162 @@
-#include "WavParser.h"
-#include "M4aParser.h"
-#include "Mp3Parser.h"
-#include "FlvParser.h"
+#include "MediaFormat.h"
 
-#include <filesystem>
-#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-#define ELPP_NO_DEFAULT_LOG_FILE
-#define ELPP_THREAD_SAFE
-#include "logger/easylogging++.h"
-
-INITIALIZE_EASYLOGGINGPP
-
-void init_easyloggingpp() {
-    el::Configurations conf;
-    conf.setToDefault();
+void print_usage(const char* name) {
+    std::cout << "usage: " << name << " [-j threads] [--decode-threads n] [--scan-threads n] [--window bytes] [--probe] [--attachments] [--quiet] [--sync-log] [--log-drop] [--report json|binary] [--stats] [--trace trace.json] [--metrics file.prom] [--metrics-interval ms] [--list list_file] [file|dir]..." << std::endl;
+}
 
-    // 禁用写入日志文件
-    conf.set(el::Level::Global, el::ConfigurationType::ToFile, "false");
-    // 启用输出到控制台
-    conf.set(el::Level::Global, el::ConfigurationType::ToStandardOutput, "true");
-    // 格式化日志
-    conf.set(el::Level::Global, el::ConfigurationType::Format,
-             "[%datetime] [%level] %msg");
-    // 日志颜色
-    conf.set(el::Level::Info, el::ConfigurationType::Format,
-             "\033[32m[%datetime] [%level] %msg\033[0m");  // 绿
-    conf.set(el::Level::Warning, el::ConfigurationType::Format,
-             "\033[33m[%datetime] [%level] %msg\033[0m");  // 黄
-    conf.set(el::Level::Error, el::ConfigurationType::Format,
-             "\033[31m[%datetime] [%level] %msg\033[0m");  // 红
-    conf.set(el::Level::Fatal, el::ConfigurationType::Format,
-             "\033[31m[%datetime] [%level] %msg\033[0m");  // 红
-    el::Loggers::reconfigureAllLoggers(conf);
+// 解析非负整数参数, 格式错误或越界时返回 -1
+int parse_number(const char* str, size_t max_value, size_t& value) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long number = strtoull(str, &end, 10);
+    if (str[0] < '0' || str[0] > '9' || *end != '\0' || errno == ERANGE || number > max_value) {
+        return -1;
+    }
+    value = static_cast<size_t>(number);
+    return 0;
 }
 
+int run_batch(int argc, char** argv) {
+    size_t thread_count = 0;
+    size_t decode_threads = 1;
+    size_t scan_threads = 1;
+    size_t stream_window = 0;
+    bool probe_only = false;
+    bool dump_attachments = false;
+    bool async_log = true;
+    bool log_stats = false;
+    std::string trace_path;
+    std::string metrics_path;
+    size_t metrics_interval_ms = METRICS_DEFAULT_INTERVAL_MS;
+    AsyncLogPolicy log_policy = ASYNC_LOG_BLOCK;
+    ReportFormat report_format = REPORT_NONE;
+    std::vector<std::string> paths;
+    std::vector<std::string> list_files;
 
-// todo addf8-GSM-GW.wav gsm数据适配
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            if (parse_number(argv[++i], SIZE_MAX, thread_count) < 0) {
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--decode-threads") == 0 && i + 1 < argc) {
+            if (parse_number(argv[++i], SIZE_MAX, decode_threads) < 0) {
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--scan-threads") == 0 && i + 1 < argc) {
+            if (parse_number(argv[++i], SIZE_MAX, scan_threads) < 0) {
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            if (parse_number(argv[++i], SIZE_MAX, stream_window) < 0) {
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--probe") == 0) {
+            probe_only = true;
+        } else if (strcmp(argv[i], "--attachments") == 0) {
+            dump_attachments = true;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            set_log_quiet(true);
+        } else if (strcmp(argv[i], "--sync-log") == 0) {
+            async_log = false;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+            if (parse_number(argv[++i], UINT32_MAX, metrics_interval_ms) < 0) {
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            log_stats = true;
+        } else if (strcmp(argv[i], "--log-drop") == 0) {
+            log_policy = ASYNC_LOG_DROP;
+        } else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "json") == 0) {
+                report_format = REPORT_JSON;
+            } else if (strcmp(argv[i], "binary") == 0) {
+                report_format = REPORT_BINARY;
+            } else {
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--list") == 0 && i + 1 < argc) {
+            list_files.emplace_back(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            print_usage(argv[0]);
+            return -1;
+        } else {
+            paths.emplace_back(argv[i]);
+        }
+    }
 
-void test_wave_parser() {
-    std::string normal_file_path = "/Users/yuhong/Desktop/MediaFormatParser/test_files/wav/normal/";
-    WavParser wav_parser(normal_file_path + "drmapan.wav");
-    assert(wav_parser.parse() == 0);
-    wav_parser.print_ffplay_command();
-}
+    BatchParser batch_parser(thread_count);
+    batch_parser.set_probe_only(probe_only);
+    batch_parser.set_report_format(report_format);
+    batch_parser.set_log_stats(log_stats);
+    batch_parser.set_metrics_enabled(!metrics_path.empty());
+    batch_parser.set_decode_threads(decode_threads);
+    batch_parser.set_scan_threads(scan_threads);
+    batch_parser.set_stream_window(stream_window);
+    batch_parser.set_dump_attachments(dump_attachments);
+    for (auto& path: paths) {
+        batch_parser.add_path(path);
+    }
+    for (auto& list_file: list_files) {
+        batch_parser.add_list_file(list_file);
+    }
 
-void test_m4a_parser() {
-    std::string file_path = "/Users/yuhong/Desktop/MediaFormatParser/test_files/m4a/";
-    M4aParser m4a_parser(file_path + "1718873863_sample1.m4a");
-    assert(m4a_parser.parse() == 0);
-}
-
-void test_mp3_parser() {
-    std::string file_path = "/Users/yuhong/Desktop/MediaFormatParser/test_files/mp3/";
-    Mp3Parser mp3_parser(file_path + "jay.mp3");
-    assert(mp3_parser.parse() == 0);
-}
+    // 多线程解析时日志由后台线程写出, 解析线程不在控制台 I/O 上排队
+    if (async_log) {
+        AsyncLogSink::instance().start(log_policy);
+    }
+    if (!trace_path.empty()) {
+        Tracer::instance().start(trace_path);
+    }
+    if (!metrics_path.empty()) {
+        MetricsRegistry::instance().start_textfile_writer(metrics_path, static_cast<uint32_t>(metrics_interval_ms));
+    }
+    std::vector<BatchResult> results = batch_parser.run();
+    MetricsRegistry::instance().stop_textfile_writer();
+    Tracer::instance().stop();
+    AsyncLogSink::instance().stop();
 
-void test_flv_parser() {
-    std::string file_path = "/Users/yuhong/Desktop/MediaFormatParser/test_files/flv/";
-    FlvParser flv_parser(file_path + "video.flv");
-    assert(flv_parser.parse() == 0);
+    int failed = 0;
+    for (auto& result: results) {
+        if (result.ret != 0) {
+            failed++;
+            std::cout << result.file_path << "\tERROR\t" << result.ret << "\t" << result.error << std::endl;
+        } else if (probe_only) {
+            const StreamInfo& info = result.info;
+            std::cout << result.file_path << "\t" << info.format
+                << "\tduration=" << info.duration
+                << "\tsample_rate=" << info.sample_rate
+                << "\tchannels=" << info.channels
+                << "\tbit_rate=" << info.bit_rate
+                << "\tsize=" << info.width << "x" << info.height << std::endl;
+        }
+    }
+    return failed == 0 ? 0 : 1;
 }
 
-int main() {
-    init_easyloggingpp();
-    // test_wave_parser();
-     test_m4a_parser();
-//    test_mp3_parser();
-//    test_flv_parser();
-    return 0;
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    init_console_log();
+    return run_batch(argc, argv);
 }
 
 
@@ -65,6 +65,10 @@ uint16_t bytes_to_int2_be(const unsigned char* data) {
            (static_cast<uint8_t>(data[1]));
 }
 
+uint64_t bytes_to_int8_le(const unsigned char* data) {
+    return (static_cast<uint64_t>(bytes_to_int4_le(data + 4)) << 32) | bytes_to_int4_le(data);
+}
+
 uint32_t bytes_to_int4_le(const unsigned char* data) {
     return (static_cast<uint8_t>(data[3]) << 24) |
            (static_cast<uint8_t>(data[2]) << 16) |
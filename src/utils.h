@@ -32,6 +32,8 @@ uint32_t bytes_to_int3_be(const unsigned char* data);
 
 uint16_t bytes_to_int2_be(const unsigned char* data);
 
+uint64_t bytes_to_int8_le(const unsigned char* data);
+
 uint32_t bytes_to_int4_le(const unsigned char* data);
 
 uint32_t bytes_to_int3_le(const unsigned char* data);
@@ -0,0 +1,582 @@
+#include "MediaGen.h"
+
+const uint32_t mp3_bit_rates[15] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+
+int gen_wav(const GenOptions& opt, GenWriter& out) {
+    uint16_t block_align = opt.channels * (opt.bits / 8);
+    if (block_align == 0) {
+        fprintf(stderr, "invalid channels/bits\n");
+        return -1;
+    }
+    uint64_t data_size = opt.size / block_align * block_align;
+    uint64_t pad = data_size % 2;
+    uint64_t riff_size = 4 + (8 + 16) + 8 * opt.junk_chunks + (8 + data_size + pad);
+    bool rf64 = riff_size > UINT32_MAX;
+    if (rf64) {
+        riff_size += 8 + 28;
+    }
+
+    out.put_tag(rf64 ? "RF64" : "RIFF");
+    out.put_le(rf64 ? UINT32_MAX : riff_size, 4);
+    out.put_tag("WAVE");
+    if (rf64) {
+        out.put_tag("ds64");
+        out.put_le(28, 4);
+        out.put_le(riff_size, 8);
+        out.put_le(data_size, 8);
+        out.put_le(data_size / block_align, 8);
+        out.put_le(0, 4);  // table length
+    }
+
+    out.put_tag("fmt ");
+    out.put_le(16, 4);
+    out.put_le(1, 2);  // PCM
+    out.put_le(opt.channels, 2);
+    out.put_le(GEN_SAMPLE_RATE, 4);
+    out.put_le(GEN_SAMPLE_RATE * block_align, 4);
+    out.put_le(block_align, 2);
+    out.put_le(opt.bits, 2);
+
+    for (uint64_t i = 0; i < opt.junk_chunks; ++i) {
+        out.put_tag("junk");
+        out.put_le(0, 4);
+    }
+
+    out.put_tag("data");
+    out.put_le(rf64 ? UINT32_MAX : data_size, 4);
+    out.put_payload(data_size);
+    out.put_zero(pad);
+
+    if (!opt.quiet) {
+        printf("wav%s: %llu bytes of samples, %.1f s\n", rf64 ? " (rf64)" : "",
+               static_cast<unsigned long long>(data_size), static_cast<double>(data_size) / block_align / GEN_SAMPLE_RATE);
+    }
+    return 0;
+}
+
+static int mp3_bit_rate_index(uint32_t bit_rate) {
+    for (int i = 1; i < 15; ++i) {
+        if (mp3_bit_rates[i] == bit_rate) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 逐帧给出码率索引和 padding, 与编码器一致用累计余数决定 padding, 使平均码率准确
+class Mp3FrameSizer {
+public:
+    Mp3FrameSizer(const GenOptions& opt, int cbr_index): opt_(opt), cbr_index_(cbr_index), random_(opt.seed) {}
+
+    uint32_t next(int& index, int& padding) {
+        index = opt_.vbr ? static_cast<int>(random_.range(5, 14)) : cbr_index_;
+        uint32_t bytes = 144 * mp3_bit_rates[index] * 1000;
+        uint32_t frame_size = bytes / GEN_SAMPLE_RATE;
+        remainder_ += bytes % GEN_SAMPLE_RATE;
+        padding = 0;
+        if (remainder_ >= GEN_SAMPLE_RATE) {
+            remainder_ -= GEN_SAMPLE_RATE;
+            padding = 1;
+        }
+        return frame_size + padding;
+    }
+
+private:
+    const GenOptions& opt_;
+    int cbr_index_;
+    Random random_;
+    uint32_t remainder_ = 0;
+};
+
+// 第一帧为 128 kbps 的静音帧, 负载中依次为 side information (全 0), Xing/Info 头, LAME 扩展
+static void put_xing_frame(const GenOptions& opt, GenWriter& out, int cbr_index) {
+    // 先算出音频总字节数, 再算出每 1% 帧数对应的字节位置
+    uint64_t total = GEN_XING_FRAME_SIZE;
+    {
+        Mp3FrameSizer sizer(opt, cbr_index);
+        int index, padding;
+        for (uint64_t i = 0; i < opt.frames; ++i) {
+            total += sizer.next(index, padding);
+        }
+    }
+    unsigned char toc[100];
+    {
+        Mp3FrameSizer sizer(opt, cbr_index);
+        int index, padding;
+        uint64_t offset = GEN_XING_FRAME_SIZE;
+        int percent = 0;
+        for (uint64_t i = 0; i < opt.frames && percent < 100; ++i) {
+            while (percent < 100 && i >= opt.frames * percent / 100) {
+                toc[percent++] = static_cast<unsigned char>(std::min<uint64_t>(offset * 256 / total, 255));
+            }
+            offset += sizer.next(index, padding);
+        }
+        while (percent < 100) {
+            toc[percent++] = 255;
+        }
+    }
+
+    const unsigned char header[4] = {0xFF, 0xFB, 0x90, 0x64};
+    out.write(header, 4);
+    out.put_zero(32);
+    out.put_tag(opt.vbr ? "Xing" : "Info");
+    out.put_be(0x0F, 4);     // frames, bytes, TOC, quality
+    out.put_be(opt.frames, 4);
+    out.put_be(total, 4);
+    out.write(toc, sizeof(toc));
+    out.put_be(50, 4);
+    out.write("LAME3.100", 9);
+    out.put_zero(12);        // 版本/VBR 方式, lowpass, replay gain, 编码标志, 码率
+    out.put_u8(GEN_LAME_DELAY >> 4);
+    out.put_u8(((GEN_LAME_DELAY & 0x0F) << 4) | (GEN_LAME_PADDING >> 8));
+    out.put_u8(GEN_LAME_PADDING & 0xFF);
+    out.put_zero(GEN_XING_FRAME_SIZE - 4 - 32 - 8 - 8 - sizeof(toc) - 4 - 9 - 12 - 3);
+}
+
+int gen_mp3(const GenOptions& opt, GenWriter& out) {
+    int cbr_index = mp3_bit_rate_index(opt.bit_rate);
+    if (!opt.vbr && cbr_index < 0) {
+        fprintf(stderr, "unsupported bit rate %u\n", opt.bit_rate);
+        return -1;
+    }
+
+    if (opt.id3) {
+        // 空的 ID3v2.3 标签, 只有填充
+        const unsigned char header[6] = {'I', 'D', '3', 3, 0, 0};
+        out.write(header, sizeof(header));
+        for (int i = 3; i >= 0; --i) {
+            out.put_u8((GEN_ID3V2_PADDING >> (7 * i)) & 0x7F);
+        }
+        out.put_zero(GEN_ID3V2_PADDING);
+    }
+
+    // 不含 0xFF, 需要逐字节查找同步字
+    out.put_payload(opt.junk, 0x7F);
+
+    if (opt.xing) {
+        put_xing_frame(opt, out, cbr_index);
+    }
+
+    Mp3FrameSizer sizer(opt, cbr_index);
+    uint64_t audio_bytes = 0;
+    for (uint64_t i = 0; i < opt.frames; ++i) {
+        int index, padding;
+        uint32_t frame_size = sizer.next(index, padding);
+
+        // MPEG1, Layer III, 无 CRC; 44100 Hz; joint stereo
+        out.put_u8(0xFF);
+        out.put_u8(0xFB);
+        out.put_u8((index << 4) | (0 << 2) | (padding << 1));
+        out.put_u8(0x64);
+        // 负载字节最高位清零, 不会出现伪同步字
+        out.put_payload(frame_size - 4, 0x7F);
+        audio_bytes += frame_size;
+    }
+
+    if (opt.id3) {
+        out.put_tag("TAG ");
+        out.put_zero(GEN_ID3V1_SIZE - 4);
+    }
+
+    double duration = static_cast<double>(opt.frames) * 1152 / GEN_SAMPLE_RATE;
+    if (!opt.quiet) {
+        printf("mp3 (%s): %llu frames, %.1f s, average %.1f kbps\n", opt.vbr ? "vbr" : "cbr",
+               static_cast<unsigned long long>(opt.frames), duration, audio_bytes * 8 / duration / 1000);
+    }
+    return 0;
+}
+
+static void put_amf_key(GenWriter& out, const char* key) {
+    out.put_be(strlen(key), 2);
+    out.write(key, strlen(key));
+}
+
+static void put_amf_number(GenWriter& out, const char* key, double value) {
+    put_amf_key(out, key);
+    out.put_u8(0);
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    out.put_be(bits, 8);
+}
+
+static void put_amf_bool(GenWriter& out, const char* key, bool value) {
+    put_amf_key(out, key);
+    out.put_u8(1);
+    out.put_u8(value);
+}
+
+// 返回 tag 总长度 (11 + data_size), 写入 previous tag size 时使用
+static uint32_t put_flv_tag_header(GenWriter& out, uint8_t type, uint32_t data_size, uint32_t timestamp) {
+    out.put_u8(type);
+    out.put_be(data_size, 3);
+    out.put_be(timestamp & 0xFFFFFF, 3);
+    out.put_u8(timestamp >> 24);
+    out.put_be(0, 3);
+    return 11 + data_size;
+}
+
+int gen_flv(const GenOptions& opt, GenWriter& out) {
+    if (opt.keyframe_interval == 0 || opt.video_size < 16 || opt.audio_size < 8) {
+        fprintf(stderr, "invalid flv options\n");
+        return -1;
+    }
+
+    // 按交错规则预先算出音视频 tag 数量和时长, 写入 onMetaData
+    uint64_t video_tags = 0;
+    uint64_t audio_tags = 0;
+    for (uint64_t i = 0; i < opt.tags; ++i) {
+        uint64_t video_ts = video_tags * 1000 / GEN_FLV_FRAME_RATE;
+        uint64_t audio_ts = audio_tags * GEN_AAC_FRAME_SAMPLES * 1000 / GEN_SAMPLE_RATE;
+        if (video_ts <= audio_ts) {
+            video_tags++;
+        } else {
+            audio_tags++;
+        }
+    }
+    double duration = static_cast<double>(video_tags) / GEN_FLV_FRAME_RATE;
+
+    out.write("FLV", 3);
+    out.put_u8(1);
+    out.put_u8(0x05);  // 音频 + 视频
+    out.put_be(9, 4);
+    out.put_be(0, 4);
+
+    // onMetaData: AMF0 string + ECMA array
+    const int meta_count = 8;
+    uint32_t meta_size = 3 + 10 + 1 + 4 + 3;
+    const char* number_keys[] = {"duration", "width", "height", "framerate", "videocodecid",
+                                 "audiosamplerate", "audiocodecid"};
+    for (auto key: number_keys) {
+        meta_size += 2 + strlen(key) + 1 + 8;
+    }
+    meta_size += 2 + strlen("stereo") + 1 + 1;
+    uint32_t previous = put_flv_tag_header(out, 18, meta_size, 0);
+    out.put_u8(2);
+    put_amf_key(out, "onMetaData");
+    out.put_u8(8);
+    out.put_be(meta_count, 4);
+    put_amf_number(out, "duration", duration);
+    put_amf_number(out, "width", 1280);
+    put_amf_number(out, "height", 720);
+    put_amf_number(out, "framerate", GEN_FLV_FRAME_RATE);
+    put_amf_number(out, "videocodecid", 7);
+    put_amf_number(out, "audiosamplerate", GEN_SAMPLE_RATE);
+    put_amf_number(out, "audiocodecid", 10);
+    put_amf_bool(out, "stereo", true);
+    out.put_be(9, 3);  // object end
+    out.put_be(previous, 4);
+
+    // AVC 序列头: AVCDecoderConfigurationRecord, 一个 SPS 和一个 PPS
+    const unsigned char sps[] = {0x67, 0x64, 0x00, 0x1F, 0xAC, 0xD9, 0x40, 0x50, 0x05, 0xBB, 0x01, 0x10};
+    const unsigned char pps[] = {0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0};
+    previous = put_flv_tag_header(out, 9, 5 + 6 + 2 + sizeof(sps) + 1 + 2 + sizeof(pps), 0);
+    out.put_u8(0x17);
+    out.put_u8(0);
+    out.put_be(0, 3);
+    const unsigned char avc_config[] = {1, 0x64, 0x00, 0x1F, 0xFF, 0xE1};
+    out.write(avc_config, sizeof(avc_config));
+    out.put_be(sizeof(sps), 2);
+    out.write(sps, sizeof(sps));
+    out.put_u8(1);
+    out.put_be(sizeof(pps), 2);
+    out.write(pps, sizeof(pps));
+    out.put_be(previous, 4);
+
+    // AAC 序列头: AudioSpecificConfig, AAC LC 44100 Hz 双声道
+    previous = put_flv_tag_header(out, 8, 4, 0);
+    out.put_u8(0xAF);
+    out.put_u8(0);
+    out.put_u8(0x12);
+    out.put_u8(0x10);
+    out.put_be(previous, 4);
+
+    Random random(opt.seed);
+    uint64_t video_index = 0;
+    uint64_t audio_index = 0;
+    uint64_t keyframes = 0;
+    for (uint64_t i = 0; i < opt.tags; ++i) {
+        uint32_t video_ts = video_index * 1000 / GEN_FLV_FRAME_RATE;
+        uint32_t audio_ts = audio_index * GEN_AAC_FRAME_SAMPLES * 1000 / GEN_SAMPLE_RATE;
+        if (video_ts <= audio_ts) {
+            bool keyframe = video_index % opt.keyframe_interval == 0;
+            // 关键帧按 video_size, 其余帧约为四分之一, 各自上下浮动 25%
+            uint32_t base = keyframe ? opt.video_size : std::max<uint32_t>(opt.video_size / 4, 16);
+            uint32_t nalu_size = random.range(base - base / 4, base + base / 4);
+            previous = put_flv_tag_header(out, 9, 5 + 4 + nalu_size, video_ts);
+            out.put_u8(keyframe ? 0x17 : 0x27);
+            out.put_u8(1);
+            out.put_be(0, 3);
+            out.put_be(nalu_size, 4);
+            out.put_u8(keyframe ? 0x65 : 0x41);
+            out.put_payload(nalu_size - 1);
+            video_index++;
+            keyframes += keyframe;
+        } else {
+            uint32_t size = random.range(opt.audio_size - opt.audio_size / 4, opt.audio_size + opt.audio_size / 4);
+            previous = put_flv_tag_header(out, 8, 2 + size, audio_ts);
+            out.put_u8(0xAF);
+            out.put_u8(1);
+            out.put_payload(size);
+            audio_index++;
+        }
+        out.put_be(previous, 4);
+    }
+
+    if (!opt.quiet) {
+        printf("flv: %llu video tags (%llu keyframes), %llu audio tags, %.1f s\n",
+               static_cast<unsigned long long>(video_index), static_cast<unsigned long long>(keyframes),
+               static_cast<unsigned long long>(audio_index), duration);
+    }
+    return 0;
+}
+
+static uint32_t mp4_sample_size(const GenOptions& opt, Random& random) {
+    if (opt.sample_size != 0) {
+        return opt.sample_size;
+    }
+    // 约 128 kbps 的 AAC 帧
+    return random.range(300, 450);
+}
+
+static void put_atom_header(GenWriter& out, uint64_t size, const char* type) {
+    out.put_be(size, 4);
+    out.put_tag(type);
+}
+
+static void put_full_atom_header(GenWriter& out, uint64_t size, const char* type) {
+    put_atom_header(out, size, type);
+    out.put_be(0, 4);  // version + flags
+}
+
+static void put_matrix(GenWriter& out) {
+    const uint32_t matrix[9] = {0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000};
+    for (uint32_t v: matrix) {
+        out.put_be(v, 4);
+    }
+}
+
+int gen_mp4(const GenOptions& opt, GenWriter& out) {
+    if (opt.samples == 0 || opt.samples > UINT32_MAX || opt.samples_per_chunk == 0) {
+        fprintf(stderr, "invalid mp4 options\n");
+        return -1;
+    }
+    uint64_t samples = opt.samples;
+    uint64_t chunks = (samples + opt.samples_per_chunk - 1) / opt.samples_per_chunk;
+    uint32_t last_chunk_samples = samples - (chunks - 1) * opt.samples_per_chunk;
+
+    // 第一遍只计算 mdat 大小, 决定是否需要 64 位偏移
+    uint64_t payload_size = 0;
+    {
+        Random random(opt.seed);
+        for (uint64_t i = 0; i < samples; ++i) {
+            payload_size += mp4_sample_size(opt, random);
+        }
+    }
+
+    const uint64_t ftyp_size = 8 + 8 + 4 * 3;
+    const uint64_t mvhd_size = 8 + 100;
+    const uint64_t tkhd_size = 8 + 84;
+    const uint64_t mdhd_size = 8 + 24;
+    const char handler_name[] = "SoundHandler";
+    const uint64_t hdlr_size = 8 + 24 + sizeof(handler_name);
+    const uint64_t smhd_size = 8 + 8;
+    const uint64_t dinf_size = 8 + (8 + 8 + 12);
+    const uint64_t stsd_size = 8 + 8 + 36;
+    const uint64_t stts_size = 8 + 8 + 8;
+    uint32_t stsc_entries = last_chunk_samples == opt.samples_per_chunk ? 1 : 2;
+    uint64_t stsc_size = 8 + 8 + 12 * stsc_entries;
+    uint64_t stsz_size = 8 + 12 + 4 * samples;
+    uint64_t stco_size_32 = 8 + 8 + 4 * chunks;
+    uint64_t stco_size_64 = 8 + 8 + 8 * chunks;
+
+    const uint64_t udta_size = 8 + (8 + 8);
+    bool large_mdat = payload_size + 8 > UINT32_MAX;
+    uint64_t mdat_header_size = large_mdat ? 16 : 8;
+    auto moov_size_for = [&](uint64_t stco_size) {
+        uint64_t stbl = 8 + stsd_size + stts_size + stsc_size + stsz_size + stco_size;
+        uint64_t minf = 8 + smhd_size + dinf_size + stbl;
+        uint64_t mdia = 8 + mdhd_size + hdlr_size + minf;
+        uint64_t trak = 8 + tkhd_size + mdia;
+        return 8 + mvhd_size + trak + udta_size * opt.udta_atoms;
+    };
+    bool co64 = ftyp_size + moov_size_for(stco_size_32) + mdat_header_size + payload_size > UINT32_MAX;
+    uint64_t stco_size = co64 ? stco_size_64 : stco_size_32;
+    uint64_t stbl_size = 8 + stsd_size + stts_size + stsc_size + stsz_size + stco_size;
+    uint64_t minf_size = 8 + smhd_size + dinf_size + stbl_size;
+    uint64_t mdia_size = 8 + mdhd_size + hdlr_size + minf_size;
+    uint64_t trak_size = 8 + tkhd_size + mdia_size;
+    uint64_t moov_size = 8 + mvhd_size + trak_size + udta_size * opt.udta_atoms;
+    if (moov_size > UINT32_MAX) {
+        fprintf(stderr, "too many samples for a 32-bit moov\n");
+        return -1;
+    }
+    uint64_t data_start = ftyp_size + moov_size + mdat_header_size;
+
+    uint64_t total_samples = samples * GEN_AAC_FRAME_SAMPLES;
+    uint32_t media_duration = std::min<uint64_t>(total_samples, UINT32_MAX);
+    uint32_t movie_duration = std::min<uint64_t>(total_samples * 1000 / GEN_SAMPLE_RATE, UINT32_MAX);
+
+    put_atom_header(out, ftyp_size, "ftyp");
+    out.put_tag("isom");
+    out.put_be(0x200, 4);
+    out.put_tag("isom");
+    out.put_tag("iso2");
+    out.put_tag("mp41");
+
+    put_atom_header(out, moov_size, "moov");
+    put_full_atom_header(out, mvhd_size, "mvhd");
+    out.put_be(0, 4);  // creation time
+    out.put_be(0, 4);  // modification time
+    out.put_be(1000, 4);
+    out.put_be(movie_duration, 4);
+    out.put_be(0x10000, 4);  // preferred rate 1.0
+    out.put_be(0x100, 2);    // preferred volume 1.0
+    out.put_zero(10);
+    put_matrix(out);
+    out.put_zero(24);        // preview, poster, selection, current time
+    out.put_be(2, 4);        // next track id
+
+    put_atom_header(out, trak_size, "trak");
+    out.put_be(tkhd_size, 4);
+    out.put_tag("tkhd");
+    out.put_be(3, 4);        // version 0, flags enabled | in movie
+    out.put_be(0, 4);
+    out.put_be(0, 4);
+    out.put_be(1, 4);        // track id
+    out.put_be(0, 4);
+    out.put_be(movie_duration, 4);
+    out.put_zero(8);
+    out.put_be(0, 2);        // layer
+    out.put_be(0, 2);        // alternate group
+    out.put_be(0x100, 2);    // volume
+    out.put_be(0, 2);
+    put_matrix(out);
+    out.put_be(0, 4);        // width
+    out.put_be(0, 4);        // height
+
+    put_atom_header(out, mdia_size, "mdia");
+    put_full_atom_header(out, mdhd_size, "mdhd");
+    out.put_be(0, 4);
+    out.put_be(0, 4);
+    out.put_be(GEN_SAMPLE_RATE, 4);
+    out.put_be(media_duration, 4);
+    out.put_be(0x55C4, 2);   // language "und"
+    out.put_be(0, 2);
+
+    put_full_atom_header(out, hdlr_size, "hdlr");
+    out.put_be(0, 4);        // component type, ISO 中为 pre_defined
+    out.put_tag("soun");
+    out.put_zero(12);
+    out.write(handler_name, sizeof(handler_name));
+
+    put_atom_header(out, minf_size, "minf");
+    put_full_atom_header(out, smhd_size, "smhd");
+    out.put_be(0, 4);        // balance + reserved
+    put_atom_header(out, dinf_size, "dinf");
+    put_full_atom_header(out, 8 + 8 + 12, "dref");
+    out.put_be(1, 4);
+    out.put_be(12, 4);
+    out.put_tag("url ");
+    out.put_be(1, 4);        // 数据位于本文件
+
+    put_atom_header(out, stbl_size, "stbl");
+    put_full_atom_header(out, stsd_size, "stsd");
+    out.put_be(1, 4);
+    out.put_be(36, 4);
+    out.put_tag("mp4a");
+    out.put_zero(6);
+    out.put_be(1, 2);        // data reference index
+    out.put_zero(8);
+    out.put_be(2, 2);        // channels
+    out.put_be(16, 2);       // sample size
+    out.put_be(0, 2);
+    out.put_be(0, 2);
+    out.put_be(static_cast<uint64_t>(GEN_SAMPLE_RATE) << 16, 4);
+
+    put_full_atom_header(out, stts_size, "stts");
+    out.put_be(1, 4);
+    out.put_be(samples, 4);
+    out.put_be(GEN_AAC_FRAME_SAMPLES, 4);
+
+    put_full_atom_header(out, stsc_size, "stsc");
+    out.put_be(stsc_entries, 4);
+    out.put_be(1, 4);
+    out.put_be(opt.samples_per_chunk, 4);
+    out.put_be(1, 4);
+    if (stsc_entries == 2) {
+        out.put_be(chunks, 4);
+        out.put_be(last_chunk_samples, 4);
+        out.put_be(1, 4);
+    }
+
+    put_full_atom_header(out, stsz_size, "stsz");
+    out.put_be(0, 4);        // 每个 sample 单独给出大小
+    out.put_be(samples, 4);
+    {
+        Random random(opt.seed);
+        for (uint64_t i = 0; i < samples; ++i) {
+            out.put_be(mp4_sample_size(opt, random), 4);
+        }
+    }
+
+    put_full_atom_header(out, stco_size, co64 ? "co64" : "stco");
+    out.put_be(chunks, 4);
+    {
+        Random random(opt.seed);
+        uint64_t offset = data_start;
+        for (uint64_t i = 0; i < samples; ++i) {
+            if (i % opt.samples_per_chunk == 0) {
+                out.put_be(offset, co64 ? 8 : 4);
+            }
+            offset += mp4_sample_size(opt, random);
+        }
+    }
+
+    for (uint64_t i = 0; i < opt.udta_atoms; ++i) {
+        put_atom_header(out, udta_size, "udta");
+        put_atom_header(out, 8 + 8, "free");
+        out.put_zero(8);
+    }
+
+    if (large_mdat) {
+        put_atom_header(out, 1, "mdat");
+        out.put_be(payload_size + 16, 8);
+    } else {
+        put_atom_header(out, payload_size + 8, "mdat");
+    }
+    out.put_payload(payload_size);
+
+    if (!opt.quiet) {
+        printf("mp4: %llu samples in %llu chunks%s, %llu bytes of media data, %.1f s\n",
+               static_cast<unsigned long long>(samples), static_cast<unsigned long long>(chunks), co64 ? " (co64)" : "",
+               static_cast<unsigned long long>(payload_size), static_cast<double>(total_samples) / GEN_SAMPLE_RATE);
+    }
+    return 0;
+}
+
+int gen_file(const GenOptions& opt) {
+    int (*gen)(const GenOptions&, GenWriter&);
+    if (opt.format == "wav") {
+        gen = gen_wav;
+    } else if (opt.format == "mp3") {
+        gen = gen_mp3;
+    } else if (opt.format == "flv") {
+        gen = gen_flv;
+    } else if (opt.format == "mp4") {
+        gen = gen_mp4;
+    } else {
+        fprintf(stderr, "unsupported format %s\n", opt.format.c_str());
+        return -1;
+    }
+
+    GenWriter out;
+    if (out.open(opt.output, opt.seed, opt.sparse) < 0) {
+        return -1;
+    }
+    int ret = gen(opt, out);
+    if (out.close() < 0) {
+        fprintf(stderr, "write %s failed\n", opt.output.c_str());
+        return -1;
+    }
+    return ret;
+}
@@ -0,0 +1,249 @@
+//
+// 合成媒体文件生成器, 供 mfp_gen 和 bench 共用.
+// 相同参数和 seed 生成的文件逐字节相同. 大文件顺序写出, 负载内容由 seed 生成的 1 MB 块循环填充;
+// --sparse 时负载部分直接 lseek 跳过, 在支持稀疏文件的文件系统上几乎不占空间也不产生写 I/O.
+//   wav - PCM, 数据超过 4 GB 时按 EBU Tech 3306 写为 RF64 (ds64 chunk)
+//   mp3 - MPEG1 Layer III 44100 Hz 帧序列, CBR 或逐帧随机码率的 VBR, 可选 ID3v2/ID3v1 标签,
+//         可选在第一帧写入 Xing (VBR) 或 Info (CBR) 头及 LAME 扩展
+//   flv - onMetaData + AVC/AAC 序列头 + 按时间戳交错的音视频 tag, 关键帧间隔可配置
+//   mp4 - 单条 AAC 音轨, stsz 每个 sample 一项, stco 每个 chunk 一项, 偏移超过 4 GB 时改用 co64
+//
+
+#ifndef MEDIAFORMATPARSER_MEDIAGEN_H
+#define MEDIAFORMATPARSER_MEDIAGEN_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#define GEN_BUFFER_SIZE (1024 * 1024)
+#define GEN_PATTERN_SIZE (1024 * 1024)
+
+#define GEN_SAMPLE_RATE 44100
+#define GEN_AAC_FRAME_SAMPLES 1024
+#define GEN_FLV_FRAME_RATE 25
+#define GEN_ID3V2_PADDING 1024
+#define GEN_ID3V1_SIZE 128
+// Xing/Info 头所在帧 (128 kbps, 无 padding) 的长度, 以及 LAME 扩展中的 encoder delay/padding
+#define GEN_XING_FRAME_SIZE 417
+#define GEN_LAME_DELAY 576
+#define GEN_LAME_PADDING 1200
+
+// MPEG1 Layer III 码率表 (kbps), 下标为帧头中的 bitrate_index
+extern const uint32_t mp3_bit_rates[15];
+
+// xorshift64*, 保证不同平台生成相同的序列
+class Random {
+public:
+    explicit Random(uint64_t seed): state_(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    uint32_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return static_cast<uint32_t>((state_ * 0x2545F4914F6CDD1Dull) >> 32);
+    }
+
+    // [low, high] 内的整数
+    uint32_t range(uint32_t low, uint32_t high) {
+        return low + next() % (high - low + 1);
+    }
+
+private:
+    uint64_t state_;
+};
+
+struct GenOptions {
+    std::string format;
+    std::string output;
+    uint64_t seed = 1;
+    bool sparse = false;
+    // 不打印生成结果
+    bool quiet = false;
+    // wav
+    uint64_t size = 16 * 1024 * 1024;
+    uint16_t channels = 2;
+    uint16_t bits = 16;
+    // fmt 与 data 之间空的 junk chunk 数
+    uint64_t junk_chunks = 0;
+    // mp3
+    uint64_t frames = 10000;
+    uint32_t bit_rate = 128;
+    bool vbr = false;
+    bool id3 = false;
+    bool xing = false;
+    // 第一帧之前不含同步字的垃圾数据字节数
+    uint64_t junk = 0;
+    // flv
+    uint64_t tags = 10000;
+    uint32_t keyframe_interval = 50;
+    uint32_t video_size = 8192;
+    uint32_t audio_size = 256;
+    // mp4
+    uint64_t samples = 100000;
+    uint32_t samples_per_chunk = 16;
+    uint32_t sample_size = 0;
+    // trak 之后额外的 udta 容器数, 每个含一个 8 字节负载的 free atom
+    uint64_t udta_atoms = 0;
+};
+
+// 带缓冲的顺序写出, 负载部分从 seed 生成的图案块中取
+class GenWriter {
+public:
+    GenWriter(): buffer_(new char[GEN_BUFFER_SIZE]), pattern_(new char[GEN_PATTERN_SIZE]) {}
+
+    ~GenWriter() {
+        close();
+    }
+
+    int open(const std::string& file_path, uint64_t seed, bool sparse) {
+        fd_ = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            fprintf(stderr, "open %s failed: %s\n", file_path.c_str(), strerror(errno));
+            return -1;
+        }
+        sparse_ = sparse;
+        Random random(seed);
+        for (size_t i = 0; i < GEN_PATTERN_SIZE; i += 4) {
+            uint32_t v = random.next();
+            memcpy(pattern_.get() + i, &v, 4);
+        }
+        return 0;
+    }
+
+    // 写入失败时返回负数
+    int close() {
+        if (fd_ < 0) {
+            return failed_ ? -1 : 0;
+        }
+        flush();
+        // 稀疏写出时文件末尾可能是未写入的空洞
+        if (ftruncate(fd_, offset_) < 0 || ::close(fd_) < 0) {
+            failed_ = true;
+        }
+        fd_ = -1;
+        return failed_ ? -1 : 0;
+    }
+
+    uint64_t offset() const { return offset_; }
+
+    void write(const void* data, size_t len) {
+        const char* p = static_cast<const char *>(data);
+        while (len > 0) {
+            if (size_ == GEN_BUFFER_SIZE) {
+                flush();
+            }
+            size_t n = std::min(len, static_cast<size_t>(GEN_BUFFER_SIZE) - size_);
+            memcpy(buffer_.get() + size_, p, n);
+            size_ += n;
+            offset_ += n;
+            p += n;
+            len -= n;
+        }
+    }
+
+    void put_u8(uint8_t v) { write(&v, 1); }
+    void put_tag(const char* tag) { write(tag, 4); }
+
+    void put_be(uint64_t v, int n) {
+        unsigned char s[8];
+        for (int i = 0; i < n; ++i) {
+            s[i] = static_cast<unsigned char>(v >> (8 * (n - 1 - i)));
+        }
+        write(s, n);
+    }
+
+    void put_le(uint64_t v, int n) {
+        unsigned char s[8];
+        for (int i = 0; i < n; ++i) {
+            s[i] = static_cast<unsigned char>(v >> (8 * i));
+        }
+        write(s, n);
+    }
+
+    void put_zero(size_t len) {
+        static const char zero[64] = {0};
+        while (len > 0) {
+            size_t n = std::min(len, sizeof(zero));
+            write(zero, n);
+            len -= n;
+        }
+    }
+
+    // 写出 len 字节负载. mask 与每个字节相与, 用于避开帧同步字等特殊值
+    void put_payload(uint64_t len, uint8_t mask = 0xFF) {
+        if (sparse_) {
+            flush();
+            if (lseek(fd_, len, SEEK_CUR) < 0) {
+                failed_ = true;
+            }
+            offset_ += len;
+            return;
+        }
+        while (len > 0) {
+            size_t pos = pattern_pos_ % GEN_PATTERN_SIZE;
+            size_t n = std::min<uint64_t>(len, GEN_PATTERN_SIZE - pos);
+            if (mask == 0xFF) {
+                write(pattern_.get() + pos, n);
+            } else {
+                char s[256];
+                for (size_t done = 0; done < n;) {
+                    size_t m = std::min(n - done, sizeof(s));
+                    for (size_t i = 0; i < m; ++i) {
+                        s[i] = static_cast<char>(pattern_[pos + done + i] & mask);
+                    }
+                    write(s, m);
+                    done += m;
+                }
+            }
+            pattern_pos_ += n;
+            len -= n;
+        }
+    }
+
+private:
+    void flush() {
+        const char* p = buffer_.get();
+        size_t len = size_;
+        while (fd_ >= 0 && len > 0) {
+            ssize_t n = ::write(fd_, p, len);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                failed_ = true;
+                break;
+            }
+            p += n;
+            len -= n;
+        }
+        size_ = 0;
+    }
+
+private:
+    int fd_ = -1;
+    bool sparse_ = false;
+    bool failed_ = false;
+    std::unique_ptr<char[]> buffer_;
+    size_t size_ = 0;
+    uint64_t offset_ = 0;
+    std::unique_ptr<char[]> pattern_;
+    uint64_t pattern_pos_ = 0;
+};
+
+// 按 opt.format 生成 opt.output, 成功返回 0
+int gen_file(const GenOptions& opt);
+
+int gen_wav(const GenOptions& opt, GenWriter& out);
+int gen_mp3(const GenOptions& opt, GenWriter& out);
+int gen_flv(const GenOptions& opt, GenWriter& out);
+int gen_mp4(const GenOptions& opt, GenWriter& out);
+
+#endif //MEDIAFORMATPARSER_MEDIAGEN_H